@@ -75,8 +75,8 @@ struct CmdOptions
     int restartTimes = 3;
     int downlimit = 0;
     int uplimit = 0;
-    bool deltasync;
-    qint64 deltasyncminfilesize;
+    bool deltasync = false;
+    qint64 deltasyncminfilesize = 10 * 1000 * 1000;
 };
 
 struct SyncCTX
@@ -146,6 +146,8 @@ void sync(const SyncCTX &ctx)
     SyncOptions opt { QSharedPointer<Vfs>(createVfsFromPlugin(Vfs::Off).release()) };
     opt.fillFromEnvironmentVariables();
     opt.verifyChunkSizes();
+    opt._deltaSyncEnabled = ctx.options.deltasync;
+    opt._deltaSyncMinFileSize = ctx.options.deltasyncminfilesize;
     auto engine = new SyncEngine(
         ctx.account, ctx.account->davUrl(), ctx.options.source_dir, ctx.folder, db);
     engine->setSyncOptions(opt);
@@ -315,6 +317,8 @@ public:
     std::cout << "  --uplimit [n]          Limit the upload speed of files to n KB/s" << std::endl;
     std::cout << "  --downlimit [n]        Limit the download speed of files to n KB/s" << std::endl;
     std::cout << "  -h                     Sync hidden files,do not ignore them" << std::endl;
+    std::cout << "  --deltasync, -ds       Only upload the changed parts of modified files" << std::endl;
+    std::cout << "  --deltasyncmfs [n]     Minimum file size for delta sync in MB (default to 10)" << std::endl;
     std::cout << "  --version, -v          Display version and exit" << std::endl;
     std::cout << "  --logdebug             More verbose logging" << std::endl;
     std::cout << "" << std::endl;
@@ -395,6 +399,10 @@ CmdOptions parseOptions(const QStringList &app_args)
             options.uplimit = it.next().toInt() * 1000;
         } else if (option == QLatin1String("--downlimit") && !it.peekNext().startsWith(QLatin1String("-"))) {
             options.downlimit = it.next().toInt() * 1000;
+        } else if (option == QLatin1String("-ds") || option == QLatin1String("--deltasync")) {
+            options.deltasync = true;
+        } else if (option == QLatin1String("--deltasyncmfs") && !it.peekNext().startsWith(QLatin1String("-"))) {
+            options.deltasyncminfilesize = it.next().toLongLong() * 1000 * 1000;
         } else if (option == QLatin1String("--logdebug")) {
             Logger::instance()->setLogFile(QStringLiteral("-"));
             Logger::instance()->setLogDebug(true);
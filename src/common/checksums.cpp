@@ -23,10 +23,14 @@
 #include <QCoreApplication>
 #include <QCryptographicHash>
 #include <QLoggingCategory>
+#include <QThread>
+#include <QThreadPool>
 #include <qtconcurrentrun.h>
 
 #include <zlib.h>
 
+#include <vector>
+
 /** \file checksums.cpp
  *
  * \brief Computing and validating file checksums
@@ -86,24 +90,100 @@
 
 namespace {
 
-QByteArray calcAdler32(QIODevice *device)
+/**
+ * Feeds the data of one pass over a device into several checksum algorithms.
+ */
+class MultiHasher
 {
-    const qint64 BUFSIZE(500 * 1024); // 500 KiB
-    if (device->size() == 0) {
-        return QByteArray();
+public:
+    explicit MultiHasher(const QVector<OCC::CheckSums::Algorithm> &algorithms)
+    {
+        using OCC::CheckSums::Algorithm;
+        _states.reserve(algorithms.size());
+        for (const auto algorithm : algorithms) {
+            State state { algorithm, nullptr, adler32(0L, Z_NULL, 0) };
+            switch (algorithm) {
+            case Algorithm::SHA3_256:
+                [[fallthrough]];
+            case Algorithm::SHA256:
+                [[fallthrough]];
+            case Algorithm::SHA1:
+                [[fallthrough]];
+            case Algorithm::MD5:
+                state.crypto = std::make_unique<QCryptographicHash>(static_cast<QCryptographicHash::Algorithm>(algorithm));
+                _needsData = true;
+                break;
+            case Algorithm::ADLER32:
+                _needsData = true;
+                break;
+            case Algorithm::DUMMY_FOR_TESTS:
+                [[fallthrough]];
+            case Algorithm::NONE:
+                [[fallthrough]];
+            case Algorithm::PARSE_ERROR:
+                break;
+            }
+            _states.push_back(std::move(state));
+        }
     }
-    QByteArray buf(BUFSIZE, Qt::Uninitialized);
 
-    unsigned int adler = adler32(0L, Z_NULL, 0);
-    qint64 size;
-    while (!device->atEnd()) {
-        size = device->read(buf.data(), BUFSIZE);
-        if (size > 0)
-            adler = adler32(adler, (const Bytef *)buf.data(), size);
+    /// Whether any of the algorithms looks at the data at all
+    bool needsData() const { return _needsData; }
+
+    void addData(const char *data, qint64 size)
+    {
+        for (auto &state : _states) {
+            if (state.crypto) {
+                state.crypto->addData(data, static_cast<int>(size));
+            } else if (state.algorithm == OCC::CheckSums::Algorithm::ADLER32) {
+                state.adler = adler32(state.adler, reinterpret_cast<const Bytef *>(data), static_cast<uInt>(size));
+            }
+        }
     }
 
-    return QByteArray::number(adler, 16);
-}
+    QVector<QByteArray> results(qint64 totalSize) const
+    {
+        using OCC::CheckSums::Algorithm;
+        QVector<QByteArray> out;
+        out.reserve(static_cast<int>(_states.size()));
+        for (const auto &state : _states) {
+            switch (state.algorithm) {
+            case Algorithm::SHA3_256:
+                [[fallthrough]];
+            case Algorithm::SHA256:
+                [[fallthrough]];
+            case Algorithm::SHA1:
+                [[fallthrough]];
+            case Algorithm::MD5:
+                out.append(state.crypto->result().toHex());
+                break;
+            case Algorithm::ADLER32:
+                // empty files have no adler32 checksum
+                out.append(totalSize == 0 ? QByteArray() : QByteArray::number(static_cast<uint>(state.adler), 16));
+                break;
+            case Algorithm::DUMMY_FOR_TESTS:
+                out.append(QByteArrayLiteral("0x1"));
+                break;
+            case Algorithm::NONE:
+                [[fallthrough]];
+            case Algorithm::PARSE_ERROR:
+                out.append(QByteArray());
+                break;
+            }
+        }
+        return out;
+    }
+
+private:
+    struct State
+    {
+        OCC::CheckSums::Algorithm algorithm;
+        std::unique_ptr<QCryptographicHash> crypto;
+        uLong adler;
+    };
+    std::vector<State> _states;
+    bool _needsData = false;
+};
 }
 
 namespace OCC {
@@ -223,6 +303,8 @@ static bool checksumComputationEnabled()
 ComputeChecksum::ComputeChecksum(QObject *parent)
     : QObject(parent)
 {
+    // allDone() can be queued
+    qRegisterMetaType<QVector<ChecksumHeader>>("QVector<OCC::ChecksumHeader>");
 }
 
 ComputeChecksum::~ComputeChecksum()
@@ -231,24 +313,41 @@ ComputeChecksum::~ComputeChecksum()
 
 void ComputeChecksum::setChecksumType(CheckSums::Algorithm type)
 {
-    _checksumType = type;
+    _checksumTypes = { type };
+}
+
+void ComputeChecksum::setChecksumTypes(const QVector<CheckSums::Algorithm> &types)
+{
+    OC_ASSERT(!types.isEmpty());
+    _checksumTypes = types;
 }
 
 CheckSums::Algorithm ComputeChecksum::checksumType() const
 {
-    return _checksumType;
+    return _checksumTypes.value(0, CheckSums::Algorithm::PARSE_ERROR);
+}
+
+QThreadPool *ComputeChecksum::threadPool()
+{
+    static QThreadPool pool;
+    static const bool initialized = [] {
+        pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), 4));
+        return true;
+    }();
+    Q_UNUSED(initialized);
+    return &pool;
 }
 
 void ComputeChecksum::start(const QString &filePath)
 {
-    qCInfo(lcChecksums) << "Computing" << checksumType() << "checksum of" << filePath << "in a thread";
+    qCInfo(lcChecksums) << "Computing" << _checksumTypes << "checksum of" << filePath << "in a thread";
     startImpl(std::make_unique<QFile>(filePath));
 }
 
 void ComputeChecksum::start(std::unique_ptr<QIODevice> device)
 {
     OC_ENFORCE(device);
-    qCInfo(lcChecksums) << "Computing" << checksumType() << "checksum of device" << device.get() << "in a thread";
+    qCInfo(lcChecksums) << "Computing" << _checksumTypes << "checksum of device" << device.get() << "in a thread";
     OC_ASSERT(!device->parent());
 
     startImpl(std::move(device));
@@ -265,9 +364,11 @@ void ComputeChecksum::startImpl(std::unique_ptr<QIODevice> device)
     auto sharedDevice = QSharedPointer<QIODevice>(device.release());
 
     // Bug: The thread will keep running even if ComputeChecksum is deleted.
-    auto type = checksumType();
-    _watcher.setFuture(QtConcurrent::run([sharedDevice, type]() {
-        if (!sharedDevice->open(QIODevice::ReadOnly)) {
+    const auto types = _checksumTypes;
+    _watcher.setFuture(QtConcurrent::run(threadPool(), [sharedDevice, types]() {
+        // Files are read in large blocks, Qt's buffering would only add a copy
+        const auto openMode = qobject_cast<QFile *>(sharedDevice.data()) ? QIODevice::ReadOnly | QIODevice::Unbuffered : QIODevice::ReadOnly;
+        if (!sharedDevice->open(openMode)) {
             if (auto file = qobject_cast<QFile *>(sharedDevice.data())) {
                 qCWarning(lcChecksums) << "Could not open file" << file->fileName()
                         << "for reading to compute a checksum" << file->errorString();
@@ -275,9 +376,9 @@ void ComputeChecksum::startImpl(std::unique_ptr<QIODevice> device)
                 qCWarning(lcChecksums) << "Could not open device" << sharedDevice.data()
                         << "for reading to compute a checksum" << sharedDevice->errorString();
             }
-            return QByteArray();
+            return QVector<QByteArray>(types.size());
         }
-        auto result = ComputeChecksum::computeNow(sharedDevice.data(), type);
+        auto result = ComputeChecksum::computeAllNow(sharedDevice.data(), types);
         sharedDevice->close();
         return result;
     }));
@@ -286,7 +387,7 @@ void ComputeChecksum::startImpl(std::unique_ptr<QIODevice> device)
 QByteArray ComputeChecksum::computeNowOnFile(const QString &filePath, CheckSums::Algorithm checksumType)
 {
     QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
         qCWarning(lcChecksums) << "Could not open file" << filePath << "for reading and computing checksum" << file.errorString();
         return QByteArray();
     }
@@ -296,39 +397,80 @@ QByteArray ComputeChecksum::computeNowOnFile(const QString &filePath, CheckSums:
 
 QByteArray ComputeChecksum::computeNow(QIODevice *device, CheckSums::Algorithm algorithm)
 {
-    switch (algorithm) {
-    case CheckSums::Algorithm::SHA3_256:
-        [[fallthrough]];
-    case CheckSums::Algorithm::SHA256:
-        [[fallthrough]];
-    case CheckSums::Algorithm::SHA1:
-        [[fallthrough]];
-    case CheckSums::Algorithm::MD5: {
-        QCryptographicHash crypto(static_cast<QCryptographicHash::Algorithm>(algorithm));
-        if (crypto.addData(device)) {
-            return crypto.result().toHex();
+    return computeAllNow(device, { algorithm }).first();
+}
+
+QVector<QByteArray> ComputeChecksum::computeAllNow(QIODevice *device, const QVector<CheckSums::Algorithm> &algorithms)
+{
+    MultiHasher hasher(algorithms);
+    if (!hasher.needsData()) {
+        return hasher.results(-1);
+    }
+
+    // Large reads keep the number of syscalls low, every block goes through all algorithms
+    const qint64 bufferSize = 1024 * 1024; // 1 MiB
+    QByteArray buffer(bufferSize, Qt::Uninitialized);
+    qint64 totalSize = 0;
+    while (!device->atEnd()) {
+        const qint64 size = device->read(buffer.data(), bufferSize);
+        if (size < 0) {
+            qCWarning(lcChecksums) << "Failed to compute checksum" << algorithms << device->errorString();
+            return QVector<QByteArray>(algorithms.size());
         }
-        qCWarning(lcChecksums) << "Failed to compoute checksum" << CheckSums::toQString(algorithm);
-        return {};
+        if (size == 0) {
+            break;
+        }
+        hasher.addData(buffer.constData(), size);
+        totalSize += size;
     }
-    case CheckSums::Algorithm::ADLER32:
-        return calcAdler32(device);
-    case CheckSums::Algorithm::DUMMY_FOR_TESTS:
-        return QByteArrayLiteral("0x1");
-    case CheckSums::Algorithm::PARSE_ERROR:
-        return {};
+    return hasher.results(totalSize);
+}
+
+QByteArray ComputeChecksum::computeBlocksNow(QIODevice *device, qint64 blockSize)
+{
+    OC_ENFORCE(blockSize > 0);
+    QByteArray result;
+    QByteArray buffer(blockSize, Qt::Uninitialized);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    while (!device->atEnd()) {
+        // Fill the whole block, the device may return less per read
+        qint64 size = 0;
+        while (size < blockSize && !device->atEnd()) {
+            const qint64 read = device->read(buffer.data() + size, blockSize - size);
+            if (read < 0) {
+                qCWarning(lcChecksums) << "Failed to compute block checksums" << device->errorString();
+                return QByteArray();
+            }
+            if (read == 0) {
+                break;
+            }
+            size += read;
+        }
+        if (size == 0) {
+            break;
+        }
+        hash.reset();
+        hash.addData(buffer.constData(), size);
+        result += hash.result();
     }
-    Q_UNREACHABLE();
+    return result;
 }
 
 void ComputeChecksum::slotCalculationDone()
 {
-    QByteArray checksum = _watcher.future().result();
-    if (!checksum.isNull()) {
-        emit done(_checksumType, checksum);
-    } else {
-        emit done(CheckSums::Algorithm::PARSE_ERROR, QByteArray());
+    const QVector<QByteArray> checksums = _watcher.future().result();
+    QVector<ChecksumHeader> headers;
+    headers.reserve(checksums.size());
+    for (int i = 0; i < checksums.size(); ++i) {
+        if (!checksums[i].isNull()) {
+            headers.append(ChecksumHeader(_checksumTypes.at(i), checksums[i]));
+        } else {
+            headers.append(ChecksumHeader(CheckSums::Algorithm::PARSE_ERROR, QByteArray()));
+        }
     }
+    const auto &first = headers.first();
+    emit done(first.type(), first.checksum());
+    emit allDone(headers);
 }
 
 
@@ -25,10 +25,12 @@
 #include <QCryptographicHash>
 #include <QFutureWatcher>
 #include <QObject>
+#include <QVector>
 
 #include <memory>
 
 class QFile;
+class QThreadPool;
 
 namespace OCC {
 
@@ -96,6 +98,13 @@ public:
      */
     void setChecksumType(CheckSums::Algorithm type);
 
+    /**
+     * Sets several checksum types to be computed in a single pass over the data.
+     *
+     * done() reports the first one, allDone() all of them in the given order.
+     */
+    void setChecksumTypes(const QVector<CheckSums::Algorithm> &types);
+
     CheckSums::Algorithm checksumType() const;
 
     /**
@@ -120,13 +129,36 @@ public:
      */
     static QByteArray computeNow(QIODevice *device, CheckSums::Algorithm algo);
 
+    /**
+     * Computes several checksums synchronously, reading the device only once.
+     *
+     * The results are in the order of algorithms, failures are null.
+     */
+    static QVector<QByteArray> computeAllNow(QIODevice *device, const QVector<CheckSums::Algorithm> &algorithms);
+
+    /**
+     * Computes the SHA1 of each block of blockSize bytes synchronously.
+     *
+     * Returns the binary digests concatenated, or null on failure.
+     */
+    static QByteArray computeBlocksNow(QIODevice *device, qint64 blockSize);
+
     /**
      * Computes the checksum synchronously on file. Convenience wrapper for computeNow().
      */
     static QByteArray computeNowOnFile(const QString &filePath, CheckSums::Algorithm checksumType);
 
+    /**
+     * The pool the checksums are computed in.
+     *
+     * Computing checksums is mostly bound by reading the files, so it is
+     * limited to a few threads instead of competing for the global pool.
+     */
+    static QThreadPool *threadPool();
+
 signals:
     void done(CheckSums::Algorithm checksumType, const QByteArray &checksum);
+    void allDone(const QVector<OCC::ChecksumHeader> &checksums);
 
 private slots:
     void slotCalculationDone();
@@ -134,10 +166,10 @@ private slots:
 private:
     void startImpl(std::unique_ptr<QIODevice> device);
 
-    CheckSums::Algorithm _checksumType;
+    QVector<CheckSums::Algorithm> _checksumTypes;
 
     // watcher for the checksum calculation thread
-    QFutureWatcher<QByteArray> _watcher;
+    QFutureWatcher<QVector<QByteArray>> _watcher;
 };
 
 /**
@@ -182,3 +214,5 @@ private:
     ChecksumHeader _expectedChecksum;
 };
 }
+
+Q_DECLARE_METATYPE(OCC::ChecksumHeader)
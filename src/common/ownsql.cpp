@@ -263,7 +263,6 @@ int SqlQuery::prepare(const QByteArray &sql, bool allow_failure)
     if (_stmt) {
         finish();
     }
-    _boundQuery = QString::fromUtf8(_sql);
     if (!_sql.isEmpty()) {
         int rc = {};
         for (int n = 0; n < SQLITE_REPEAT_COUNT; ++n) {
@@ -321,7 +320,7 @@ bool SqlQuery::exec()
     if (!isSelect() && !isPragma()) {
         int rc = 0;
         for (int n = 0; n < SQLITE_REPEAT_COUNT; ++n) {
-            qCDebug(lcSql) << "SQL exec" << _boundQuery << "Try:" << n;
+            qCDebug(lcSql) << "SQL exec" << boundQuery() << "Try:" << n;
             rc = sqlite3_step(_stmt);
             if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
                 qCWarning(lcSql) << "SQL exec failed" << _sql << QString::fromUtf8(sqlite3_errmsg(_db));
@@ -336,7 +335,7 @@ bool SqlQuery::exec()
 
         if (_errId != SQLITE_DONE && _errId != SQLITE_ROW) {
             _error = QString::fromUtf8(sqlite3_errmsg(_db));
-            qCWarning(lcSql) << "Sqlite exec statement error:" << _errId << _error << "in" << _sql;
+            qCWarning(lcSql) << "Sqlite exec statement error:" << _errId << _error << "in" << boundQuery();
             if (_errId == SQLITE_IOERR) {
                 qCWarning(lcSql) << "IOERR extended errcode: " << sqlite3_extended_errcode(_db);
 #if SQLITE_VERSION_NUMBER >= 3012000
@@ -503,8 +502,22 @@ void SqlQuery::reset_and_clear_bindings()
     if (_stmt) {
         SQLITE_DO(sqlite3_reset(_stmt));
         SQLITE_DO(sqlite3_clear_bindings(_stmt));
-        _boundQuery = QString::fromUtf8(_sql);
     }
 }
 
+QString SqlQuery::boundQuery() const
+{
+#if SQLITE_VERSION_NUMBER >= 3014000
+    // Only expanded on demand, binding values is on the hot path of every write
+    if (_stmt) {
+        if (char *expanded = sqlite3_expanded_sql(_stmt)) {
+            const QString out = QString::fromUtf8(expanded);
+            sqlite3_free(expanded);
+            return out;
+        }
+    }
+#endif
+    return QString::fromUtf8(_sql);
+}
+
 } // namespace OCC
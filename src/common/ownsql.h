@@ -136,9 +136,6 @@ public:
     template <class T>
     void bindValue(int pos, const T &value)
     {
-        QString s;
-        QDebug(&s).noquote().nospace() << '\'' << value << '\'';
-        _boundQuery.replace(QStringLiteral("?%1").arg(QString::number(pos)), s);
         bindValueConvert(pos, value);
     }
 
@@ -162,13 +159,15 @@ private:
     void bindValueInternal(int pos, const QVariant &value);
     void finish();
 
+    /** The query with the currently bound values, only meant for logging */
+    QString boundQuery() const;
+
     SqlDatabase *_sqldb = nullptr;
     sqlite3 *_db = nullptr;
     sqlite3_stmt *_stmt = nullptr;
     QString _error;
     int _errId;
     QByteArray _sql;
-    QString _boundQuery;
 
     friend class SqlDatabase;
     friend class PreparedSqlQueryManager;
@@ -66,6 +66,7 @@ public:
         GetAllFilesQuery,
         ListFilesInPathQuery,
         SetFileRecordQuery,
+        SetFileRecordsBatchQuery,
         SetFileRecordChecksumQuery,
         GetDownloadInfoQuery,
         SetDownloadInfoQuery,
@@ -73,6 +74,9 @@ public:
         GetUploadInfoQuery,
         SetUploadInfoQuery,
         DeleteUploadInfoQuery,
+        GetBlockChecksumsQuery,
+        SetBlockChecksumsQuery,
+        DeleteBlockChecksumsQuery,
         DeleteFileRecordPhash,
         DeleteFileRecordRecursively,
         GetErrorBlacklistQuery,
@@ -23,7 +23,9 @@
 #include <QElapsedTimer>
 #include <QUrl>
 #include <QDir>
+#include <QThread>
 #include <sqlite3.h>
+#include <algorithm>
 #include <cstring>
 
 #include "common/asserts.h"
@@ -101,6 +103,23 @@ SyncJournalDb::SyncJournalDb(const QString &dbFilePath, QObject *parent)
     if (_journalMode.isEmpty()) {
         _journalMode = defaultJournalMode(_dbFile);
     }
+
+    _writeBatchTimer.setSingleShot(true);
+    connect(&_writeBatchTimer, &QTimer::timeout, this, [this] {
+        QMutexLocker locker(&_mutex);
+        if (!_writeBatchAge.isValid()) {
+            return; // committed in the meantime
+        }
+        const qint64 remaining = _writeBatchMaxAge.count() - _writeBatchAge.elapsed();
+        if (remaining > 0) {
+            // committed in the meantime, and written to again
+            _writeBatchTimer.start(std::chrono::milliseconds(remaining));
+            return;
+        }
+        if (checkConnect()) {
+            commitInternal(QStringLiteral("write batch timeout"));
+        }
+    });
 }
 
 QString SyncJournalDb::makeDbName(const QString &localPath,
@@ -249,6 +268,34 @@ bool SyncJournalDb::sqlFail(const QString &log, const SqlQuery &query)
 }
 
 bool SyncJournalDb::checkConnect()
+{
+    if (!openConnectionLocked()) {
+        return false;
+    }
+    // Everything using the connection must see the batched writes first
+    flushWriteBatchLocked();
+    return true;
+}
+
+bool SyncJournalDb::checkConnectForRead(const QString &path, bool recursive)
+{
+    if (!openConnectionLocked()) {
+        return false;
+    }
+    // Lookups that can't see the batched writes don't need to wait for them
+    bool touched = _writeBatchPaths.contains(path);
+    if (!touched && recursive) {
+        const QString prefix = path + QLatin1Char('/');
+        touched = path.isEmpty() ? !_writeBatchPaths.isEmpty()
+                                 : std::any_of(_writeBatchPaths.cbegin(), _writeBatchPaths.cend(), [&](const QString &pending) { return pending.startsWith(prefix); });
+    }
+    if (touched) {
+        flushWriteBatchLocked();
+    }
+    return true;
+}
+
+bool SyncJournalDb::openConnectionLocked()
 {
     if (_closed) {
         qCWarning(lcDb) << Q_FUNC_INFO << "after the db was closed";
@@ -360,6 +407,26 @@ bool SyncJournalDb::checkConnect()
                                                                         end - text, 0));
                                 }, nullptr, nullptr);
 
+    // Orders paths like "path||'/'" in BINARY collation would: The contents of a
+    // directory are sorted directly behind the directory itself. Unlike the
+    // expression, a column with this collation can be indexed.
+    sqlite3_create_collation(_db.sqliteDb(), "path_order", SQLITE_UTF8, nullptr,
+                                [](void *, int lenA, const void *a, int lenB, const void *b) {
+                                    const auto textA = static_cast<const unsigned char *>(a);
+                                    const auto textB = static_cast<const unsigned char *>(b);
+                                    if (const int cmp = std::memcmp(textA, textB, std::min(lenA, lenB))) {
+                                        return cmp;
+                                    }
+                                    if (lenA == lenB) {
+                                        return 0;
+                                    }
+                                    // One is a prefix of the other: compare the implicit '/' with the next character
+                                    if (lenA < lenB) {
+                                        return textB[lenA] < '/' ? 1 : -1;
+                                    }
+                                    return textA[lenB] < '/' ? -1 : 1;
+                                });
+
     /* Because insert is so slow, we do everything in a transaction, and only need one call to commit */
     startTransaction();
 
@@ -412,6 +479,8 @@ bool SyncJournalDb::checkConnect()
                         "tmpfile VARCHAR(4096),"
                         "etag VARCHAR(32),"
                         "errorcount INTEGER,"
+                        "rangesize INTEGER(8),"
+                        "completedranges TEXT,"
                         "PRIMARY KEY(path)"
                         ");");
 
@@ -434,6 +503,18 @@ bool SyncJournalDb::checkConnect()
         return sqlFail(QStringLiteral("Create table uploadinfo"), createQuery);
     }
 
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS blockchecksums("
+                        "path VARCHAR(4096),"
+                        "blocksize INTEGER(8),"
+                        "etag VARCHAR(32),"
+                        "checksums BLOB,"
+                        "PRIMARY KEY(path)"
+                        ");");
+
+    if (!createQuery.exec()) {
+        return sqlFail(QStringLiteral("Create table blockchecksums"), createQuery);
+    }
+
     // create the blacklist table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS blacklist ("
                         "path VARCHAR(4096),"
@@ -618,6 +699,10 @@ void SyncJournalDb::close()
     QMutexLocker locker(&_mutex);
     qCInfo(lcDb) << "Closing DB" << _dbFile;
 
+    if (!_writeBatch.empty()) {
+        checkConnect(); // writes the batch
+    }
+    _writeBatching = false;
     commitTransaction();
     _db.close();
     clearEtagStorageFilter();
@@ -714,6 +799,16 @@ bool SyncJournalDb::updateMetadataTableStructure()
         commitInternal(QStringLiteral("update database structure: add parent index"));
     }
 
+    if (1) {
+        SqlQuery query(_db);
+        query.prepare("CREATE INDEX IF NOT EXISTS metadata_path_order ON metadata(path COLLATE path_order);");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: create index path_order"), query);
+            re = false;
+        }
+        commitInternal(QStringLiteral("update database structure: add path_order index"));
+    }
+
     if (columns.indexOf("ignoredChildrenRemote") == -1) {
         SqlQuery query(_db);
         query.prepare("ALTER TABLE metadata ADD COLUMN ignoredChildrenRemote INT;");
@@ -743,6 +838,24 @@ bool SyncJournalDb::updateMetadataTableStructure()
         commitInternal(QStringLiteral("update database structure: add contentChecksumTypeId col"));
     }
 
+    auto downloadInfoColumns = tableColumns("downloadinfo");
+    if (downloadInfoColumns.isEmpty())
+        return false;
+    if (!downloadInfoColumns.contains("rangesize")) {
+        SqlQuery query(_db);
+        query.prepare("ALTER TABLE downloadinfo ADD COLUMN rangesize INTEGER(8);");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: add rangesize column"), query);
+            re = false;
+        }
+        query.prepare("ALTER TABLE downloadinfo ADD COLUMN completedranges TEXT;");
+        if (!query.exec()) {
+            sqlFail(QStringLiteral("updateMetadataTableStructure: add completedranges column"), query);
+            re = false;
+        }
+        commitInternal(QStringLiteral("update database structure: add range cols for downloadinfo"));
+    }
+
     auto uploadInfoColumns = tableColumns("uploadinfo");
     if (uploadInfoColumns.isEmpty())
         return false;
@@ -860,11 +973,50 @@ qint64 SyncJournalDb::getPHash(const QByteArray &file)
     return h;
 }
 
+#define SET_FILE_RECORD_COLUMNS \
+    "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, remotePerm, filesize, ignoredChildrenRemote, contentChecksum, contentChecksumTypeId)"
+static const int setFileRecordColumnCount = 16;
+
+static QByteArray setFileRecordsSql(int rows)
+{
+    QByteArray sql = QByteArrayLiteral("INSERT OR REPLACE INTO metadata " SET_FILE_RECORD_COLUMNS " VALUES ");
+    for (int row = 0; row < rows; ++row) {
+        sql += row == 0 ? "(" : ", (";
+        for (int column = 1; column <= setFileRecordColumnCount; ++column) {
+            sql += '?' + QByteArray::number(row * setFileRecordColumnCount + column);
+            sql += column == setFileRecordColumnCount ? ")" : ", ";
+        }
+    }
+    return sql;
+}
+
 Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &_record)
 {
-    SyncJournalFileRecord record = _record;
     QMutexLocker locker(&_mutex);
 
+    OC_ASSERT(!_record._remotePerm.isNull());
+    if (isWriteBatchingLocked()) {
+        if (!queueWriteLocked({ PendingWrite::Type::FileRecord, filteredFileRecordLocked(_record), {}, {} })) {
+            // The sync has to be redone, don't pretend the following items succeeded
+            return _writeBatchError;
+        }
+        // Can't be true anymore, and the next read must look at the batch
+        _metadataTableIsEmpty = false;
+        return {};
+    }
+
+    if (checkConnect()) {
+        const std::vector<PendingWrite> records { { PendingWrite::Type::FileRecord, filteredFileRecordLocked(_record), {}, {} } };
+        return writeFileRecordsLocked(records.cbegin(), records.cend());
+    } else {
+        qCWarning(lcDb) << "Failed to connect database.";
+        return tr("Failed to connect database."); // checkConnect failed.
+    }
+}
+
+SyncJournalFileRecord SyncJournalDb::filteredFileRecordLocked(const SyncJournalFileRecord &_record)
+{
+    SyncJournalFileRecord record = _record;
     if (!_etagStorageFilter.isEmpty()) {
         // If we are a directory that should not be read from db next time, don't write the etag
         QByteArray prefix = record._path + "/";
@@ -876,62 +1028,165 @@ Result<void, QString> SyncJournalDb::setFileRecord(const SyncJournalFileRecord &
             }
         }
     }
-    OC_ASSERT(!record._remotePerm.isNull());
     qCInfo(lcDb) << "Updating file record for path:" << record._path << "inode:" << record._inode
                  << "modtime:" << record._modtime << "type:" << record._type
                  << "etag:" << record._etag << "fileId:" << record._fileId << "remotePerm:" << record._remotePerm.toString()
                  << "fileSize:" << record._fileSize << "checksum:" << record._checksumHeader;
-
-    const qint64 phash = getPHash(record._path);
-    if (checkConnect()) {
-        int plen = record._path.length();
-
-        QByteArray etag(record._etag);
-        if (etag.isEmpty())
-            etag = "";
-        QByteArray fileId(record._fileId);
-        if (fileId.isEmpty())
-            fileId = "";
-        QByteArray remotePerm = record._remotePerm.toDbValue();
-
-        const auto checksumHeader = ChecksumHeader::parseChecksumHeader(record._checksumHeader);
-        int contentChecksumTypeId = mapChecksumType(checksumHeader.type());
-        const auto query = _queryManager.get(PreparedSqlQueryManager::SetFileRecordQuery, QByteArrayLiteral("INSERT OR REPLACE INTO metadata "
-                                                                                                            "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, remotePerm, filesize, ignoredChildrenRemote, contentChecksum, contentChecksumTypeId) "
-                                                                                                            "VALUES (?1 , ?2, ?3 , ?4 , ?5 , ?6 , ?7,  ?8 , ?9 , ?10, ?11, ?12, ?13, ?14, ?15, ?16);"),
-            _db);
+    return record;
+}
+
+void SyncJournalDb::bindFileRecord(SqlQuery &query, int offset, const SyncJournalFileRecord &record)
+{
+    QByteArray etag(record._etag);
+    if (etag.isEmpty())
+        etag = "";
+    QByteArray fileId(record._fileId);
+    if (fileId.isEmpty())
+        fileId = "";
+    QByteArray remotePerm = record._remotePerm.toDbValue();
+
+    const auto checksumHeader = ChecksumHeader::parseChecksumHeader(record._checksumHeader);
+    int contentChecksumTypeId = mapChecksumType(checksumHeader.type());
+
+    query.bindValue(offset + 1, getPHash(record._path));
+    query.bindValue(offset + 2, record._path.length());
+    query.bindValue(offset + 3, record._path);
+    query.bindValue(offset + 4, record._inode);
+    query.bindValue(offset + 5, 0); // uid Not used
+    query.bindValue(offset + 6, 0); // gid Not used
+    query.bindValue(offset + 7, 0); // mode Not used
+    query.bindValue(offset + 8, record._modtime);
+    query.bindValue(offset + 9, record._type);
+    query.bindValue(offset + 10, etag);
+    query.bindValue(offset + 11, fileId);
+    query.bindValue(offset + 12, remotePerm);
+    query.bindValue(offset + 13, record._fileSize);
+    query.bindValue(offset + 14, record._serverHasIgnoredFiles ? 1 : 0);
+    query.bindValue(offset + 15, checksumHeader.checksum());
+    query.bindValue(offset + 16, contentChecksumTypeId);
+}
+
+Result<void, QString> SyncJournalDb::writeFileRecordsLocked(PendingWriteIterator begin, PendingWriteIterator end)
+{
+    const auto count = std::distance(begin, end);
+    if (count == fileRecordsPerInsert) {
+        static const QByteArray sql = setFileRecordsSql(fileRecordsPerInsert);
+        const auto query = _queryManager.get(PreparedSqlQueryManager::SetFileRecordsBatchQuery, sql, _db);
         if (!query) {
             return query->error();
         }
-
-        query->bindValue(1, phash);
-        query->bindValue(2, plen);
-        query->bindValue(3, record._path);
-        query->bindValue(4, record._inode);
-        query->bindValue(5, 0); // uid Not used
-        query->bindValue(6, 0); // gid Not used
-        query->bindValue(7, 0); // mode Not used
-        query->bindValue(8, record._modtime);
-        query->bindValue(9, record._type);
-        query->bindValue(10, etag);
-        query->bindValue(11, fileId);
-        query->bindValue(12, remotePerm);
-        query->bindValue(13, record._fileSize);
-        query->bindValue(14, record._serverHasIgnoredFiles ? 1 : 0);
-        query->bindValue(15, checksumHeader.checksum());
-        query->bindValue(16, contentChecksumTypeId);
-
+        int offset = 0;
+        for (auto it = begin; it != end; ++it) {
+            bindFileRecord(*query, offset, it->record);
+            offset += setFileRecordColumnCount;
+        }
         if (!query->exec()) {
             return query->error();
         }
+    } else {
+        for (auto it = begin; it != end; ++it) {
+            const auto query = _queryManager.get(PreparedSqlQueryManager::SetFileRecordQuery, QByteArrayLiteral("INSERT OR REPLACE INTO metadata " SET_FILE_RECORD_COLUMNS " "
+                                                                                                                "VALUES (?1 , ?2, ?3 , ?4 , ?5 , ?6 , ?7,  ?8 , ?9 , ?10, ?11, ?12, ?13, ?14, ?15, ?16);"),
+                _db);
+            if (!query) {
+                return query->error();
+            }
+            bindFileRecord(*query, 0, it->record);
+            if (!query->exec()) {
+                return query->error();
+            }
+        }
+    }
 
-        // Can't be true anymore.
-        _metadataTableIsEmpty = false;
+    // Can't be true anymore.
+    _metadataTableIsEmpty = false;
 
-        return {};
-    } else {
-        qCWarning(lcDb) << "Failed to connect database.";
-        return tr("Failed to connect database."); // checkConnect failed.
+    return {};
+}
+
+bool SyncJournalDb::queueWriteLocked(PendingWrite &&write)
+{
+    if (!_writeBatchError.isEmpty()) {
+        // Don't add to a batch that is known to have failed
+        return false;
+    }
+    startWriteBatchAgeLocked();
+    switch (write.type) {
+    case PendingWrite::Type::FileRecord:
+        _writeBatchPaths.insert(QString::fromUtf8(write.record._path));
+        break;
+    case PendingWrite::Type::SetErrorBlacklistEntry:
+        _writeBatchPaths.insert(write.blacklistRecord._file);
+        break;
+    default:
+        _writeBatchPaths.insert(write.file);
+        break;
+    }
+    _writeBatch.push_back(std::move(write));
+    ++_writeBatchUncommitted;
+
+    if (_writeBatchUncommitted >= _writeBatchMaxItems || _writeBatchAge.hasExpired(_writeBatchMaxAge.count())) {
+        // checkConnect() writes the batch
+        if (checkConnect()) {
+            commitInternal(QStringLiteral("write batch"));
+        }
+    }
+    return _writeBatchError.isEmpty();
+}
+
+void SyncJournalDb::startWriteBatchAgeLocked()
+{
+    if (_writeBatchAge.isValid()) {
+        return;
+    }
+    _writeBatchAge.start();
+    if (QThread::currentThread() == thread()) {
+        _writeBatchTimer.start(_writeBatchMaxAge);
+    }
+}
+
+void SyncJournalDb::flushWriteBatchLocked()
+{
+    if (_writeBatch.empty()) {
+        return;
+    }
+    // Taken first: the writes below must not flush again
+    const auto batch = std::move(_writeBatch);
+    _writeBatch.clear();
+    _writeBatchPaths.clear();
+
+    qCDebug(lcDb) << "Writing" << batch.size() << "batched updates";
+    for (auto it = batch.cbegin(); it != batch.cend();) {
+        switch (it->type) {
+        case PendingWrite::Type::FileRecord: {
+            auto end = it;
+            while (end != batch.cend() && end->type == PendingWrite::Type::FileRecord && std::distance(it, end) < fileRecordsPerInsert) {
+                ++end;
+            }
+            const auto result = writeFileRecordsLocked(it, end);
+            if (!result) {
+                // Keep the committed state a prefix of the calls made: drop the rest
+                qCWarning(lcDb) << "Writing batched file records failed, dropping" << std::distance(it, batch.cend()) << "updates:" << result.error();
+                _writeBatchError = result.error();
+                return;
+            }
+            it = end;
+            continue;
+        }
+        case PendingWrite::Type::DeleteDownloadInfo:
+            deleteDownloadInfoLocked(it->file);
+            break;
+        case PendingWrite::Type::DeleteUploadInfo:
+            deleteUploadInfoLocked(it->file);
+            break;
+        case PendingWrite::Type::SetErrorBlacklistEntry:
+            setErrorBlacklistEntryLocked(it->blacklistRecord);
+            break;
+        case PendingWrite::Type::WipeErrorBlacklistEntry:
+            wipeErrorBlacklistEntryLocked(it->file);
+            break;
+        }
+        ++it;
     }
 }
 
@@ -967,6 +1222,19 @@ bool SyncJournalDb::deleteFileRecord(const QString &filename, bool recursively)
                 return false;
             }
         }
+
+        {
+            // The block checksums are only an optimization, also drop the ones below directories
+            const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteBlockChecksumsQuery,
+                QByteArrayLiteral("DELETE FROM blockchecksums WHERE " IS_PREFIX_PATH_OR_EQUAL("?1", "path")), _db);
+            if (!query) {
+                return false;
+            }
+            query->bindValue(1, filename);
+            if (!query->exec()) {
+                return false;
+            }
+        }
         return true;
     } else {
         qCWarning(lcDb) << "Failed to connect database.";
@@ -987,7 +1255,7 @@ bool SyncJournalDb::getFileRecord(const QByteArray &filename, SyncJournalFileRec
     if (_metadataTableIsEmpty)
         return true; // no error, yet nothing found (rec->isValid() == false)
 
-    if (!checkConnect())
+    if (!checkConnectForRead(QString::fromUtf8(filename)))
         return false;
 
     if (!filename.isEmpty()) {
@@ -1091,7 +1359,7 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
     if (_metadataTableIsEmpty)
         return true; // no error, yet nothing found
 
-    if (!checkConnect())
+    if (!checkConnectForRead(QString::fromUtf8(path), true))
         return false;
 
     auto _exec = [&rowCallback](SqlQuery &query) {
@@ -1119,7 +1387,7 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
         // and find nothing. So, unfortunately, we have to use a different query for
         // retrieving the whole tree.
 
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetAllFilesQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " ORDER BY path||'/' ASC"), _db);
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetAllFilesQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " ORDER BY path COLLATE path_order ASC"), _db);
         if (!query) {
             return false;
         }
@@ -1128,12 +1396,15 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
         // This query is used to skip discovery and fill the tree from the
         // database instead
         const auto query = _queryManager.get(PreparedSqlQueryManager::GetFilesBelowPathQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE " IS_PREFIX_PATH_OF("?1", "path")
+                                                                                                  // The same range expressed in path_order, so the
+                                                                                                  // metadata_path_order index can be used for the ORDER BY
+                                                                                                  " AND path COLLATE path_order > ?1 AND path COLLATE path_order < (?1||'0')"
                                                                                                   // We want to ensure that the contents of a directory are sorted
                                                                                                   // directly behind the directory itself. Without this ORDER BY
                                                                                                   // an ordering like foo, foo-2, foo/file would be returned.
-                                                                                                  // With the trailing /, we get foo-2, foo, foo/file. This property
+                                                                                                  // With path_order, we get foo-2, foo, foo/file. This property
                                                                                                   // is used in fill_tree_from_db().
-                                                                                                  " ORDER BY path||'/' ASC"),
+                                                                                                  " ORDER BY path COLLATE path_order ASC"),
             _db);
         if (!query) {
             return false;
@@ -1151,10 +1422,10 @@ bool SyncJournalDb::listFilesInPath(const QByteArray& path,
     if (_metadataTableIsEmpty)
         return true;
 
-    if (!checkConnect())
+    if (!checkConnectForRead(QString::fromUtf8(path), true))
         return false;
 
-    const auto query = _queryManager.get(PreparedSqlQueryManager::ListFilesInPathQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE parent_hash(path) = ?1 ORDER BY path||'/' ASC"), _db);
+    const auto query = _queryManager.get(PreparedSqlQueryManager::ListFilesInPathQuery, QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE parent_hash(path) = ?1 ORDER BY path COLLATE path_order ASC"), _db);
     if (!query) {
         return false;
     }
@@ -1297,8 +1568,8 @@ SyncJournalDb::DownloadInfo SyncJournalDb::getDownloadInfo(const QString &file)
 
     DownloadInfo res;
 
-    if (checkConnect()) {
-        const auto query = _queryManager.get(PreparedSqlQueryManager::GetDownloadInfoQuery, QByteArrayLiteral("SELECT tmpfile, etag, errorcount FROM downloadinfo WHERE path=?1"), _db);
+    if (checkConnectForRead(file)) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetDownloadInfoQuery, QByteArrayLiteral("SELECT tmpfile, etag, errorcount, rangesize, completedranges FROM downloadinfo WHERE path=?1"), _db);
         if (!query) {
             return res;
         }
@@ -1311,6 +1582,12 @@ SyncJournalDb::DownloadInfo SyncJournalDb::getDownloadInfo(const QString &file)
 
         if (query->next().hasData) {
             toDownloadInfo(*query, &res);
+            res._rangeSize = query->int64Value(3);
+            const QByteArray completedRanges = query->baValue(4);
+            res._completedRanges.resize(completedRanges.size());
+            for (int i = 0; i < completedRanges.size(); ++i) {
+                res._completedRanges.setBit(i, completedRanges.at(i) == '1');
+            }
         }
     }
     return res;
@@ -1320,6 +1597,10 @@ void SyncJournalDb::setDownloadInfo(const QString &file, const SyncJournalDb::Do
 {
     QMutexLocker locker(&_mutex);
 
+    if (!i._valid && isWriteBatchingLocked() && queueWriteLocked({ PendingWrite::Type::DeleteDownloadInfo, {}, {}, file })) {
+        return;
+    }
+
     if (!checkConnect()) {
         return;
     }
@@ -1327,8 +1608,8 @@ void SyncJournalDb::setDownloadInfo(const QString &file, const SyncJournalDb::Do
 
     if (i._valid) {
         const auto query = _queryManager.get(PreparedSqlQueryManager::SetDownloadInfoQuery, QByteArrayLiteral("INSERT OR REPLACE INTO downloadinfo "
-                                                                                                              "(path, tmpfile, etag, errorcount) "
-                                                                                                              "VALUES ( ?1 , ?2, ?3, ?4 )"),
+                                                                                                              "(path, tmpfile, etag, errorcount, rangesize, completedranges) "
+                                                                                                              "VALUES ( ?1 , ?2, ?3, ?4, ?5, ?6 )"),
             _db);
         if (!query) {
             return;
@@ -1337,14 +1618,27 @@ void SyncJournalDb::setDownloadInfo(const QString &file, const SyncJournalDb::Do
         query->bindValue(2, i._tmpfile);
         query->bindValue(3, i._etag);
         query->bindValue(4, i._errorCount);
+        query->bindValue(5, i._rangeSize);
+        QByteArray completedRanges(i._completedRanges.size(), '0');
+        for (int bit = 0; bit < i._completedRanges.size(); ++bit) {
+            if (i._completedRanges.testBit(bit)) {
+                completedRanges[bit] = '1';
+            }
+        }
+        query->bindValue(6, completedRanges);
         query->exec();
     } else {
-        const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteDownloadInfoQuery);
-        query->bindValue(1, file);
-        query->exec();
+        deleteDownloadInfoLocked(file);
     }
 }
 
+void SyncJournalDb::deleteDownloadInfoLocked(const QString &file)
+{
+    const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteDownloadInfoQuery);
+    query->bindValue(1, file);
+    query->exec();
+}
+
 QVector<SyncJournalDb::DownloadInfo> SyncJournalDb::getAndDeleteStaleDownloadInfos(const QSet<QString> &keep)
 {
     QVector<SyncJournalDb::DownloadInfo> empty_result;
@@ -1409,7 +1703,7 @@ SyncJournalDb::UploadInfo SyncJournalDb::getUploadInfo(const QString &file)
 
     UploadInfo res;
 
-    if (checkConnect()) {
+    if (checkConnectForRead(file)) {
         const auto query = _queryManager.get(PreparedSqlQueryManager::GetUploadInfoQuery, QByteArrayLiteral("SELECT chunk, transferid, errorcount, size, modtime, contentChecksum FROM "
                                                                                                             "uploadinfo WHERE path=?1"),
             _db);
@@ -1440,6 +1734,10 @@ void SyncJournalDb::setUploadInfo(const QString &file, const SyncJournalDb::Uplo
 {
     QMutexLocker locker(&_mutex);
 
+    if (!i._valid && isWriteBatchingLocked() && queueWriteLocked({ PendingWrite::Type::DeleteUploadInfo, {}, {}, file })) {
+        return;
+    }
+
     if (!checkConnect()) {
         return;
     }
@@ -1465,15 +1763,17 @@ void SyncJournalDb::setUploadInfo(const QString &file, const SyncJournalDb::Uplo
             return;
         }
     } else {
-        const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteUploadInfoQuery);
-        query->bindValue(1, file);
-
-        if (!query->exec()) {
-            return;
-        }
+        deleteUploadInfoLocked(file);
     }
 }
 
+void SyncJournalDb::deleteUploadInfoLocked(const QString &file)
+{
+    const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteUploadInfoQuery);
+    query->bindValue(1, file);
+    query->exec();
+}
+
 QVector<uint> SyncJournalDb::deleteStaleUploadInfos(const QSet<QString> &keep)
 {
     QMutexLocker locker(&_mutex);
@@ -1505,6 +1805,67 @@ QVector<uint> SyncJournalDb::deleteStaleUploadInfos(const QSet<QString> &keep)
     return ids;
 }
 
+SyncJournalDb::BlockChecksums SyncJournalDb::getBlockChecksums(const QString &file)
+{
+    QMutexLocker locker(&_mutex);
+
+    BlockChecksums res;
+
+    if (checkConnect()) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::GetBlockChecksumsQuery, QByteArrayLiteral("SELECT blocksize, etag, checksums FROM "
+                                                                                                                "blockchecksums WHERE path=?1"),
+            _db);
+        if (!query) {
+            return res;
+        }
+        query->bindValue(1, file);
+
+        if (!query->exec()) {
+            return res;
+        }
+
+        if (query->next().hasData) {
+            res._blockSize = query->int64Value(0);
+            res._etag = query->baValue(1);
+            res._checksums = query->baValue(2);
+        }
+    }
+    return res;
+}
+
+void SyncJournalDb::setBlockChecksums(const QString &file, const SyncJournalDb::BlockChecksums &checksums)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (!checkConnect()) {
+        return;
+    }
+
+    if (checksums.isValid()) {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::SetBlockChecksumsQuery, QByteArrayLiteral("INSERT OR REPLACE INTO blockchecksums "
+                                                                                                                "(path, blocksize, etag, checksums) "
+                                                                                                                "VALUES ( ?1 , ?2, ?3 , ?4 )"),
+            _db);
+        if (!query) {
+            return;
+        }
+
+        query->bindValue(1, file);
+        query->bindValue(2, checksums._blockSize);
+        query->bindValue(3, checksums._etag);
+        query->bindValue(4, checksums._checksums);
+        query->exec();
+    } else {
+        const auto query = _queryManager.get(PreparedSqlQueryManager::DeleteBlockChecksumsQuery,
+            QByteArrayLiteral("DELETE FROM blockchecksums WHERE " IS_PREFIX_PATH_OR_EQUAL("?1", "path")), _db);
+        if (!query) {
+            return;
+        }
+        query->bindValue(1, file);
+        query->exec();
+    }
+}
+
 SyncJournalErrorBlacklistRecord SyncJournalDb::errorBlacklistEntry(const QString &file)
 {
     QMutexLocker locker(&_mutex);
@@ -1513,7 +1874,7 @@ SyncJournalErrorBlacklistRecord SyncJournalDb::errorBlacklistEntry(const QString
     if (file.isEmpty())
         return entry;
 
-    if (checkConnect()) {
+    if (checkConnectForRead(file)) {
         const auto query = _queryManager.get(PreparedSqlQueryManager::GetErrorBlacklistQuery);
         query->bindValue(1, file);
         if (query->exec()) {
@@ -1618,14 +1979,22 @@ void SyncJournalDb::wipeErrorBlacklistEntry(const QString &relativeFile)
     Q_ASSERT(QFileInfo(relativeFile).isRelative());
 
     QMutexLocker locker(&_mutex);
+    if (isWriteBatchingLocked() && queueWriteLocked({ PendingWrite::Type::WipeErrorBlacklistEntry, {}, {}, relativeFile })) {
+        return;
+    }
     if (checkConnect()) {
-        SqlQuery query(_db);
+        wipeErrorBlacklistEntryLocked(relativeFile);
+    }
+}
 
-        query.prepare("DELETE FROM blacklist WHERE path=?1");
-        query.bindValue(1, relativeFile);
-        if (!query.exec()) {
-            sqlFail(QStringLiteral("Deletion of blacklist item failed."), query);
-        }
+void SyncJournalDb::wipeErrorBlacklistEntryLocked(const QString &relativeFile)
+{
+    SqlQuery query(_db);
+
+    query.prepare("DELETE FROM blacklist WHERE path=?1");
+    query.bindValue(1, relativeFile);
+    if (!query.exec()) {
+        sqlFail(QStringLiteral("Deletion of blacklist item failed."), query);
     }
 }
 
@@ -1672,10 +2041,18 @@ void SyncJournalDb::setErrorBlacklistEntry(const SyncJournalErrorBlacklistRecord
                  << item._lastTryModtime << item._lastTryEtag << item._renameTarget
                  << item._errorCategory;
 
+    if (isWriteBatchingLocked() && queueWriteLocked({ PendingWrite::Type::SetErrorBlacklistEntry, {}, item, {} })) {
+        return;
+    }
+
     if (!checkConnect()) {
         return;
     }
+    setErrorBlacklistEntryLocked(item);
+}
 
+void SyncJournalDb::setErrorBlacklistEntryLocked(const SyncJournalErrorBlacklistRecord &item)
+{
     const auto query = _queryManager.get(PreparedSqlQueryManager::SetErrorBlacklistQuery, QByteArrayLiteral("INSERT OR REPLACE INTO blacklist "
                                                                                                             "(path, lastTryEtag, lastTryModtime, retrycount, errorstring, lastTryTime, ignoreDuration, renameTarget, errorCategory, requestId) "
                                                                                                             "VALUES ( ?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10)"),
@@ -2215,12 +2592,18 @@ SyncJournalDb::PinStateInterface SyncJournalDb::internalPinStates()
 void SyncJournalDb::commit(const QString &context, bool startTrans)
 {
     QMutexLocker lock(&_mutex);
+    if (!_writeBatch.empty()) {
+        checkConnect(); // writes the batch
+    }
     commitInternal(context, startTrans);
 }
 
 void SyncJournalDb::commitIfNeededAndStartNewTransaction(const QString &context)
 {
     QMutexLocker lock(&_mutex);
+    if (!_writeBatch.empty()) {
+        checkConnect(); // writes the batch
+    }
     if (_transaction == 1) {
         commitInternal(context, true);
     } else {
@@ -2228,6 +2611,43 @@ void SyncJournalDb::commitIfNeededAndStartNewTransaction(const QString &context)
     }
 }
 
+void SyncJournalDb::enableWriteBatching(int maxItems, std::chrono::milliseconds maxAge)
+{
+    QMutexLocker lock(&_mutex);
+    qCInfo(lcDb) << "Batching writes, up to" << maxItems << "updates or" << maxAge.count() << "ms";
+    _writeBatching = true;
+    _writeBatchError.clear();
+    _writeBatchMaxItems = std::max(1, maxItems);
+    _writeBatchMaxAge = maxAge;
+}
+
+Result<void, QString> SyncJournalDb::disableWriteBatching()
+{
+    QMutexLocker lock(&_mutex);
+    if (!_writeBatching) {
+        return {};
+    }
+    _writeBatching = false;
+    if (_writeBatchAge.isValid() && checkConnect()) {
+        commitInternal(QStringLiteral("write batching disabled"));
+    }
+    if (!_writeBatchError.isEmpty()) {
+        return _writeBatchError;
+    }
+    return {};
+}
+
+void SyncJournalDb::commitOrDefer(const QString &context)
+{
+    QMutexLocker lock(&_mutex);
+    if (isWriteBatchingLocked()) {
+        // committed with the next batch, at the latest when it times out
+        startWriteBatchAgeLocked();
+        return;
+    }
+    commitInternal(context);
+}
+
 bool SyncJournalDb::open()
 {
     QMutexLocker lock(&_mutex);
@@ -2244,6 +2664,8 @@ void SyncJournalDb::commitInternal(const QString &context, bool startTrans)
 {
     qCDebug(lcDb) << "Transaction commit" << context << (startTrans ? "and starting new transaction" : "");
     commitTransaction();
+    _writeBatchUncommitted = 0;
+    _writeBatchAge.invalidate();
 
     if (startTrans) {
         startTransaction();
@@ -2262,7 +2684,9 @@ bool operator==(const SyncJournalDb::DownloadInfo &lhs,
     return lhs._errorCount == rhs._errorCount
         && lhs._etag == rhs._etag
         && lhs._tmpfile == rhs._tmpfile
-        && lhs._valid == rhs._valid;
+        && lhs._valid == rhs._valid
+        && lhs._rangeSize == rhs._rangeSize
+        && lhs._completedRanges == rhs._completedRanges;
 }
 
 bool operator==(const SyncJournalDb::UploadInfo &lhs,
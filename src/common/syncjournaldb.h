@@ -21,9 +21,14 @@
 
 #include <QObject>
 #include <qmutex.h>
+#include <QBitArray>
 #include <QDateTime>
 #include <QHash>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <chrono>
 #include <functional>
+#include <vector>
 
 #include "common/checksumalgorithms.h"
 #include "common/ownsql.h"
@@ -105,6 +110,10 @@ public:
         QByteArray _etag;
         int _errorCount;
         bool _valid;
+        /// The size of the ranges the file is downloaded in, 0 for a single GET
+        qint64 _rangeSize = 0;
+        /// The ranges that are already in the temporary file
+        QBitArray _completedRanges;
     };
     struct UploadInfo
     {
@@ -131,6 +140,22 @@ public:
         bool isChunked() const { return _transferid != 0; }
     };
 
+    /**
+     * The checksums of the blocks of a file as it was last uploaded.
+     *
+     * Used to upload only the changed blocks of a modified file, see
+     * PropagateUploadFileNG.
+     */
+    struct BlockChecksums
+    {
+        qint64 _blockSize = 0;
+        /// The etag of the uploaded file, the checksums only describe that version
+        QByteArray _etag;
+        /// The binary digests of the blocks, concatenated
+        QByteArray _checksums;
+        bool isValid() const { return _blockSize > 0 && !_etag.isEmpty(); }
+    };
+
     DownloadInfo getDownloadInfo(const QString &file);
     void setDownloadInfo(const QString &file, const DownloadInfo &i);
     QVector<DownloadInfo> getAndDeleteStaleDownloadInfos(const QSet<QString> &keep);
@@ -141,6 +166,9 @@ public:
     // Return the list of transfer ids that were removed.
     QVector<uint> deleteStaleUploadInfos(const QSet<QString> &keep);
 
+    BlockChecksums getBlockChecksums(const QString &file);
+    void setBlockChecksums(const QString &file, const BlockChecksums &checksums);
+
     SyncJournalErrorBlacklistRecord errorBlacklistEntry(const QString &);
     bool deleteStaleErrorBlacklistEntries(const QSet<QString> &keep);
 
@@ -207,6 +235,28 @@ public:
     void commit(const QString &context, bool startTrans = true);
     void commitIfNeededAndStartNewTransaction(const QString &context);
 
+    /** Write-behind batching of the per item updates done during propagation.
+     *
+     * While enabled setFileRecord(), the removal of download and upload infos
+     * and the error blacklist updates are kept in memory. They are written in
+     * call order before any other write and before lookups of the paths they
+     * touch. They are committed once maxItems were queued or maxAge passed
+     * since the first uncommitted write. The committed state is therefore
+     * always a prefix of the calls made.
+     *
+     * If writing a batched file record fails, the following setFileRecord()
+     * calls and disableWriteBatching() report the error.
+     */
+    void enableWriteBatching(int maxItems, std::chrono::milliseconds maxAge);
+    /// Writes and commits what is pending and stops batching
+    Result<void, QString> disableWriteBatching();
+
+    /** Like commit(), but while write batching is enabled the commit is left to the batch.
+     *
+     * Use it where losing the update on a crash only costs redoing some work.
+     */
+    void commitOrDefer(const QString &context);
+
     /** Open the db if it isn't already.
      *
      * This usually creates some temporary files next to the db file, like
@@ -383,6 +433,13 @@ private:
     void commitTransaction();
     QVector<QByteArray> tableColumns(const QByteArray &table);
     bool checkConnect();
+    /** Like checkConnect(), but only writes the batch if it touches path
+     *
+     * With recursive the updates below path count too, the empty path stands for everything.
+     */
+    bool checkConnectForRead(const QString &path, bool recursive = false);
+    // checkConnect() without writing the batch
+    bool openConnectionLocked();
 
     // Same as forceRemoteDiscoveryNextSync but without acquiring the lock
     void forceRemoteDiscoveryNextSyncLocked();
@@ -392,6 +449,39 @@ private:
     // Returns 0 on failure and for empty checksum types.
     int mapChecksumType(CheckSums::Algorithm checksumType);
 
+    struct PendingWrite
+    {
+        enum class Type {
+            FileRecord,
+            DeleteDownloadInfo,
+            DeleteUploadInfo,
+            SetErrorBlacklistEntry,
+            WipeErrorBlacklistEntry,
+        };
+        Type type;
+        SyncJournalFileRecord record;
+        SyncJournalErrorBlacklistRecord blacklistRecord;
+        QString file;
+    };
+    using PendingWriteIterator = std::vector<PendingWrite>::const_iterator;
+
+    bool isWriteBatchingLocked() const { return _writeBatching && !_closed; }
+    // Returns false if the batch failed, the write wasn't queued then
+    bool queueWriteLocked(PendingWrite &&write);
+    // Starts measuring the age of the batch if nothing is uncommitted yet
+    void startWriteBatchAgeLocked();
+    // Writes the pending batch, called by checkConnect()
+    void flushWriteBatchLocked();
+
+    // The unlocked parts of the batchable writes, they expect an open connection
+    SyncJournalFileRecord filteredFileRecordLocked(const SyncJournalFileRecord &record);
+    Result<void, QString> writeFileRecordsLocked(PendingWriteIterator begin, PendingWriteIterator end);
+    void bindFileRecord(SqlQuery &query, int offset, const SyncJournalFileRecord &record);
+    void deleteDownloadInfoLocked(const QString &file);
+    void deleteUploadInfoLocked(const QString &file);
+    void setErrorBlacklistEntryLocked(const SyncJournalErrorBlacklistRecord &item);
+    void wipeErrorBlacklistEntryLocked(const QString &relativeFile);
+
     SqlDatabase _db;
     QString _dbFile;
     QMutex _mutex; // Public functions are protected with the mutex.
@@ -423,6 +513,21 @@ private:
 
     PreparedSqlQueryManager _queryManager;
 
+    // Consecutive file records of a batch are written with one statement
+    static constexpr int fileRecordsPerInsert = 32;
+    std::vector<PendingWrite> _writeBatch;
+    // The paths touched by _writeBatch
+    QSet<QString> _writeBatchPaths;
+    bool _writeBatching = false;
+    int _writeBatchMaxItems = 0;
+    std::chrono::milliseconds _writeBatchMaxAge { 0 };
+    // Queued writes and the time since the first uncommitted write, reset by commitInternal()
+    int _writeBatchUncommitted = 0;
+    QElapsedTimer _writeBatchAge;
+    QTimer _writeBatchTimer;
+    // Set once a batched file record could not be written
+    QString _writeBatchError;
+
     /**
      * Whether the db was already closed, prevent recreation
      */
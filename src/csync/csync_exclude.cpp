@@ -35,6 +35,8 @@
 #include <QFile>
 #include <QDir>
 
+#include <algorithm>
+
 namespace {
 
 // See http://support.microsoft.com/kb/74496 and
@@ -405,24 +407,20 @@ CSYNC_EXCLUDE_TYPE ExcludedFiles::traversalPatternMatch(const QStringRef &path,
         bnameStr = path.mid(lastSlash + 1);
     }
 
-    QRegularExpressionMatch m;
-    if (filetype == ItemTypeDirectory) {
-        m = _bnameTraversalRegexDir.match(bnameStr);
-    } else {
-        m = _bnameTraversalRegexFile.match(bnameStr);
-    }
-    if (!m.hasMatch())
-        return CSYNC_NOT_EXCLUDED;
-    if (m.capturedStart(QStringLiteral("exclude")) != -1) {
+    const bool isDirectory = filetype == ItemTypeDirectory;
+    if ((isDirectory ? _bnameExcludeDir : _bnameExcludeFile).match(bnameStr)) {
         return CSYNC_FILE_EXCLUDE_LIST;
-    } else if (m.capturedStart(QStringLiteral("excluderemove")) != -1) {
+    } else if ((isDirectory ? _bnameExcludeRemoveDir : _bnameExcludeRemoveFile).match(bnameStr)) {
         return CSYNC_FILE_EXCLUDE_AND_REMOVE;
+    } else if (!(isDirectory ? _bnameTriggerDir : _bnameTriggerFile).match(bnameStr)) {
+        return CSYNC_NOT_EXCLUDED;
     }
 
-    // third capture: full path matching is triggered
+    // full path matching is triggered
     QStringRef pathStr = path;
 
-    if (filetype == ItemTypeDirectory) {
+    QRegularExpressionMatch m;
+    if (isDirectory) {
         m = _fullTraversalRegexDir.match(pathStr);
     } else {
         m = _fullTraversalRegexFile.match(pathStr);
@@ -592,20 +590,80 @@ QString ExcludedFiles::extractBnameTrigger(const QString &exclude, bool wildcard
     return pattern;
 }
 
+void ExcludedFiles::BnameMatcher::clear(Qt::CaseSensitivity caseSensitivity)
+{
+    *this = {};
+    _caseSensitivity = caseSensitivity;
+}
+
+void ExcludedFiles::BnameMatcher::addPattern(const QString &exclude, bool wildcardsMatchSlash)
+{
+    _patterns.append(exclude);
+
+    auto isSpecial = [](QChar c) {
+        return c == QLatin1Char('*') || c == QLatin1Char('?') || c == QLatin1Char('[') || c == QLatin1Char('\\');
+    };
+    auto isLiteral = [&isSpecial](const QStringRef &s) { return std::none_of(s.cbegin(), s.cend(), isSpecial); };
+
+    // A bname never contains a slash, so wildcardsMatchSlash doesn't matter for these
+    if (isLiteral(&exclude)) {
+        _literals.append(exclude);
+    } else if (exclude.startsWith(QLatin1Char('*')) && isLiteral(exclude.midRef(1))) {
+        _suffixes.append(exclude.mid(1));
+    } else if (exclude.endsWith(QLatin1Char('*')) && isLiteral(exclude.leftRef(exclude.size() - 1))) {
+        _prefixes.append(exclude.left(exclude.size() - 1));
+    } else {
+        _regexPatterns.append(convertToRegexpSyntax(exclude, wildcardsMatchSlash));
+    }
+}
+
+void ExcludedFiles::BnameMatcher::finalize()
+{
+    const auto cs = _caseSensitivity;
+    std::sort(_literals.begin(), _literals.end(), [cs](const QString &a, const QString &b) { return a.compare(b, cs) < 0; });
+
+    if (!_regexPatterns.isEmpty()) {
+        _regex.setPattern(QStringLiteral("^(?:%1)$").arg(_regexPatterns.join(QLatin1Char('|'))));
+        _regex.setPatternOptions(cs == Qt::CaseInsensitive ? QRegularExpression::CaseInsensitiveOption : QRegularExpression::NoPatternOption);
+        _regex.optimize();
+    }
+}
+
+bool ExcludedFiles::BnameMatcher::match(const QStringRef &bname) const
+{
+    const auto cs = _caseSensitivity;
+    const auto literal = std::lower_bound(_literals.cbegin(), _literals.cend(), bname,
+        [cs](const QString &a, const QStringRef &b) { return a.compare(b, cs) < 0; });
+    if (literal != _literals.cend() && literal->compare(bname, cs) == 0)
+        return true;
+    for (const auto &suffix : _suffixes) {
+        if (bname.endsWith(suffix, cs))
+            return true;
+    }
+    for (const auto &prefix : _prefixes) {
+        if (bname.startsWith(prefix, cs))
+            return true;
+    }
+    return !_regexPatterns.isEmpty() && _regex.match(bname).hasMatch();
+}
+
 void ExcludedFiles::prepare()
 {
-    // Build regular expressions for the different cases.
+    // Build the matchers and regular expressions for the different cases.
     //
-    // To compose the _bnameTraversalRegex, _fullTraversalRegex and _fullRegex
-    // patterns we collect several subgroups of patterns here.
+    // The bname of a path is checked with the _bname* BnameMatchers, which
+    // handle literal names and simple prefix/suffix globs without a regex.
+    // To compose those and the _fullTraversalRegex and _fullRegex patterns
+    // we collect several subgroups of patterns here.
     //
     // * The "full" group will contain all patterns that contain a non-trailing
     //   slash. They only make sense in the fullRegex and fullTraversalRegex.
     // * The "bname" group contains all patterns without a non-trailing slash.
-    //   These need separate handling in the _fullRegex (slash-containing
-    //   patterns must be anchored to the front, these don't need it)
+    //   They go into the _bnameExclude* matchers, and need separate handling
+    //   in the _fullRegex (slash-containing patterns must be anchored to the
+    //   front, these don't need it)
     // * The "bnameTrigger" group contains the bname part of all patterns in the
-    //   "full" group. These and the "bname" group become _bnameTraversalRegex.
+    //   "full" group. These and the "bname" group go into the _bname* matchers.
     //
     // To complicate matters, the exclude patterns have two binary attributes
     // meaning we'll end up with 4 variants:
@@ -625,8 +683,16 @@ void ExcludedFiles::prepare()
     QString bnameDirKeep;
     QString bnameDirRemove;
 
-    QString bnameTriggerFileDir;
-    QString bnameTriggerDir;
+    const auto caseSensitivity = OCC::Utility::fsCasePreserving() ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    for (auto *matcher : { &_bnameExcludeFile, &_bnameExcludeDir, &_bnameExcludeRemoveFile, &_bnameExcludeRemoveDir, &_bnameTriggerFile, &_bnameTriggerDir }) {
+        matcher->clear(caseSensitivity);
+    }
+    auto matcherAppend = [](BnameMatcher &fileMatcher, BnameMatcher &dirMatcher, const QString &appendMe, bool wildcardsMatchSlash, bool dirOnly) {
+        // Directories are matched by the patterns for files and directories as well
+        if (!dirOnly)
+            fileMatcher.addPattern(appendMe, wildcardsMatchSlash);
+        dirMatcher.addPattern(appendMe, wildcardsMatchSlash);
+    };
 
     auto regexAppend = [](QString &fileDirPattern, QString &dirPattern, const QString &appendMe, bool dirOnly) {
         QString &pattern = dirOnly ? dirPattern : fileDirPattern;
@@ -660,16 +726,21 @@ void ExcludedFiles::prepare()
         auto regexExclude = convertToRegexpSyntax(exclude, _wildcardsMatchSlash);
         if (!fullPath) {
             regexAppend(bnameFileDir, bnameDir, regexExclude, matchDirOnly);
+            matcherAppend(removeExcluded ? _bnameExcludeRemoveFile : _bnameExcludeFile,
+                removeExcluded ? _bnameExcludeRemoveDir : _bnameExcludeDir, exclude, _wildcardsMatchSlash, matchDirOnly);
         } else {
             regexAppend(fullFileDir, fullDir, regexExclude, matchDirOnly);
 
             // For activation, trigger on the 'bname' part of the full pattern.
             QString bnameExclude = extractBnameTrigger(exclude, _wildcardsMatchSlash);
-            auto regexBname = convertToRegexpSyntax(bnameExclude, true);
-            regexAppend(bnameTriggerFileDir, bnameTriggerDir, regexBname, matchDirOnly);
+            matcherAppend(_bnameTriggerFile, _bnameTriggerDir, bnameExclude, true, matchDirOnly);
         }
     }
 
+    for (auto *matcher : { &_bnameExcludeFile, &_bnameExcludeDir, &_bnameExcludeRemoveFile, &_bnameExcludeRemoveDir, &_bnameTriggerFile, &_bnameTriggerDir }) {
+        matcher->finalize();
+    }
+
     // The empty pattern would match everything - change it to match-nothing
     auto emptyMatchNothing = [](QString &pattern) {
         if (pattern.isEmpty())
@@ -685,27 +756,8 @@ void ExcludedFiles::prepare()
     emptyMatchNothing(bnameDirKeep);
     emptyMatchNothing(bnameDirRemove);
 
-    emptyMatchNothing(bnameTriggerFileDir);
-    emptyMatchNothing(bnameTriggerDir);
-
-    // The bname regex is applied to the bname only, so it must be
-    // anchored in the beginning and in the end. It has the structure:
-    // (exclude)|(excluderemove)|(bname triggers).
-    // If the third group matches, the fullActivatedRegex needs to be applied
-    // to the full path.
-    _bnameTraversalRegexFile.setPattern(
-        QStringLiteral("^(?P<exclude>%1)$|"
-                       "^(?P<excluderemove>%2)$|"
-                       "^(?P<trigger>%3)$")
-            .arg(bnameFileDirKeep, bnameFileDirRemove, bnameTriggerFileDir));
-    _bnameTraversalRegexDir.setPattern(
-        QStringLiteral("^(?P<exclude>%1|%2)$|"
-                       "^(?P<excluderemove>%3|%4)$|"
-                       "^(?P<trigger>%5|%6)$")
-            .arg(bnameFileDirKeep, bnameDirKeep, bnameFileDirRemove, bnameDirRemove, bnameTriggerFileDir, bnameTriggerDir));
-
-    // The full traveral regex is applied to the full path if the trigger capture of
-    // the bname regex matches. Its basic form is (exclude)|(excluderemove)".
+    // The full traveral regex is applied to the full path if the bname
+    // trigger matcher matches. Its basic form is (exclude)|(excluderemove)".
     // This pattern can be much simpler than fullRegex since we can assume a traversal
     // situation and doesn't need to look for bname patterns in parent paths.
     _fullTraversalRegexFile.setPattern(
@@ -750,10 +802,6 @@ void ExcludedFiles::prepare()
     QRegularExpression::PatternOptions patternOptions = QRegularExpression::NoPatternOption;
     if (OCC::Utility::fsCasePreserving())
         patternOptions |= QRegularExpression::CaseInsensitiveOption;
-    _bnameTraversalRegexFile.setPatternOptions(patternOptions);
-    _bnameTraversalRegexFile.optimize();
-    _bnameTraversalRegexDir.setPatternOptions(patternOptions);
-    _bnameTraversalRegexDir.optimize();
     _fullTraversalRegexFile.setPatternOptions(patternOptions);
     _fullTraversalRegexFile.optimize();
     _fullTraversalRegexDir.setPatternOptions(patternOptions);
@@ -29,6 +29,7 @@
 #include <QRegularExpression>
 #include <QSet>
 #include <QString>
+#include <QVector>
 #include <QVersionNumber>
 
 #include <functional>
@@ -152,6 +153,37 @@ public slots:
     bool reloadExcludeFiles();
 
 private:
+    /**
+     * Matches a bname against a set of exclude patterns.
+     *
+     * The common patterns - literal names and simple "*suffix" or "prefix*"
+     * globs - are checked without regular expressions. Everything else is
+     * combined into a single anchored regex.
+     */
+    class BnameMatcher
+    {
+    public:
+        void clear(Qt::CaseSensitivity caseSensitivity);
+        void addPattern(const QString &exclude, bool wildcardsMatchSlash);
+        /// Must be called after all patterns were added
+        void finalize();
+
+        bool match(const QStringRef &bname) const;
+
+        /// The patterns as passed to addPattern()
+        const QStringList &patterns() const { return _patterns; }
+
+    private:
+        Qt::CaseSensitivity _caseSensitivity = Qt::CaseSensitive;
+        QStringList _patterns;
+        // sorted, for binary search
+        QVector<QString> _literals;
+        QVector<QString> _prefixes;
+        QVector<QString> _suffixes;
+        QStringList _regexPatterns;
+        QRegularExpression _regex;
+    };
+
     /**
      * Returns true if the version directive indicates the next line
      * should be skipped.
@@ -200,7 +232,7 @@ private:
      *   full("a/b/c/d") == traversal("a") || traversal("a/b") || traversal("a/b/c")
      *
      * The traversal matcher can be extremely fast because it has a fast early-out
-     * case: It checks the bname part of the path against _bnameTraversalRegex
+     * case: It checks the bname part of the path against the _bname* matchers
      * and only runs a simplified _fullTraversalRegex on the whole path if bname
      * activation for it was triggered.
      *
@@ -223,8 +255,12 @@ private:
     QStringList _allExcludes;
 
     /// see prepare()
-    QRegularExpression _bnameTraversalRegexFile;
-    QRegularExpression _bnameTraversalRegexDir;
+    BnameMatcher _bnameExcludeFile;
+    BnameMatcher _bnameExcludeDir;
+    BnameMatcher _bnameExcludeRemoveFile;
+    BnameMatcher _bnameExcludeRemoveDir;
+    BnameMatcher _bnameTriggerFile;
+    BnameMatcher _bnameTriggerDir;
     QRegularExpression _fullTraversalRegexFile;
     QRegularExpression _fullTraversalRegexDir;
     QRegularExpression _fullRegexFile;
@@ -25,6 +25,7 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "csync.h"
 
@@ -34,6 +35,12 @@
 #include <QtCore/QLoggingCategory>
 #include <QtCore/QFile>
 
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+#include <sys/syscall.h>
+// Read the entries with getdents64 directly, in larger batches than readdir does
+#define CSYNC_VIO_LOCAL_GETDENTS
+#endif
+
 Q_LOGGING_CATEGORY(lcCSyncVIOLocal, "sync.csync.vio_local", QtInfoMsg)
 
 /*
@@ -41,19 +48,67 @@ Q_LOGGING_CATEGORY(lcCSyncVIOLocal, "sync.csync.vio_local", QtInfoMsg)
  */
 
 struct csync_vio_handle_t {
-  DIR *dh;
+#ifdef CSYNC_VIO_LOCAL_GETDENTS
+  int fd = -1;
+  QByteArray buffer;
+  int bufferPos = 0;
+  int bufferEnd = 0;
+#else
+  DIR *dh = nullptr;
+#endif
   QString path;
 };
 
+#ifdef CSYNC_VIO_LOCAL_GETDENTS
+static const int getdentsBufferSize = 128 * 1024;
+#endif
+
+static void fillFileStat(const struct stat &sb, csync_file_stat_t *buf)
+{
+    switch (sb.st_mode & S_IFMT) {
+    case S_IFDIR:
+      buf->type = ItemTypeDirectory;
+      break;
+    case S_IFREG:
+      buf->type = ItemTypeFile;
+      break;
+    case S_IFLNK:
+    case S_IFSOCK:
+      buf->type = ItemTypeSoftLink;
+      break;
+    default:
+      buf->type = ItemTypeSkip;
+      break;
+  }
+
+#ifdef __APPLE__
+  if (sb.st_flags & UF_HIDDEN) {
+      buf->is_hidden = true;
+  }
+#endif
+
+  buf->inode = sb.st_ino;
+  buf->modtime = sb.st_mtime;
+  buf->size = sb.st_size;
+}
+
 csync_vio_handle_t *csync_vio_local_opendir(const QString &name) {
     QScopedPointer<csync_vio_handle_t> handle(new csync_vio_handle_t{});
 
     auto dirname = QFile::encodeName(name);
 
+#ifdef CSYNC_VIO_LOCAL_GETDENTS
+    handle->fd = open(dirname.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (handle->fd < 0) {
+        return nullptr;
+    }
+    handle->buffer = QByteArray(getdentsBufferSize, Qt::Uninitialized);
+#else
     handle->dh = opendir(dirname.constData());
     if (!handle->dh) {
         return nullptr;
     }
+#endif
 
     handle->path = name;
     return handle.take();
@@ -61,24 +116,57 @@ csync_vio_handle_t *csync_vio_local_opendir(const QString &name) {
 
 int csync_vio_local_closedir(csync_vio_handle_t *dhandle) {
     Q_ASSERT(dhandle);
+#ifdef CSYNC_VIO_LOCAL_GETDENTS
+    auto rc = close(dhandle->fd);
+#else
     auto rc = closedir(dhandle->dh);
+#endif
     delete dhandle;
     return rc;
 }
 
+#ifdef CSYNC_VIO_LOCAL_GETDENTS
+// Returns the next entry, nullptr at the end or on error (errno is set then)
+static const struct dirent64 *nextEntry(csync_vio_handle_t *handle)
+{
+    if (handle->bufferPos >= handle->bufferEnd) {
+        const auto read = syscall(SYS_getdents64, handle->fd, handle->buffer.data(), handle->buffer.size());
+        if (read <= 0) {
+            return nullptr;
+        }
+        handle->bufferPos = 0;
+        handle->bufferEnd = static_cast<int>(read);
+    }
+    auto entry = reinterpret_cast<const struct dirent64 *>(handle->buffer.constData() + handle->bufferPos);
+    handle->bufferPos += entry->d_reclen;
+    return entry;
+}
+#endif
+
 std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *handle, OCC::Vfs *vfs) {
+#ifdef CSYNC_VIO_LOCAL_GETDENTS
+    const struct dirent64 *dirent = nullptr;
+    const int dirFd = handle->fd;
+    do {
+        dirent = nextEntry(handle);
+        if (dirent == nullptr)
+            return {};
+    } while (qstrcmp(dirent->d_name, ".") == 0 || qstrcmp(dirent->d_name, "..") == 0);
+#else
     struct dirent *dirent = nullptr;
-    std::unique_ptr<csync_file_stat_t> file_stat;
-
+    const int dirFd = dirfd(handle->dh);
     do {
         dirent = readdir(handle->dh);
         if (dirent == nullptr)
             return {};
     } while (qstrcmp(dirent->d_name, ".") == 0 || qstrcmp(dirent->d_name, "..") == 0);
+#endif
+    std::unique_ptr<csync_file_stat_t> file_stat;
 
   file_stat.reset(new csync_file_stat_t);
   file_stat->path = QFile::decodeName(dirent->d_name);
 
+  bool needsStat = true;
   /* Check for availability of d_type, see manpage. */
 #if defined(_DIRENT_HAVE_D_TYPE) || defined(__APPLE__)
   switch (dirent->d_type) {
@@ -86,6 +174,9 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
     case DT_SOCK:
     case DT_CHR:
     case DT_BLK:
+      // Never synced, the type is all we need to know
+      file_stat->type = ItemTypeSkip;
+      needsStat = false;
       break;
     case DT_DIR:
     case DT_REG:
@@ -100,9 +191,15 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *h
   }
 #endif
 
-  if (csync_vio_local_stat(handle->path + QLatin1Char('/') + file_stat->path, file_stat.get()) < 0) {
-      // Will get excluded by _csync_detect_update.
-      file_stat->type = ItemTypeSkip;
+  // Relative to the directory, the kernel doesn't need to resolve the whole path again
+  struct stat sb;
+  if (needsStat) {
+      if (fstatat(dirFd, dirent->d_name, &sb, 0) < 0) {
+          // Will get excluded by _csync_detect_update.
+          file_stat->type = ItemTypeSkip;
+      } else {
+          fillFileStat(sb, file_stat.get());
+      }
   }
 
   // Override type for virtual files if desired
@@ -124,30 +221,6 @@ int csync_vio_local_stat(const QString &uri, csync_file_stat_t *buf)
         return -1;
     }
 
-    switch (sb.st_mode & S_IFMT) {
-    case S_IFDIR:
-      buf->type = ItemTypeDirectory;
-      break;
-    case S_IFREG:
-      buf->type = ItemTypeFile;
-      break;
-    case S_IFLNK:
-    case S_IFSOCK:
-      buf->type = ItemTypeSoftLink;
-      break;
-    default:
-      buf->type = ItemTypeSkip;
-      break;
-  }
-
-#ifdef __APPLE__
-  if (sb.st_flags & UF_HIDDEN) {
-      buf->is_hidden = true;
-  }
-#endif
-
-  buf->inode = sb.st_ino;
-  buf->modtime = sb.st_mtime;
-  buf->size = sb.st_size;
-  return 0;
+    fillFileStat(sb, buf);
+    return 0;
 }
@@ -77,6 +77,9 @@ auto deployedC()
 }
 
 constexpr int SettingsVersionC = 5;
+
+/// The gui hears about the progress of a sync at most this often, except when its status changes
+constexpr auto progressPublishIntervalC = 100ms;
 }
 
 namespace OCC {
@@ -127,9 +130,9 @@ Folder::Folder(const FolderDefinition &definition,
 
         connect(_engine.data(), &SyncEngine::aboutToRemoveAllFiles,
             this, &Folder::slotAboutToRemoveAllFiles);
-        connect(_engine.data(), &SyncEngine::transmissionProgress, this, [this](const ProgressInfo &pi) {
-            emit ProgressDispatcher::instance()->progressInfo(this, pi);
-        });
+        connect(_engine.data(), &SyncEngine::transmissionProgress, this, &Folder::slotTransmissionProgress);
+        _progressPublishTimer.setSingleShot(true);
+        connect(&_progressPublishTimer, &QTimer::timeout, this, &Folder::publishProgress);
         connect(_engine.data(), &SyncEngine::itemCompleted,
             this, &Folder::slotItemCompleted);
         connect(_engine.data(), &SyncEngine::newBigFolder,
@@ -248,6 +251,7 @@ SyncOptions Folder::loadSyncOptions()
     opt._minChunkSize = cfgFile.minChunkSize();
     opt._maxChunkSize = cfgFile.maxChunkSize();
     opt._targetChunkUploadDuration = cfgFile.targetChunkUploadDuration();
+    opt._downloadBufferSize = cfgFile.downloadBufferSize();
 
     opt.fillFromEnvironmentVariables();
     opt.verifyChunkSizes();
@@ -1130,6 +1134,33 @@ void Folder::slotItemCompleted(const SyncFileItemPtr &item)
     emit ProgressDispatcher::instance()->itemCompleted(this, item);
 }
 
+void Folder::slotTransmissionProgress(const ProgressInfo &progress)
+{
+    // The engine's ProgressInfo lives as long as the engine, it holds the latest state when the timer fires
+    _pendingProgress = &progress;
+    const auto sincePublished = std::chrono::milliseconds(_timeSinceProgressPublished.elapsed());
+    if (progress.status() != _publishedProgressStatus
+        || !_timeSinceProgressPublished.isValid()
+        || sincePublished >= progressPublishIntervalC) {
+        publishProgress();
+    } else if (!_progressPublishTimer.isActive()) {
+        _progressPublishTimer.start(progressPublishIntervalC - sincePublished);
+    }
+}
+
+void Folder::publishProgress()
+{
+    _progressPublishTimer.stop();
+    if (!_pendingProgress) {
+        return;
+    }
+    const ProgressInfo &progress = *_pendingProgress;
+    _pendingProgress = nullptr;
+    _publishedProgressStatus = progress.status();
+    _timeSinceProgressPublished.start();
+    emit ProgressDispatcher::instance()->progressInfo(this, progress);
+}
+
 void Folder::slotNewBigFolderDiscovered(const QString &newF, bool isExternal)
 {
     auto newFolder = newF;
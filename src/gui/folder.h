@@ -447,6 +447,16 @@ private slots:
 
     void slotItemCompleted(const SyncFileItemPtr &);
 
+    /** Forwards the progress of the engine to the ProgressDispatcher
+     *
+     * The engine reports every chunk and every finished item, with hundreds of
+     * small files in parallel that would keep the gui busy with redrawing. The
+     * updates are coalesced to one per progressPublishIntervalC, only a change
+     * of the sync status is forwarded right away.
+     */
+    void slotTransmissionProgress(const ProgressInfo &progress);
+    void publishProgress();
+
     void etagRetreived(const QByteArray &, const QDateTime &tp);
     void etagRetrievedFromSyncEngine(const QByteArray &, const QDateTime &time);
 
@@ -525,6 +535,12 @@ private:
 
     QTimer _scheduleSelfTimer;
 
+    QTimer _progressPublishTimer;
+    QElapsedTimer _timeSinceProgressPublished;
+    /// The progress that wasn't published yet, owned by the engine
+    const ProgressInfo *_pendingProgress = nullptr;
+    ProgressInfo::Status _publishedProgressStatus = ProgressInfo::None;
+
     /**
      * When the same local path is synced to multiple accounts, only one
      * of them can be stored in the settings in a way that's compatible
@@ -22,6 +22,7 @@
 #include "filesystem.h"
 #include "folder.h"
 #include "lockwatcher.h"
+#include "owncloudpropagator.h"
 #include "selectivesyncdialog.h"
 #include "socketapi/socketapi.h"
 #include "syncresult.h"
@@ -133,7 +134,7 @@ FolderMan *FolderMan::_instance = nullptr;
 
 FolderMan::FolderMan(QObject *parent)
     : QObject(parent)
-    , _currentSyncFolder(nullptr)
+    , _maxConcurrentSyncs(ConfigFile().maxConcurrentSyncs())
     , _syncEnabled(true)
     , _lockWatcher(new LockWatcher)
 #ifdef Q_OS_WIN
@@ -146,6 +147,10 @@ FolderMan::FolderMan(QObject *parent)
 
     _socketApi.reset(new SocketApi);
 
+    // With several folders syncing at the same time, don't let their network
+    // jobs add up beyond what a single account connection can reasonably take.
+    OwncloudPropagator::setGlobalMaximumActiveJobs(ConfigFile().globalParallelNetworkJobs());
+
     // Set the remote poll interval fixed to 10 seconds.
     // That does not mean that it polls every 10 seconds, but it checks every 10 seconds
     // if one of the folders is due to sync. This means that if the server advertises a
@@ -223,7 +228,7 @@ void FolderMan::unloadAndDeleteAllFolders()
         folder->deleteLater();
     }
     _lastSyncFolder = nullptr;
-    _currentSyncFolder = nullptr;
+    _currentSyncFolders.clear();
     _scheduledFolders.clear();
     emit folderListChanged();
     emit scheduleQueueChanged();
@@ -659,7 +664,7 @@ void FolderMan::startScheduledSyncSoon()
     if (_scheduledFolders.empty()) {
         return;
     }
-    if (isAnySyncRunning()) {
+    if (!hasFreeSyncSlot()) {
         return;
     }
 
@@ -694,7 +699,7 @@ void FolderMan::startScheduledSyncSoon()
   */
 void FolderMan::slotStartScheduledFolderSync()
 {
-    if (isAnySyncRunning()) {
+    if (!hasFreeSyncSlot()) {
         for (auto *f : qAsConst(_folders)) {
             if (f->isSyncRunning())
                 qCInfo(lcFolderMan) << "Currently folder " << f->remoteUrl().toString() << " is running, wait for finish!";
@@ -712,29 +717,74 @@ void FolderMan::slotStartScheduledFolderSync()
         return;
     }
 
-    // Find the first folder in the queue that can be synced.
-    Folder *folder = nullptr;
-    while (!_scheduledFolders.isEmpty()) {
-        Folder *g = _scheduledFolders.dequeue();
-        if (g->canSync()) {
-            folder = g;
+    // Fill all free slots with folders from the queue.
+    while (hasFreeSyncSlot()) {
+        Folder *folder = takeNextScheduledFolder();
+        if (!folder) {
             break;
         }
-    }
 
-    emit scheduleQueueChanged();
-
-    // Start syncing this folder!
-    if (folder) {
         // Safe to call several times, and necessary to try again if
         // the folder path didn't exist previously.
         folder->registerFolderWatcher();
         registerFolderWithSocketApi(folder);
 
-        _currentSyncFolder = folder;
+        _currentSyncFolders.append(folder);
         qCInfo(lcFolderMan) << "Start scheduled sync of" << folder->path();
         folder->startSync();
     }
+
+    emit scheduleQueueChanged();
+}
+
+bool FolderMan::hasFreeSyncSlot() const
+{
+    int running = 0;
+    for (auto *f : qAsConst(_folders)) {
+        if (f->isSyncRunning() || _currentSyncFolders.contains(f)) {
+            running++;
+        }
+    }
+    return running < _maxConcurrentSyncs;
+}
+
+Folder *FolderMan::takeNextScheduledFolder()
+{
+    // Drop folders that can't be synced, like the single-sync scheduler did.
+    QMutableListIterator<Folder *> it(_scheduledFolders);
+    while (it.hasNext()) {
+        if (!it.next()->canSync()) {
+            it.remove();
+        }
+    }
+
+    QSet<AccountState *> busyAccounts;
+    for (auto *f : qAsConst(_folders)) {
+        if (f->isSyncRunning() || _currentSyncFolders.contains(f)) {
+            busyAccounts.insert(f->accountState().data());
+        }
+    }
+
+    // Folders that are still syncing stay queued for another run. Among the
+    // others, give accounts that are idle a chance before the busy ones.
+    int candidate = -1;
+    for (int i = 0; i < _scheduledFolders.size(); ++i) {
+        Folder *f = _scheduledFolders.at(i);
+        if (f->isSyncRunning() || _currentSyncFolders.contains(f)) {
+            continue;
+        }
+        if (!busyAccounts.contains(f->accountState().data())) {
+            candidate = i;
+            break;
+        }
+        if (candidate == -1) {
+            candidate = i;
+        }
+    }
+    if (candidate == -1) {
+        return nullptr;
+    }
+    return _scheduledFolders.takeAt(candidate);
 }
 
 void FolderMan::slotEtagPollTimerTimeout()
@@ -847,8 +897,10 @@ void FolderMan::slotScheduleFolderByTime()
 
 bool FolderMan::isAnySyncRunning() const
 {
-    if (_currentSyncFolder)
-        return true;
+    for (const auto &f : _currentSyncFolders) {
+        if (f)
+            return true;
+    }
 
     for (auto f : _folders) {
         if (f->isSyncRunning())
@@ -893,12 +945,11 @@ void FolderMan::slotFolderSyncFinished(const SyncResult &)
                         << "] with remote ["
                         << f->remoteUrl().toDisplayString()
                         << "]";
-    if (f == _currentSyncFolder) {
-        _lastSyncFolder = _currentSyncFolder;
-        _currentSyncFolder = nullptr;
+    if (_currentSyncFolders.removeAll(f) > 0) {
+        _lastSyncFolder = f;
     }
-    if (!isAnySyncRunning())
-        startScheduledSyncSoon();
+    _currentSyncFolders.removeAll(QPointer<Folder>());
+    startScheduledSyncSoon();
 }
 
 Folder *FolderMan::addFolder(const AccountStatePtr &accountState, const FolderDefinition &folderDefinition)
@@ -1345,9 +1396,15 @@ QQueue<Folder *> FolderMan::scheduleQueue() const
     return _scheduledFolders;
 }
 
-Folder *FolderMan::currentSyncFolder() const
+QVector<Folder *> FolderMan::currentSyncFolders() const
 {
-    return _currentSyncFolder;
+    QVector<Folder *> out;
+    out.reserve(_currentSyncFolders.size());
+    for (const auto &f : _currentSyncFolders) {
+        if (f)
+            out.append(f);
+    }
+    return out;
 }
 
 void FolderMan::restartApplication()
@@ -214,14 +214,14 @@ public:
     QQueue<Folder *> scheduleQueue() const;
 
     /**
-     * Access to the currently syncing folder.
+     * Access to the currently syncing folders.
      *
-     * Note: This is only the folder that's currently syncing *as-scheduled*. There
+     * Note: These are only the folders that are currently syncing *as-scheduled*. There
      * may be externally-managed syncs such as from placeholder hydrations.
      *
      * See also isAnySyncRunning()
      */
-    Folder *currentSyncFolder() const;
+    QVector<Folder *> currentSyncFolders() const;
 
     /**
      * Returns true if any folder is currently syncing.
@@ -236,7 +236,7 @@ public:
 
     /**
      * If enabled is set to false, no new folders will start to sync.
-     * The current one will finish.
+     * The current ones will finish.
      */
     void setSyncEnabled(bool);
 
@@ -350,6 +350,17 @@ private:
     /** Will start a sync after a bit of delay. */
     void startScheduledSyncSoon();
 
+    /** Whether fewer than ConfigFile::maxConcurrentSyncs() folders are syncing */
+    bool hasFreeSyncSlot() const;
+
+    /** Removes and returns the next folder from the queue that should start syncing
+     *
+     * Folders that are already syncing stay in the queue. Folders of accounts
+     * that don't have a sync running yet are preferred, otherwise the queue
+     * order is kept.
+     */
+    Folder *takeNextScheduledFolder();
+
     // finds all folder configuration files
     // and create the folders
     QString getBackupName(QString fullPathName) const;
@@ -365,8 +376,9 @@ private:
     QSet<Folder *> _disabledFolders;
     QVector<Folder *> _folders;
     QString _folderConfigPath;
-    QPointer<Folder> _currentSyncFolder;
+    QVector<QPointer<Folder>> _currentSyncFolders;
     QPointer<Folder> _lastSyncFolder;
+    int _maxConcurrentSyncs;
     bool _syncEnabled;
 
     /// Folder aliases from the settings that weren't read
@@ -386,7 +398,7 @@ private:
     /// Scheduled folders that should be synced as soon as possible
     QQueue<Folder *> _scheduledFolders;
 
-    /// Picks the next scheduled folder and starts the sync
+    /// Picks the next scheduled folders and starts the syncs
     QTimer _startScheduledSyncTimer;
 
     QScopedPointer<SocketApi> _socketApi;
@@ -79,7 +79,7 @@ public:
      */
     void startNotificatonTest(const QString &path);
 
-    /// For testing linux behavior only
+    /// For testing linux behavior only, -1 if no inotify watches are used
     int testLinuxWatchCount() const;
 
 signals:
@@ -15,6 +15,9 @@
 #include "config.h"
 
 #include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/fanotify.h>
 #include <sys/inotify.h>
 #include <unistd.h>
 
@@ -25,6 +28,36 @@
 #include <QStringList>
 #include <QVarLengthArray>
 
+namespace {
+
+// Filter out journal changes - redundant with filtering in FolderWatcher::pathIsIgnored.
+bool isJournalFile(const QByteArray &fileName)
+{
+    return fileName.startsWith("._sync_")
+        || fileName.startsWith(".csync_journal.db")
+        || fileName.startsWith(".sync_");
+}
+
+// The filesystem mark reports the directories outside of the folder too
+constexpr int handleCacheSizeC = 10000;
+
+#ifdef FAN_REPORT_DFID_NAME
+// The handle of a path in the format of the fanotify events, empty on failure
+QByteArray pathHandle(const QByteArray &path)
+{
+    QByteArray handle(sizeof(file_handle) + MAX_HANDLE_SZ, Qt::Uninitialized);
+    auto *fileHandle = reinterpret_cast<file_handle *>(handle.data());
+    fileHandle->handle_bytes = MAX_HANDLE_SZ;
+    int mountId;
+    if (name_to_handle_at(AT_FDCWD, path.constData(), fileHandle, &mountId, 0) == -1) {
+        return QByteArray();
+    }
+    handle.resize(sizeof(file_handle) + fileHandle->handle_bytes);
+    return handle;
+}
+#endif
+}
+
 namespace OCC {
 
 FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path)
@@ -32,6 +65,10 @@ FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path
     , _parent(p)
     , _folder(path)
 {
+    if (fanotifyInit(path)) {
+        return;
+    }
+
     _fd = inotify_init();
     if (_fd != -1) {
         _socket.reset(new QSocketNotifier(_fd, QSocketNotifier::Read));
@@ -43,6 +80,85 @@ FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path
     QMetaObject::invokeMethod(this, "slotAddFolderRecursive", Q_ARG(QString, path));
 }
 
+FolderWatcherPrivate::~FolderWatcherPrivate()
+{
+    _socket.reset();
+    if (_fd != -1) {
+        close(_fd);
+    }
+    if (_mountFd != -1) {
+        close(_mountFd);
+    }
+}
+
+bool FolderWatcherPrivate::fanotifyInit(const QString &path)
+{
+#ifdef FAN_REPORT_DFID_NAME
+    if (qEnvironmentVariableIsSet("OWNCLOUD_DISABLE_FANOTIFY")) {
+        return false;
+    }
+    _canonicalFolder = QFileInfo(path).canonicalFilePath();
+    if (_canonicalFolder.isEmpty()) {
+        return false;
+    }
+
+    // Fails with EPERM without CAP_SYS_ADMIN and with EINVAL before Linux 5.9
+    const int fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY | O_CLOEXEC | O_LARGEFILE);
+    if (fd == -1) {
+        qCInfo(lcFolderWatcher) << "fanotify_init() failed, using inotify:" << strerror(errno);
+        return false;
+    }
+
+    const QByteArray nativePath = QFile::encodeName(_canonicalFolder);
+    const uint64_t mask = FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_ATTRIB | FAN_CLOSE_WRITE | FAN_ONDIR;
+    // Only a filesystem mark reports these events with directory handles, a mount mark is refused with EINVAL
+    if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask, AT_FDCWD, nativePath.constData()) == -1) {
+        qCInfo(lcFolderWatcher) << "fanotify_mark() failed, using inotify:" << strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    _mountFd = open(nativePath.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (_mountFd == -1) {
+        qCInfo(lcFolderWatcher) << "Could not open the folder for fanotify, using inotify:" << strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    // open_by_handle_at() needs CAP_DAC_READ_SEARCH, which isn't implied by the
+    // permission to use fanotify: without it no event could be resolved
+    const QByteArray folderHandle = pathHandle(nativePath);
+    if (folderHandle.isEmpty() || fanotifyDirectoryPath(folderHandle) != _canonicalFolder) {
+        qCInfo(lcFolderWatcher) << "Could not resolve the handle of the folder, using inotify";
+        _handleToPath.clear();
+        close(_mountFd);
+        _mountFd = -1;
+        close(fd);
+        return false;
+    }
+    _handleToPath.clear();
+    // Changes next to the folder and its parents are common, don't open their handles for every event
+    _folderHandleToPath.insert(folderHandle, _canonicalFolder);
+    for (QString ancestor = _canonicalFolder; ancestor != QLatin1String("/");) {
+        ancestor = QFileInfo(ancestor).path();
+        const QByteArray handle = pathHandle(QFile::encodeName(ancestor));
+        if (!handle.isEmpty()) {
+            _folderHandleToPath.insert(handle, ancestor);
+        }
+    }
+
+    _fd = fd;
+    _folder = QDir(path).absolutePath();
+    _socket.reset(new QSocketNotifier(_fd, QSocketNotifier::Read));
+    connect(_socket.data(), &QSocketNotifier::activated, this, &FolderWatcherPrivate::slotReceivedFanotifyNotification);
+    qCInfo(lcFolderWatcher) << "Watching" << _folder << "with fanotify";
+    return true;
+#else
+    Q_UNUSED(path);
+    return false;
+#endif
+}
+
 // attention: result list passed by reference!
 bool FolderWatcherPrivate::findFoldersBelow(const QDir &dir, QStringList &fullList)
 {
@@ -172,11 +288,7 @@ void FolderWatcherPrivate::slotReceivedNotification(int fd)
         }
 
         const QByteArray fileName(event->name);
-
-        // Filter out journal changes - redundant with filtering in FolderWatcher::pathIsIgnored.
-        if (fileName.startsWith("._sync_")
-            || fileName.startsWith(".csync_journal.db")
-            || fileName.startsWith(".sync_")) {
+        if (isJournalFile(fileName)) {
             continue;
         }
 
@@ -221,4 +333,119 @@ void FolderWatcherPrivate::removeFoldersBelow(const QString &path)
     }
 }
 
+void FolderWatcherPrivate::slotReceivedFanotifyNotification(int fd)
+{
+#ifdef FAN_REPORT_DFID_NAME
+    alignas(fanotify_event_metadata) char buffer[8192];
+
+    forever {
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            // EAGAIN: all pending events were read
+            break;
+        }
+
+        for (auto *metadata = reinterpret_cast<fanotify_event_metadata *>(buffer);
+             FAN_EVENT_OK(metadata, len);
+             metadata = FAN_EVENT_NEXT(metadata, len)) {
+            if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+                qCWarning(lcFolderWatcher) << "Unexpected fanotify metadata version" << metadata->vers;
+                return;
+            }
+            if (metadata->mask & FAN_Q_OVERFLOW) {
+                qCWarning(lcFolderWatcher) << "The fanotify event queue overflowed";
+                emit _parent->lostChanges();
+                continue;
+            }
+
+            const auto *info = reinterpret_cast<const fanotify_event_info_fid *>(reinterpret_cast<const char *>(metadata) + metadata->metadata_len);
+            if (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME && info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID) {
+                continue;
+            }
+            const auto *handle = reinterpret_cast<const file_handle *>(info->handle);
+            // The name of the entry follows the directory handle, "." for events on the directory itself
+            QByteArray fileName;
+            if (info->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                fileName = QByteArray(reinterpret_cast<const char *>(handle->f_handle + handle->handle_bytes));
+            }
+            if (isJournalFile(fileName)) {
+                continue;
+            }
+
+            const QString directory = fanotifyDirectoryPath(
+                QByteArray(reinterpret_cast<const char *>(handle), sizeof(file_handle) + handle->handle_bytes));
+            if (directory.isEmpty()) {
+                // The directory was deleted in the meantime
+                continue;
+            }
+
+            QString canonicalPath = directory;
+            if (!fileName.isEmpty() && fileName != ".") {
+                canonicalPath += QLatin1Char('/') + QFile::decodeName(fileName);
+                // The cached paths of a moved or deleted directory and its children are wrong now
+                if ((metadata->mask & FAN_ONDIR) && (metadata->mask & (FAN_MOVED_FROM | FAN_MOVED_TO | FAN_DELETE))) {
+                    fanotifyForgetPath(canonicalPath);
+                }
+            }
+            if (!canonicalPath.startsWith(_canonicalFolder)
+                || canonicalPath.size() <= _canonicalFolder.size()
+                || canonicalPath.at(_canonicalFolder.size()) != QLatin1Char('/')) {
+                continue;
+            }
+            _parent->changeDetected(_folder + canonicalPath.mid(_canonicalFolder.size()));
+        }
+    }
+#else
+    Q_UNUSED(fd);
+#endif
+}
+
+QString FolderWatcherPrivate::fanotifyDirectoryPath(const QByteArray &handle)
+{
+#ifdef FAN_REPORT_DFID_NAME
+    const auto folderIt = _folderHandleToPath.constFind(handle);
+    if (folderIt != _folderHandleToPath.cend()) {
+        return *folderIt;
+    }
+    const auto it = _handleToPath.constFind(handle);
+    if (it != _handleToPath.cend()) {
+        return *it;
+    }
+
+    // open_by_handle_at() takes a non-const handle
+    QByteArray handleCopy = handle;
+    const int dirFd = open_by_handle_at(_mountFd, reinterpret_cast<file_handle *>(handleCopy.data()), O_PATH | O_CLOEXEC);
+    if (dirFd == -1) {
+        return QString();
+    }
+    char target[PATH_MAX];
+    const ssize_t len = readlink(QByteArrayLiteral("/proc/self/fd/").append(QByteArray::number(dirFd)).constData(), target, sizeof(target));
+    close(dirFd);
+    if (len <= 0) {
+        return QString();
+    }
+
+    if (_handleToPath.size() >= handleCacheSizeC) {
+        // Drop an arbitrary entry, the order of the hash is unrelated to their use
+        _handleToPath.erase(_handleToPath.begin());
+    }
+    return *_handleToPath.insert(handle, QFile::decodeName(QByteArray(target, len)));
+#else
+    Q_UNUSED(handle);
+    return QString();
+#endif
+}
+
+void FolderWatcherPrivate::fanotifyForgetPath(const QString &canonicalPath)
+{
+    const QString pathSlash = canonicalPath + QLatin1Char('/');
+    for (auto it = _handleToPath.begin(); it != _handleToPath.end();) {
+        if (*it == canonicalPath || it->startsWith(pathSlash)) {
+            it = _handleToPath.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 } // ns mirall
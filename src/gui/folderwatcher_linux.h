@@ -28,8 +28,20 @@ class QTimer;
 namespace OCC {
 
 /**
- * @brief Linux (inotify) API implementation of FolderWatcher
+ * @brief Linux (fanotify or inotify) API implementation of FolderWatcher
  * @ingroup gui
+ *
+ * If the kernel supports FAN_REPORT_DFID_NAME (Linux 5.9) and we are allowed
+ * to (CAP_SYS_ADMIN to mark the filesystem, CAP_DAC_READ_SEARCH to open the
+ * directory handles), a single fanotify mark on the filesystem of the folder
+ * reports all changes below it. The events carry the handle of the parent
+ * directory and the name of the changed entry, so no per-directory watches
+ * have to be set up. The mark covers the whole filesystem: the handles of the
+ * folder and its parents are resolved up front, and the paths of the other
+ * directories are cached.
+ *
+ * Otherwise every directory is registered with inotify.
+ * Set OWNCLOUD_DISABLE_FANOTIFY to always use inotify.
  */
 class FolderWatcherPrivate : public QObject
 {
@@ -37,8 +49,10 @@ class FolderWatcherPrivate : public QObject
 public:
     FolderWatcherPrivate() {}
     FolderWatcherPrivate(FolderWatcher *p, const QString &path);
+    ~FolderWatcherPrivate() override;
 
-    int testWatchCount() const { return _pathToWatch.size(); }
+    /// -1 with fanotify, there are no per-directory watches
+    int testWatchCount() const { return _mountFd == -1 ? _pathToWatch.size() : -1; }
 
     /// On linux the watcher is ready when the ctor finished.
     constexpr bool isReady() const { return true; }
@@ -46,20 +60,34 @@ public:
 protected slots:
     void slotReceivedNotification(int fd);
     void slotAddFolderRecursive(const QString &path);
+    void slotReceivedFanotifyNotification(int fd);
 
 protected:
     bool findFoldersBelow(const QDir &dir, QStringList &fullList);
     void inotifyRegisterPath(const QString &path);
     void removeFoldersBelow(const QString &path);
 
+    bool fanotifyInit(const QString &path);
+    QString fanotifyDirectoryPath(const QByteArray &handle);
+    void fanotifyForgetPath(const QString &canonicalPath);
+
 private:
-    FolderWatcher *_parent;
+    FolderWatcher *_parent = nullptr;
 
     QString _folder;
     QHash<int, QString> _watchToPath;
     QMap<QString, int> _pathToWatch;
     QScopedPointer<QSocketNotifier> _socket;
-    int _fd;
+    int _fd = -1;
+
+    /// The canonical path of _folder, as the kernel reports it
+    QString _canonicalFolder;
+    /// An fd of the folder, the mount for open_by_handle_at()
+    int _mountFd = -1;
+    /// Cache of the paths of the directory handles reported by fanotify
+    QHash<QByteArray, QString> _handleToPath;
+    /// The paths of the handles of the folder and its parents, never evicted from the cache
+    QHash<QByteArray, QString> _folderHandleToPath;
 };
 }
 
@@ -129,6 +129,9 @@ ownCloudGui::ownCloudGui(Application *parent)
     ProgressDispatcher *pd = ProgressDispatcher::instance();
     connect(pd, &ProgressDispatcher::progressInfo, this,
         &ownCloudGui::slotUpdateProgress);
+    // The progress is coalesced, completed items are reported one by one
+    connect(pd, &ProgressDispatcher::itemCompleted, this,
+        &ownCloudGui::slotAddRecentItem);
 
     FolderMan *folderMan = FolderMan::instance();
     connect(folderMan, &FolderMan::folderSyncStateChange,
@@ -916,36 +919,35 @@ void ownCloudGui::slotUpdateProgress(Folder *folder, const ProgressInfo &progres
         }
         _actionStatus->setText(msg);
     }
+}
 
-    _actionRecent->setIcon(QIcon()); // Fixme: Set a "in-progress"-item eventually.
-
-    if (!progress._lastCompletedItem.isEmpty()
-        && shouldShowInRecentsMenu(progress._lastCompletedItem)) {
-        if (Progress::isWarningKind(progress._lastCompletedItem._status)) {
-            // display a warn icon if warnings happened.
-            _actionRecent->setIcon(Utility::getCoreIcon(QStringLiteral("warning")));
-        }
+void ownCloudGui::slotAddRecentItem(Folder *folder, const SyncFileItemPtr &item)
+{
+    if (!shouldShowInRecentsMenu(*item)) {
+        return;
+    }
+    // display a warn icon if warnings happened.
+    _actionRecent->setIcon(Progress::isWarningKind(item->_status) ? Utility::getCoreIcon(QStringLiteral("warning")) : QIcon());
 
-        QString kindStr = Progress::asResultString(progress._lastCompletedItem);
-        QString timeStr = QTime::currentTime().toString(QStringLiteral("hh:mm"));
-        QString actionText = tr("%1 (%2, %3)").arg(progress._lastCompletedItem._file, kindStr, timeStr);
-        QAction *action = new QAction(actionText, this);
-        QString fullPath = folder->path() + QLatin1Char('/') + progress._lastCompletedItem._file;
-        if (QFile(fullPath).exists()) {
-            connect(action, &QAction::triggered, this, [this, fullPath] { this->slotOpenPath(fullPath); });
-        } else {
-            action->setEnabled(false);
-        }
-        if (_recentItemsActions.length() > 5) {
-            _recentItemsActions.takeFirst()->deleteLater();
-        }
-        _recentItemsActions.append(action);
+    QString kindStr = Progress::asResultString(*item);
+    QString timeStr = QTime::currentTime().toString(QStringLiteral("hh:mm"));
+    QString actionText = tr("%1 (%2, %3)").arg(item->_file, kindStr, timeStr);
+    QAction *action = new QAction(actionText, this);
+    QString fullPath = folder->path() + QLatin1Char('/') + item->_file;
+    if (QFile(fullPath).exists()) {
+        connect(action, &QAction::triggered, this, [this, fullPath] { this->slotOpenPath(fullPath); });
+    } else {
+        action->setEnabled(false);
+    }
+    if (_recentItemsActions.length() > 5) {
+        _recentItemsActions.takeFirst()->deleteLater();
+    }
+    _recentItemsActions.append(action);
 
-        // Update the "Recent" menu if the context menu is being shown,
-        // otherwise it'll be updated later, when the context menu is opened.
-        if (updateWhileVisible() && contextMenuVisible()) {
-            slotRebuildRecentMenus();
-        }
+    // Update the "Recent" menu if the context menu is being shown,
+    // otherwise it'll be updated later, when the context menu is opened.
+    if (updateWhileVisible() && contextMenuVisible()) {
+        slotRebuildRecentMenus();
     }
 }
 
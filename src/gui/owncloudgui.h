@@ -86,6 +86,7 @@ public slots:
     void slotFolderOpenAction(Folder *f);
     void slotRebuildRecentMenus();
     void slotUpdateProgress(Folder *folder, const ProgressInfo &progress);
+    void slotAddRecentItem(Folder *folder, const SyncFileItemPtr &item);
     void slotShowGuiMessage(const QString &title, const QString &message);
     void slotFoldersChanged();
     void slotShowSettings();
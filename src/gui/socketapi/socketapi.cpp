@@ -35,6 +35,7 @@
 #include "syncfileitem.h"
 #include "theme.h"
 
+#include <algorithm>
 #include <array>
 #include <QBitArray>
 #include <QUrl>
@@ -71,10 +72,16 @@
 // This is the version that is returned when the client asks for the VERSION.
 // The first number should be changed if there is an incompatible change that breaks old clients.
 // The second number should be changed when there are new features.
-#define MIRALL_SOCKET_API_VERSION "1.1"
+#define MIRALL_SOCKET_API_VERSION "1.2"
+
+using namespace std::chrono_literals;
 
 namespace {
 
+// How long status pushes are collected before they are sent to the clients
+constexpr auto statusPushIntervalC = 100ms;
+
+
 const QString unregisterpathMessageC()
 {
     return QStringLiteral("UNREGISTER_PATH");
@@ -212,6 +219,29 @@ SocketApi::SocketApi(QObject *parent)
     qRegisterMetaType<QSharedPointer<SocketApiJob>>("QSharedPointer<SocketApiJob>");
     qRegisterMetaType<QSharedPointer<SocketApiJobV2>>("QSharedPointer<SocketApiJobV2>");
 
+    // Resolve the commands once, not by the signature for every message
+    for (int i = staticMetaObject.methodOffset(); i < staticMetaObject.methodCount(); ++i) {
+        const QMetaMethod method = staticMetaObject.method(i);
+        QString command = QString::fromUtf8(method.name());
+        if (!command.startsWith(QLatin1String("command_"))) {
+            continue;
+        }
+        command.remove(0, 8);
+        QByteArray parameters = QByteArrayLiteral("(QString,SocketListener*)");
+        if (command.startsWith(QLatin1String("ASYNC_"))) {
+            parameters = QByteArrayLiteral("(QSharedPointer<SocketApiJob>)");
+        } else if (command.startsWith(QLatin1String("V2_"))) {
+            command.replace(0, 3, QStringLiteral("V2/"));
+            parameters = QByteArrayLiteral("(QSharedPointer<SocketApiJobV2>)");
+        }
+        OC_ASSERT(method.methodSignature().endsWith(parameters));
+        _commands.insert(command, method);
+    }
+
+    _statusPushTimer.setSingleShot(true);
+    _statusPushTimer.setInterval(statusPushIntervalC);
+    connect(&_statusPushTimer, &QTimer::timeout, this, &SocketApi::sendPendingStatusPushes);
+
     const QString socketPath = Utility::socketApiSocketPath();
 
     // Remove any old socket that might be lying around:
@@ -318,23 +348,11 @@ void SocketApi::slotReadSocket()
         qCInfo(lcSocketApi) << "Received SocketAPI message <--" << line << "from" << socket;
         const int argPos = line.indexOf(QLatin1Char(':'));
         const QString command = line.mid(0, argPos).toUpper();
-        const int indexOfMethod = [&] {
-            QByteArray functionWithArguments = QByteArrayLiteral("command_");
-            if (command.startsWith(QLatin1String("ASYNC_"))) {
-                functionWithArguments += command.toUtf8() + QByteArrayLiteral("(QSharedPointer<SocketApiJob>)");
-            } else if (command.startsWith(QLatin1String("V2/"))) {
-                functionWithArguments += QByteArrayLiteral("V2_") + command.mid(3).toUtf8() + QByteArrayLiteral("(QSharedPointer<SocketApiJobV2>)");
-            } else {
-                functionWithArguments += command.toUtf8() + QByteArrayLiteral("(QString,SocketListener*)");
-            }
-            Q_ASSERT(staticQtMetaObject.normalizedSignature(functionWithArguments.constData()) == functionWithArguments);
-            const auto out = staticMetaObject.indexOfMethod(functionWithArguments.constData());
-            if (out == -1) {
-                listener->sendError(QStringLiteral("Function %1 not found").arg(QString::fromUtf8(functionWithArguments)));
-            }
-            OC_ASSERT(out != -1);
-            return out;
-        }();
+        const QMetaMethod method = _commands.value(command);
+        if (!method.isValid()) {
+            listener->sendError(QStringLiteral("Function %1 not found").arg(command));
+        }
+        OC_ASSERT(method.isValid());
 
         const auto argument = argPos != -1 ? line.midRef(argPos + 1) : QStringRef();
         if (command.startsWith(QLatin1String("ASYNC_"))) {
@@ -350,10 +368,9 @@ void SocketApi::slotReadSocket()
 
             auto socketApiJob = QSharedPointer<SocketApiJob>(
                 new SocketApiJob(jobId.toString(), listener, json), &QObject::deleteLater);
-            if (indexOfMethod != -1) {
-                staticMetaObject.method(indexOfMethod)
-                    .invoke(this, Qt::QueuedConnection,
-                        Q_ARG(QSharedPointer<SocketApiJob>, socketApiJob));
+            if (method.isValid()) {
+                method.invoke(this, Qt::QueuedConnection,
+                    Q_ARG(QSharedPointer<SocketApiJob>, socketApiJob));
             } else {
                 qCWarning(lcSocketApi) << "The command is not supported by this version of the client:" << command
                                        << "with argument:" << argument;
@@ -368,22 +385,20 @@ void SocketApi::slotReadSocket()
                 return;
             }
             auto socketApiJob = QSharedPointer<SocketApiJobV2>::create(listener, command, json);
-            if (indexOfMethod != -1) {
-                staticMetaObject.method(indexOfMethod)
-                    .invoke(this, Qt::QueuedConnection,
-                        Q_ARG(QSharedPointer<SocketApiJobV2>, socketApiJob));
+            if (method.isValid()) {
+                method.invoke(this, Qt::QueuedConnection,
+                    Q_ARG(QSharedPointer<SocketApiJobV2>, socketApiJob));
             } else {
                 qCWarning(lcSocketApi) << "The command is not supported by this version of the client:" << command
                                        << "with argument:" << argument;
                 socketApiJob->failure(QStringLiteral("command not found"));
             }
         } else {
-            if (indexOfMethod != -1) {
+            if (method.isValid()) {
                 // to ensure that listener is still valid we need to call it with Qt::DirectConnection
                 OC_ASSERT(thread() == QThread::currentThread())
-                staticMetaObject.method(indexOfMethod)
-                    .invoke(this, Qt::DirectConnection, Q_ARG(QString, argument.toString()),
-                        Q_ARG(SocketListener*, listener.data()));
+                method.invoke(this, Qt::DirectConnection, Q_ARG(QString, argument.toString()),
+                    Q_ARG(SocketListener*, listener.data()));
             }
         }
     }
@@ -474,6 +489,8 @@ void SocketApi::slotUpdateFolderView(Folder *f)
 
 void SocketApi::broadcastMessage(const QString &msg, bool doWait)
 {
+    // Keep the order, e.g. the status of a folder before its UPDATE_VIEW
+    sendPendingStatusPushes();
     for (const auto &listener : qAsConst(_listeners)) {
         listener->sendMessage(msg, doWait);
     }
@@ -522,38 +539,88 @@ void SocketApi::processShareRequest(const QString &localFile, SocketListener *li
 
 void SocketApi::broadcastStatusPushMessage(const QString &systemPath, SyncFileStatus fileStatus)
 {
-    QString msg = buildMessage(QStringLiteral("STATUS"), systemPath, fileStatus.toSocketAPIString());
     Q_ASSERT(!systemPath.endsWith(QLatin1Char('/')));
-    uint directoryHash = qHash(systemPath.left(systemPath.lastIndexOf(QLatin1Char('/'))));
-    for (const auto &listener : qAsConst(_listeners)) {
-        listener->sendMessageIfDirectoryMonitored(msg, directoryHash);
+    const QString directory = systemPath.left(systemPath.lastIndexOf(QLatin1Char('/')));
+
+    // A sync changes the status of a path several times, and a parent directory
+    // is only sent after its children when the directory is sent by its last change.
+    auto &pending = _pendingStatusPushes[directory];
+    pending.sequence = _statusPushSequence++;
+    pending.statuses.insert(systemPath, fileStatus);
+
+    if (!_statusPushTimer.isActive()) {
+        _statusPushTimer.start();
     }
 }
 
-void SocketApi::command_RETRIEVE_FOLDER_STATUS(const QString &argument, SocketListener *listener)
+void SocketApi::sendPendingStatusPushes()
 {
-    // This command is the same as RETRIEVE_FILE_STATUS
-    command_RETRIEVE_FILE_STATUS(argument, listener);
+    _statusPushTimer.stop();
+    const auto pendingStatusPushes = std::move(_pendingStatusPushes);
+    _pendingStatusPushes.clear();
+
+    std::vector<QHash<QString, PendingStatusPush>::const_iterator> byLastChange;
+    byLastChange.reserve(pendingStatusPushes.size());
+    for (auto it = pendingStatusPushes.cbegin(); it != pendingStatusPushes.cend(); ++it) {
+        byLastChange.push_back(it);
+    }
+    std::sort(byLastChange.begin(), byLastChange.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs->sequence < rhs->sequence;
+    });
+
+    for (const auto &pending : byLastChange) {
+        const QString &directory = pending.key();
+        const auto &statuses = pending->statuses;
+        const uint directoryHash = qHash(directory);
+        QString batchMessage;
+        for (const auto &listener : qAsConst(_listeners)) {
+            if (!listener->isDirectoryMonitored(directoryHash)) {
+                continue;
+            }
+            if (listener->batchedStatusPushes) {
+                if (batchMessage.isEmpty()) {
+                    QJsonObject statusObject;
+                    for (auto status = statuses.cbegin(); status != statuses.cend(); ++status) {
+                        statusObject.insert(QDir::toNativeSeparators(status.key()), status.value().toSocketAPIString());
+                    }
+                    const QJsonObject data { { QStringLiteral("arguments"),
+                        QJsonObject { { QStringLiteral("directory"), QDir::toNativeSeparators(directory) }, { QStringLiteral("statuses"), statusObject } } } };
+                    batchMessage = QStringLiteral("V2/STATUS_PUSH:") + QString::fromUtf8(QJsonDocument(data).toJson(QJsonDocument::Compact));
+                }
+                listener->sendMessage(batchMessage);
+            } else {
+                for (auto status = statuses.cbegin(); status != statuses.cend(); ++status) {
+                    listener->sendMessage(buildMessage(QStringLiteral("STATUS"), status.key(), status.value().toSocketAPIString()));
+                }
+            }
+        }
+    }
 }
 
-void SocketApi::command_RETRIEVE_FILE_STATUS(const QString &argument, SocketListener *listener)
+QString SocketApi::fileStatusForListener(const QString &localFile, SocketListener *listener)
 {
-    QString statusString;
-
-    auto fileData = FileData::get(argument);
+    auto fileData = FileData::get(localFile);
     if (!fileData.folder) {
         // this can happen in offline mode e.g.: nothing to worry about
-        statusString = SyncFileStatus(SyncFileStatus::StatusNone).toSocketAPIString();
-    } else {
-        // The user probably visited this directory in the file shell.
-        // Let the listener know that it should now send status pushes for sibblings of this file.
-        QString directory = fileData.localPath.left(fileData.localPath.lastIndexOf(QLatin1Char('/')));
-        listener->registerMonitoredDirectory(qHash(directory));
-
-        statusString = fileData.syncFileStatus().toSocketAPIString();
+        return SyncFileStatus(SyncFileStatus::StatusNone).toSocketAPIString();
     }
+    // The user probably visited this directory in the file shell.
+    // Let the listener know that it should now send status pushes for sibblings of this file.
+    QString directory = fileData.localPath.left(fileData.localPath.lastIndexOf(QLatin1Char('/')));
+    listener->registerMonitoredDirectory(qHash(directory));
 
-    const QString message = QStringLiteral("STATUS:") % statusString % QLatin1Char(':') % QDir::toNativeSeparators(argument);
+    return fileData.syncFileStatus().toSocketAPIString();
+}
+
+void SocketApi::command_RETRIEVE_FOLDER_STATUS(const QString &argument, SocketListener *listener)
+{
+    // This command is the same as RETRIEVE_FILE_STATUS
+    command_RETRIEVE_FILE_STATUS(argument, listener);
+}
+
+void SocketApi::command_RETRIEVE_FILE_STATUS(const QString &argument, SocketListener *listener)
+{
+    const QString message = QStringLiteral("STATUS:") % fileStatusForListener(argument, listener) % QLatin1Char(':') % QDir::toNativeSeparators(argument);
     listener->sendMessage(message);
 }
 
@@ -852,6 +919,25 @@ void SocketApi::command_V2_LIST_ACCOUNTS(const QSharedPointer<SocketApiJobV2> &j
     job->success({ { QStringLiteral("accounts"), out } });
 }
 
+void SocketApi::command_V2_RETRIEVE_FILE_STATUS(const QSharedPointer<SocketApiJobV2> &job)
+{
+    const auto paths = job->arguments().value(QStringLiteral("paths")).toArray();
+    if (paths.isEmpty()) {
+        job->failure(QStringLiteral("no paths given"));
+        return;
+    }
+
+    auto *listener = job->listener();
+    listener->batchedStatusPushes = true;
+    QJsonObject statuses;
+    for (const auto &path : paths) {
+        // Normalize like the paths of the line based messages, see slotReadSocket
+        const QString localFile = path.toString().normalized(QString::NormalizationForm_C);
+        statuses.insert(path.toString(), fileStatusForListener(localFile, listener));
+    }
+    job->success({ { QStringLiteral("statuses"), statuses } });
+}
+
 void SocketApi::command_V2_GET_CLIENT_ICON(const QSharedPointer<SocketApiJobV2> &job) const
 {
     OC_ASSERT(job);
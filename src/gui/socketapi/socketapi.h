@@ -22,6 +22,9 @@
 
 #include "config.h"
 
+#include <QMetaMethod>
+#include <QTimer>
+
 #if defined(Q_OS_MAC)
 #include "socketapisocket_mac.h"
 #else
@@ -62,6 +65,16 @@ public slots:
     void slotUpdateFolderView(Folder *f);
     void slotUnregisterPath(Folder *f);
     void slotRegisterPath(Folder *f);
+    /**
+     * Queues the status of the path for the listeners that monitor its directory.
+     *
+     * The pushes are coalesced and sent with sendPendingStatusPushes(): a path
+     * that changed several times is only sent with its last status. Listeners
+     * that use V2/RETRIEVE_FILE_STATUS get one V2/STATUS_PUSH message per
+     * directory instead of one STATUS message per path:
+     *
+     *     V2/STATUS_PUSH:{"arguments":{"directory":"/sync/dir","statuses":{"/sync/dir/file":"OK"}}}
+     */
     void broadcastStatusPushMessage(const QString &systemPath, SyncFileStatus fileStatus);
 
 signals:
@@ -101,6 +114,10 @@ private:
     };
 
     void broadcastMessage(const QString &msg, bool doWait = false);
+    void sendPendingStatusPushes();
+
+    // The status of a file as reported by RETRIEVE_FILE_STATUS, the listener starts monitoring its directory
+    QString fileStatusForListener(const QString &localFile, SocketListener *listener);
 
     // opens share dialog, sends reply
     void processShareRequest(const QString &localFile, SocketListener *listener, ShareDialogStartPage startPage);
@@ -128,6 +145,12 @@ private:
     // External sync
     Q_INVOKABLE void command_V2_LIST_ACCOUNTS(const QSharedPointer<SocketApiJobV2> &job) const;
 
+    // Sends the status of many files in one reply, like RETRIEVE_FILE_STATUS does for one (added in version 1.2)
+    // e.g. { "id" : "1", "arguments" : { "paths" : [ "/sync/a", "/sync/b" ] } }
+    // is answered with { "id" : "1", "arguments" : { "statuses" : { "/sync/a" : "OK", "/sync/b" : "SYNC" } } }
+    // The status pushes to the client are sent per directory from then on, see broadcastStatusPushMessage()
+    Q_INVOKABLE void command_V2_RETRIEVE_FILE_STATUS(const QSharedPointer<SocketApiJobV2> &job);
+
     // Sends the id and the client icon as PNG image (base64 encoded) in Json key "png"
     // e.g. { "id" : "1", "arguments" : { "png" : "hswehs343dj8..." } } or an error message in key "error"
     //
@@ -165,6 +188,20 @@ private:
 
     QString buildRegisterPathMessage(const QString &path);
 
+    // The command_ methods by the name of their command, e.g. V2/LIST_ACCOUNTS
+    QHash<QString, QMetaMethod> _commands;
+
+    struct PendingStatusPush
+    {
+        // When the directory last changed, in the order of _statusPushSequence
+        quint64 sequence;
+        QMap<QString, SyncFileStatus> statuses;
+    };
+    // The queued status pushes by directory
+    QHash<QString, PendingStatusPush> _pendingStatusPushes;
+    quint64 _statusPushSequence = 0;
+    QTimer _statusPushTimer;
+
     QSet<Folder *> _registeredFolders;
     QSet<AccountPtr> _registeredAccounts;
     QMap<SocketApiSocket *, QSharedPointer<SocketListener>> _listeners;
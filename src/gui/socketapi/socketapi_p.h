@@ -61,6 +61,8 @@ class SocketListener
 {
 public:
     QPointer<QIODevice> socket;
+    // The client understands V2/STATUS_PUSH
+    bool batchedStatusPushes = false;
 
     explicit SocketListener(QIODevice *_socket)
         : socket(_socket)
@@ -77,10 +79,9 @@ public:
         sendMessage(QStringLiteral("ERROR:") + message, doWait);
     }
 
-    void sendMessageIfDirectoryMonitored(const QString &message, uint systemDirectoryHash) const
+    bool isDirectoryMonitored(uint systemDirectoryHash) const
     {
-        if (_monitoredDirectoriesBloomFilter.isHashMaybeStored(systemDirectoryHash))
-            sendMessage(message, false);
+        return _monitoredDirectoriesBloomFilter.isHashMaybeStored(systemDirectoryHash);
     }
 
     void registerMonitoredDirectory(uint systemDirectoryHash)
@@ -149,6 +150,7 @@ public:
 
     const QJsonObject &arguments() const { return _arguments; }
     QString command() const { return _command; }
+    SocketListener *listener() const { return _socketListener.data(); }
 
     QString warning() const;
     void setWarning(const QString &warning);
@@ -37,6 +37,7 @@
 #include <memory>
 #include "capabilities.h"
 #include "jobqueue.h"
+#include "transferconcurrency.h"
 
 class QSettings;
 class QNetworkReply;
@@ -190,6 +191,9 @@ public:
 
     JobQueue *jobQueue();
 
+    /** Decides how many transfers the propagators of this account run in parallel */
+    TransferConcurrency *transferConcurrency() { return &_transferConcurrency; }
+
     QUuid uuid() const;
 
     CredentialManager *credentialManager() const;
@@ -249,6 +253,7 @@ private:
 
     JobQueue _jobQueue;
     JobQueueGuard _queueGuard;
+    TransferConcurrency _transferConcurrency;
     CredentialManager *_credentialManager;
     friend class AccountManager;
 };
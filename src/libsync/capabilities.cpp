@@ -205,6 +205,30 @@ bool Capabilities::chunkingParallelUploadDisabled() const
     return _capabilities.value(QStringLiteral("dav")).toMap().value(QStringLiteral("chunkingParallelUploadDisabled")).toBool();
 }
 
+bool Capabilities::propfindDepthInfinity() const
+{
+    static const auto depthInfinity = qgetenv("OWNCLOUD_PROPFIND_DEPTH_INFINITY");
+    if (depthInfinity == "0")
+        return false;
+    if (depthInfinity == "1")
+        return true;
+    return _capabilities.value(QStringLiteral("dav")).toMap().value(QStringLiteral("propfind")).toMap().value(QStringLiteral("depth_infinity")).toBool();
+}
+
+bool Capabilities::bulkUpload() const
+{
+    static const auto bulkUpload = qgetenv("OWNCLOUD_BULK_UPLOAD");
+    if (bulkUpload == "0")
+        return false;
+    const auto version = _capabilities.value(QStringLiteral("dav")).toMap().value(QStringLiteral("bulk_upload")).toMap().value(QStringLiteral("version")).toString();
+    return version.startsWith(QLatin1String("1."));
+}
+
+bool Capabilities::deltaSync() const
+{
+    return _capabilities.value(QStringLiteral("dav")).toMap().value(QStringLiteral("deltasync")).toBool();
+}
+
 bool Capabilities::privateLinkPropertyAvailable() const
 {
     return _capabilities.value(QStringLiteral("files")).toMap().value(QStringLiteral("privateLinks")).toBool();
@@ -142,6 +142,34 @@ public:
     /// disable parallel upload in chunking
     bool chunkingParallelUploadDisabled() const;
 
+    /**
+     * Whether the server answers PROPFIND requests with "Depth: infinity"
+     *
+     * Path: dav/propfind/depth_infinity
+     * Default: false
+     */
+    bool propfindDepthInfinity() const;
+
+    /**
+     * Whether the server accepts several small files in one multipart
+     * POST to remote.php/dav/bulk, see PropagateUploadBulk
+     *
+     * Path: dav/bulk_upload/version, only versions 1.x are supported.
+     * Servers that announce dav/bulkupload use a different format.
+     * Default: false
+     * Can be disabled with OWNCLOUD_BULK_UPLOAD=0
+     */
+    bool bulkUpload() const;
+
+    /**
+     * Whether the server fills the ranges missing from a chunked upload with
+     * the data of the file it replaces, see PropagateUploadFileNG
+     *
+     * Path: dav/deltasync
+     * Default: false
+     */
+    bool deltaSync() const;
+
     /// Whether the "privatelink" DAV property is available
     bool privateLinkPropertyAvailable() const;
 
@@ -70,6 +70,9 @@ const QString chunkSizeC() { return QStringLiteral("chunkSize"); }
 const QString minChunkSizeC() { return QStringLiteral("minChunkSize"); }
 const QString maxChunkSizeC() { return QStringLiteral("maxChunkSize"); }
 const QString targetChunkUploadDurationC() { return QStringLiteral("targetChunkUploadDuration"); }
+const QString downloadBufferSizeC() { return QStringLiteral("downloadBufferSize"); }
+const QString maxConcurrentSyncsC() { return QStringLiteral("maxConcurrentSyncs"); }
+const QString globalParallelNetworkJobsC() { return QStringLiteral("globalParallelNetworkJobs"); }
 const QString automaticLogDirC() { return QStringLiteral("logToTemporaryLogDir"); }
 const QString numberOfLogsToKeepC() { return QStringLiteral("numberOfLogsToKeep"); }
 const QString showExperimentalOptionsC() { return QStringLiteral("showExperimentalOptions"); }
@@ -183,6 +186,24 @@ chrono::milliseconds ConfigFile::targetChunkUploadDuration() const
     return millisecondsValue(settings, targetChunkUploadDurationC(), chrono::minutes(1));
 }
 
+qint64 ConfigFile::downloadBufferSize() const
+{
+    auto settings = makeQSettings();
+    return qMax<qint64>(16 * 1024, settings.value(downloadBufferSizeC(), 1024 * 1024).toLongLong()); // default to 1 MiB
+}
+
+int ConfigFile::maxConcurrentSyncs() const
+{
+    auto settings = makeQSettings();
+    return qMax(1, settings.value(maxConcurrentSyncsC(), 3).toInt());
+}
+
+int ConfigFile::globalParallelNetworkJobs() const
+{
+    auto settings = makeQSettings();
+    return qMax(0, settings.value(globalParallelNetworkJobsC(), 20).toInt());
+}
+
 void ConfigFile::setOptionalDesktopNotifications(bool show)
 {
     auto settings = makeQSettings();
@@ -158,6 +158,12 @@ public:
     qint64 maxChunkSize() const;
     qint64 minChunkSize() const;
     std::chrono::milliseconds targetChunkUploadDuration() const;
+    qint64 downloadBufferSize() const;
+
+    /** How many folders may sync at the same time */
+    int maxConcurrentSyncs() const;
+    /** The maximum number of network jobs of all syncing folders together, 0: no limit */
+    int globalParallelNetworkJobs() const;
 
     void saveGeometry(QWidget *w);
     void restoreGeometry(QWidget *w);
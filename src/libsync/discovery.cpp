@@ -23,6 +23,7 @@
 #include "vio/csync_vio_local.h"
 
 #include <algorithm>
+#include <limits>
 #include <set>
 
 #include <QDebug>
@@ -40,11 +41,62 @@ void ProcessDirectoryJob::start()
     qCInfo(lcDisco) << "STARTING" << _currentFolder._server << _queryServer << _currentFolder._local << _queryLocal;
 
     if (_queryServer == NormalQuery) {
-        _serverJob = startAsyncServerQuery();
+        auto listing = _discoveryData->_remoteListings.find(_currentFolder._server);
+        if (listing != _discoveryData->_remoteListings.end()) {
+            // Already fetched by the recursive query of a parent directory
+            _serverNormalQueryEntries = std::move(listing->entries);
+            _rootPermissions = listing->permissions;
+            _discoveryData->_remoteListings.erase(listing);
+            _serverQueryDone = true;
+        } else {
+            _serverJob = startAsyncServerQuery();
+        }
     } else {
         _serverQueryDone = true;
     }
 
+    if (_localQueryStarted) {
+        // The listing was prefetched while this job was queued
+        _discoveryData->_localQueryPrefetches--;
+    } else {
+        skipUnchangedLocalQuery();
+        if (_queryLocal == NormalQuery) {
+            startAsyncLocalQuery(std::numeric_limits<int>::max());
+        } else {
+            _localQueryDone = true;
+        }
+    }
+
+    _started = true;
+    if (_localQueryResult) {
+        // The prefetched local query already finished, handling it may call process()
+        auto result = std::move(_localQueryResult);
+        _localQueryResult = nullptr;
+        result();
+        return;
+    }
+
+    if (_localQueryDone && _serverQueryDone) {
+        process();
+    }
+}
+
+void ProcessDirectoryJob::prefetchLocalQuery()
+{
+    if (_started || _localQueryStarted || _queryLocal != NormalQuery
+        || _discoveryData->_localQueryPrefetches >= _discoveryData->maxLocalQueryPrefetches())
+        return;
+    skipUnchangedLocalQuery();
+    if (_queryLocal != NormalQuery)
+        return;
+
+    _discoveryData->_localQueryPrefetches++;
+    // Deeper directories first: the sub jobs are processed depth-first, so these are needed sooner
+    startAsyncLocalQuery(_currentFolder._local.count(QLatin1Char('/')));
+}
+
+void ProcessDirectoryJob::skipUnchangedLocalQuery()
+{
     // Check whether a normal local query is even necessary
     if (_queryLocal == NormalQuery) {
         if (!_discoveryData->_shouldDiscoverLocaly(_currentFolder._local)
@@ -52,15 +104,14 @@ void ProcessDirectoryJob::start()
             _queryLocal = ParentNotChanged;
         }
     }
+}
 
-    if (_queryLocal == NormalQuery) {
-        startAsyncLocalQuery();
+void ProcessDirectoryJob::handleLocalQueryResult(std::function<void()> &&result)
+{
+    if (_started) {
+        result();
     } else {
-        _localQueryDone = true;
-    }
-
-    if (_localQueryDone && _serverQueryDone) {
-        process();
+        _localQueryResult = std::move(result);
     }
 }
 
@@ -807,15 +858,15 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
             item->_modtime = localEntry.modtime;
             _childModified = true;
 
-            // Checksum comparison at this stage is only enabled for .eml files,
-            // check #4754 #4755
+            // Checksum comparison at this stage is always enabled for .eml files,
+            // check #4754 #4755, and for other files up to _contentChecksumMaxSize
             bool isEmlFile = path._original.endsWith(QLatin1String(".eml"), Qt::CaseInsensitive);
-            if (isEmlFile && dbEntry._fileSize == localEntry.size && !dbEntry._checksumHeader.isEmpty()) {
-                if (computeLocalChecksum(dbEntry._checksumHeader, _discoveryData->_localDir + path._local, item)
-                        && item->_checksumHeader == dbEntry._checksumHeader) {
-                    qCInfo(lcDisco) << "NOTE: Checksums are identical, file did not actually change: " << path._local;
-                    item->_instruction = CSYNC_INSTRUCTION_UPDATE_METADATA;
-                }
+            if ((isEmlFile || (_discoveryData->_syncOptions._contentChecksumMaxSize > 0 && localEntry.size <= _discoveryData->_syncOptions._contentChecksumMaxSize))
+                && dbEntry._fileSize == localEntry.size && !dbEntry._checksumHeader.isEmpty()) {
+                processFileCompareContentChecksum(item, path, dbEntry._checksumHeader, [finalize, path, recurseQueryServer] {
+                    finalize(path, recurseQueryServer);
+                });
+                return;
             }
         }
 
@@ -1021,6 +1072,34 @@ void ProcessDirectoryJob::processFileAnalyzeLocalInfo(
     }
 }
 
+void ProcessDirectoryJob::processFileCompareContentChecksum(const SyncFileItemPtr &item, const PathTuple &path, const QByteArray &dbChecksumHeader, std::function<void()> &&finalize)
+{
+    const auto checksumHeader = ChecksumHeader::parseChecksumHeader(dbChecksumHeader);
+    if (!checksumHeader.isValid()) {
+        finalize();
+        return;
+    }
+
+    // Hash on the checksum pool, large files would block the discovery for too long
+    _pendingAsyncJobs++;
+    auto computeChecksum = new ComputeChecksum(this);
+    computeChecksum->setChecksumType(checksumHeader.type());
+    connect(computeChecksum, &ComputeChecksum::done, this,
+        [item, path, dbChecksumHeader, finalize = std::move(finalize), this](CheckSums::Algorithm type, const QByteArray &checksum) {
+            if (!checksum.isEmpty() && ChecksumHeader(type, checksum).makeChecksumHeader() == dbChecksumHeader) {
+                qCInfo(lcDisco) << "NOTE: Checksums are identical, file did not actually change: " << path._local;
+                item->_checksumHeader = dbChecksumHeader;
+                item->_instruction = CSYNC_INSTRUCTION_UPDATE_METADATA;
+            }
+            // Otherwise the upload computes the checksum again: the file might still change until then
+            finalize();
+            _pendingAsyncJobs--;
+            QTimer::singleShot(0, _discoveryData, &DiscoveryPhase::scheduleMoreJobs);
+        });
+    connect(computeChecksum, &ComputeChecksum::done, computeChecksum, &QObject::deleteLater);
+    computeChecksum->start(_discoveryData->_localDir + path._local);
+}
+
 void ProcessDirectoryJob::processFileConflict(const SyncFileItemPtr &item, const ProcessDirectoryJob::PathTuple &path, const LocalInfo &localEntry, const RemoteInfo &serverEntry, const SyncJournalFileRecord &dbEntry)
 {
     item->_previousSize = localEntry.size;
@@ -1138,6 +1217,7 @@ void ProcessDirectoryJob::processFileFinalize(
         } else {
             connect(job, &ProcessDirectoryJob::finished, this, &ProcessDirectoryJob::subJobFinished);
             _queuedJobs.push_back(job);
+            job->prefetchLocalQuery();
         }
     } else {
         if (removed
@@ -1176,6 +1256,7 @@ void ProcessDirectoryJob::processBlacklisted(const PathTuple &path, const OCC::L
         auto job = new ProcessDirectoryJob(path, item, NormalQuery, InBlackList, this);
         connect(job, &ProcessDirectoryJob::finished, this, &ProcessDirectoryJob::subJobFinished);
         _queuedJobs.push_back(job);
+        job->prefetchLocalQuery();
     } else {
         emit _discoveryData->itemDiscovered(item);
     }
@@ -1387,12 +1468,23 @@ QString ProcessDirectoryJob::chopVirtualFileSuffix(const QString &str) const
     return _discoveryData->_syncOptions._vfs->underlyingFileName(str);
 }
 
+bool ProcessDirectoryJob::shouldQueryServerSubtree() const
+{
+    if (!_discoveryData->_account->capabilities().propfindDepthInfinity() || _discoveryData->_depthInfinityRefused)
+        return false;
+    if (!_dirItem)
+        return _discoveryData->_statedb->getFileRecordCount() == 0;
+    return _dirItem->_instruction == CSYNC_INSTRUCTION_NEW && _dirItem->_direction == SyncFileItem::Down;
+}
+
 DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
 {
     auto serverJob = new DiscoverySingleDirectoryJob(_discoveryData->_account, _discoveryData->_baseUrl,
         _discoveryData->_remoteFolder + _currentFolder._server, this);
     if (!_dirItem)
         serverJob->setIsRootPath(); // query the fingerprint on the root
+    if (shouldQueryServerSubtree())
+        serverJob->setDepthInfinity();
     connect(serverJob, &DiscoverySingleDirectoryJob::etag, this, &ProcessDirectoryJob::etag);
     _discoveryData->_currentlyActiveJobs++;
     _pendingAsyncJobs++;
@@ -1402,6 +1494,10 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
         if (results) {
             _serverNormalQueryEntries = *results;
             _serverQueryDone = true;
+            auto subtreeListings = serverJob->takeSubtreeListings();
+            for (auto it = subtreeListings.begin(); it != subtreeListings.end(); ++it) {
+                _discoveryData->_remoteListings.insert(PathTuple::pathAppend(_currentFolder._server, it.key()), std::move(it.value()));
+            }
             if (!serverJob->_dataFingerprint.isEmpty() && _discoveryData->_dataFingerprint.isEmpty())
                 _discoveryData->_dataFingerprint = serverJob->_dataFingerprint;
             if (_localQueryDone)
@@ -1430,16 +1526,19 @@ DiscoverySingleDirectoryJob *ProcessDirectoryJob::startAsyncServerQuery()
     });
     connect(serverJob, &DiscoverySingleDirectoryJob::firstDirectoryPermissions, this,
         [this](const RemotePermissions &perms) { _rootPermissions = perms; });
+    connect(serverJob, &DiscoverySingleDirectoryJob::depthInfinityRefused, this,
+        [this] { _discoveryData->_depthInfinityRefused = true; });
     serverJob->start();
     return serverJob;
 }
 
-void ProcessDirectoryJob::startAsyncLocalQuery()
+void ProcessDirectoryJob::startAsyncLocalQuery(int priority)
 {
     QString localPath = _discoveryData->_localDir + _currentFolder._local;
     auto localJob = new DiscoverySingleLocalDirectoryJob(_discoveryData->_account, localPath, _discoveryData->_syncOptions._vfs.data());
 
-    _discoveryData->_currentlyActiveJobs++;
+    // Local queries run on the discovery's own pool and don't count against the network job limit
+    _localQueryStarted = true;
     _pendingAsyncJobs++;
 
     connect(localJob, &DiscoverySingleLocalDirectoryJob::itemDiscovered, _discoveryData, &DiscoveryPhase::itemDiscovered);
@@ -1449,7 +1548,6 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
     });
 
     connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedFatalError, this, [this](const QString &msg) {
-        _discoveryData->_currentlyActiveJobs--;
         _pendingAsyncJobs--;
         if (_serverJob)
             _serverJob->abort();
@@ -1458,32 +1556,34 @@ void ProcessDirectoryJob::startAsyncLocalQuery()
     });
 
     connect(localJob, &DiscoverySingleLocalDirectoryJob::finishedNonFatalError, this, [this](const QString &msg) {
-        _discoveryData->_currentlyActiveJobs--;
-        _pendingAsyncJobs--;
+        // A prefetched job must not report being finished before it was started
+        handleLocalQueryResult([this, msg] {
+            _pendingAsyncJobs--;
 
-        if (_dirItem) {
-            _dirItem->_instruction = CSYNC_INSTRUCTION_IGNORE;
-            _dirItem->_errorString = msg;
-            emit this->finished();
-        } else {
-            // Fatal for the root job since it has no SyncFileItem
-            emit _discoveryData->fatalError(msg);
-        }
+            if (_dirItem) {
+                _dirItem->_instruction = CSYNC_INSTRUCTION_IGNORE;
+                _dirItem->_errorString = msg;
+                emit this->finished();
+            } else {
+                // Fatal for the root job since it has no SyncFileItem
+                emit _discoveryData->fatalError(msg);
+            }
+        });
     });
 
-    connect(localJob, &DiscoverySingleLocalDirectoryJob::finished, this, [this](const auto &results) {
-        _discoveryData->_currentlyActiveJobs--;
-        _pendingAsyncJobs--;
+    connect(localJob, &DiscoverySingleLocalDirectoryJob::finished, this, [this](const QVector<LocalInfo> &results) {
+        handleLocalQueryResult([this, results] {
+            _pendingAsyncJobs--;
 
-        _localNormalQueryEntries = results;
-        _localQueryDone = true;
+            _localNormalQueryEntries = results;
+            _localQueryDone = true;
 
-        if (_serverQueryDone)
-            this->process();
+            if (_serverQueryDone)
+                this->process();
+        });
     });
 
-    QThreadPool *pool = QThreadPool::globalInstance();
-    pool->start(localJob); // QThreadPool takes ownership
+    _discoveryData->_localDiscoveryPool.start(localJob, priority); // QThreadPool takes ownership
 }
 
 
@@ -88,6 +88,14 @@ public:
     /** Start up to nbJobs, return the number of job started; emit finished() when done */
     int processSubJobs(int nbJobs);
 
+    /** Start the local query of a queued job ahead of start()
+     *
+     * Lets the local listing be read while the main thread is still busy
+     * with other directories. Does nothing if the local query isn't needed
+     * or too many prefetched listings are already pending.
+     */
+    void prefetchLocalQuery();
+
     SyncFileItemPtr _dirItem;
 
 private:
@@ -158,6 +166,14 @@ private:
     /// processFile helper for reconciling local changes
     void processFileAnalyzeLocalInfo(const SyncFileItemPtr &item, const PathTuple &, const LocalInfo &, const RemoteInfo &, const SyncJournalFileRecord &, QueryMode recurseQueryServer);
 
+    /** processFile helper for local changes that might only have touched the file
+     *
+     * Hashes the local file in the background and turns the item into an
+     * UPDATE_METADATA if the content checksum matches dbChecksumHeader.
+     * Calls finalize when done.
+     */
+    void processFileCompareContentChecksum(const SyncFileItemPtr &item, const PathTuple &, const QByteArray &dbChecksumHeader, std::function<void()> &&finalize);
+
     /// processFile helper for local/remote conflicts
     void processFileConflict(const SyncFileItemPtr &item, const PathTuple &, const LocalInfo &, const RemoteInfo &, const SyncJournalFileRecord &);
 
@@ -206,11 +222,25 @@ private:
      */
     DiscoverySingleDirectoryJob *startAsyncServerQuery();
 
+    /** Whether the server query should list the whole subtree at once
+     *
+     * That is the case if the server supports it and none of the subdirectories
+     * are known yet: on the initial sync and for new remote directories.
+     */
+    bool shouldQueryServerSubtree() const;
+
     /** Discover the local directory
       *
-      * Fills _localNormalQueryEntries.
+      * Fills _localNormalQueryEntries. Runs on DiscoveryPhase::_localDiscoveryPool
+      * with the given priority.
       */
-    void startAsyncLocalQuery();
+    void startAsyncLocalQuery(int priority);
+
+    /** Downgrade _queryLocal to ParentNotChanged if the local folder is known to be unchanged */
+    void skipUnchangedLocalQuery();
+
+    /** Run the handler of a local query result, or keep it until start() if the job isn't started yet */
+    void handleLocalQueryResult(std::function<void()> &&result);
 
 
     /** Sets _pinState, the directory's pin state
@@ -244,6 +274,12 @@ private:
     bool _serverQueryDone = false;
     bool _localQueryDone = false;
 
+    // Whether start() was called and whether the local query was started, possibly by prefetchLocalQuery()
+    bool _started = false;
+    bool _localQueryStarted = false;
+    // The result of a prefetched local query that finished before start()
+    std::function<void()> _localQueryResult;
+
     RemotePermissions _rootPermissions;
     QPointer<DiscoverySingleDirectoryJob> _serverJob;
 
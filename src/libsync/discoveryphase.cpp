@@ -203,6 +203,14 @@ QPair<bool, QByteArray> DiscoveryPhase::findAndCancelDeletedJob(const QString &o
     return { result, oldEtag };
 }
 
+DiscoveryPhase::~DiscoveryPhase()
+{
+    // Drop the local queries that haven't started and wait for the running ones,
+    // they use the vfs plugin from _syncOptions.
+    _localDiscoveryPool.clear();
+    _localDiscoveryPool.waitForDone();
+}
+
 void DiscoveryPhase::startJob(ProcessDirectoryJob *job)
 {
     OC_ENFORCE(!_currentRootJob);
@@ -334,6 +342,9 @@ void DiscoverySingleDirectoryJob::start()
 {
     // Start the actual HTTP job
     LsColJob *lsColJob = new LsColJob(_account, _baseUrl, _subPath, this);
+    if (_depthInfinity) {
+        lsColJob->setDepth(QByteArrayLiteral("infinity"));
+    }
 
     QList<QByteArray> props {
         "resourcetype",
@@ -421,6 +432,7 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &fi
     if (!_ignoredFirst) {
         // The first entry is for the folder itself, we should process it differently.
         _ignoredFirst = true;
+        _firstHref = file;
         if (auto it = Utility::optionalFind(map, QStringLiteral("permissions"))) {
             auto perm = RemotePermissions::fromServerString(it->value());
             emit firstDirectoryPermissions(perm);
@@ -443,6 +455,25 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(const QString &fi
         if (result.isDirectory)
             result.size = 0;
 
+        if (_depthInfinity) {
+            if (!file.startsWith(_firstHref + QLatin1Char('/'))) {
+                qCWarning(lcDiscovery) << "Unexpected entry in recursive listing" << file;
+                _error = tr("Server error: PROPFIND reply contains an entry outside of the requested folder");
+                return;
+            }
+            const QString relativePath = file.mid(_firstHref.size() + 1);
+            if (result.isDirectory) {
+                _subtreeListings[relativePath].permissions = result.remotePerm;
+            }
+            const int parentSlash = relativePath.lastIndexOf(QLatin1Char('/'));
+            if (parentSlash != -1) {
+                // The 'M' of entries below the direct children is adjusted in lsJobFinishedWithoutErrorSlot
+                // once the permissions of all the directories are known
+                _subtreeListings[relativePath.left(parentSlash)].entries.push_back(std::move(result));
+                return;
+            }
+        }
+
         if (_isExternalStorage && result.remotePerm.hasPermission(RemotePermissions::IsMounted)) {
             /* All the entries in a external storage have 'M' in their permission. However, for all
                purposes in the desktop client, we only need to know about the mount points.
@@ -474,6 +505,17 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
         deleteLater();
         return;
     }
+    for (auto &listing : _subtreeListings) {
+        // Same as in directoryListingIteratedSlot, for every directory of the recursive listing
+        if (!listing.permissions.hasPermission(RemotePermissions::IsMounted))
+            continue;
+        for (auto &result : listing.entries) {
+            if (result.remotePerm.hasPermission(RemotePermissions::IsMounted)) {
+                result.remotePerm.unsetPermission(RemotePermissions::IsMounted);
+                result.remotePerm.setPermission(RemotePermissions::IsMountedSub);
+            }
+        }
+    }
     emit etag(_firstEtag, QDateTime::fromString(QString::fromUtf8(_lsColJob->responseTimestamp()), Qt::RFC2822Date));
     emit finished(_results);
     deleteLater();
@@ -485,6 +527,22 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithErrorSlot(QNetworkReply *r)
     int httpCode = r->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     QString msg = r->errorString();
     qCWarning(lcDiscovery) << "LSCOL job error" << r->errorString() << httpCode << r->error();
+    // Servers may refuse recursive listings (e.g. 403 for too large trees), list this directory only
+    if (_depthInfinity && (httpCode == 400 || httpCode == 403 || httpCode == 405 || httpCode == 501)) {
+        qCInfo(lcDiscovery) << "Recursive PROPFIND of" << _subPath << "refused, retrying with Depth: 1";
+        emit depthInfinityRefused();
+        _depthInfinity = false;
+        _results.clear();
+        _subtreeListings.clear();
+        _firstHref.clear();
+        _firstEtag.clear();
+        _dataFingerprint.clear();
+        _error.clear();
+        _ignoredFirst = false;
+        _isExternalStorage = false;
+        start();
+        return;
+    }
     if (r->error() == QNetworkReply::NoError
         && !contentType.contains(QLatin1String("application/xml; charset=utf-8"))) {
         msg = tr("Server error: PROPFIND reply is not XML formatted!");
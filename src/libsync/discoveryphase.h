@@ -24,7 +24,9 @@
 #include <QMutex>
 #include <QWaitCondition>
 #include <QRunnable>
+#include <QThreadPool>
 #include <deque>
+#include <set>
 #include "syncoptions.h"
 #include "syncfileitem.h"
 
@@ -77,6 +79,17 @@ struct LocalInfo
     bool isValid() const { return !name.isNull(); }
 };
 
+/**
+ * The server listing of a directory that was fetched as part of a
+ * recursive PROPFIND, see DiscoverySingleDirectoryJob::setDepthInfinity()
+ */
+struct RemoteDirectoryListing
+{
+    /** Permissions of the directory itself, as sent by the server */
+    RemotePermissions permissions;
+    QVector<RemoteInfo> entries;
+};
+
 /**
  * @brief Run list on a local directory and process the results for Discovery
  *
@@ -117,12 +130,24 @@ public:
     explicit DiscoverySingleDirectoryJob(const AccountPtr &account, const QUrl &baseUrl, const QString &path, QObject *parent = nullptr);
     // Specify that this is the root and we need to check the data-fingerprint
     void setIsRootPath() { _isRootPath = true; }
+    /** Query the whole subtree with a single "Depth: infinity" PROPFIND
+     *
+     * finished() still only reports the direct children, the listings of the
+     * subdirectories are available through takeSubtreeListings() afterwards.
+     * If the server refuses the request, depthInfinityRefused() is emitted
+     * and the job falls back to "Depth: 1". Other errors are reported as usual.
+     */
+    void setDepthInfinity() { _depthInfinity = true; }
     void start();
     void abort();
 
+    /** The listings of all subdirectories, keyed by the path relative to the queried directory */
+    QHash<QString, RemoteDirectoryListing> takeSubtreeListings() { return std::move(_subtreeListings); }
+
     // This is not actually a network job, it is just a job
 signals:
     void firstDirectoryPermissions(RemotePermissions);
+    void depthInfinityRefused();
     void etag(const QByteArray &, const QDateTime &time);
     void finished(const HttpResult<QVector<RemoteInfo>> &result);
 
@@ -133,7 +158,10 @@ private slots:
 
 private:
     QVector<RemoteInfo> _results;
+    QHash<QString, RemoteDirectoryListing> _subtreeListings;
     QString _subPath;
+    // The href of the queried directory, used to split up recursive listings
+    QString _firstHref;
     QByteArray _firstEtag;
     AccountPtr _account;
     const QUrl _baseUrl;
@@ -144,6 +172,7 @@ private:
     bool _isRootPath;
     // If this directory is an external storage (The first item has 'M' in its permission)
     bool _isExternalStorage;
+    bool _depthInfinity = false;
     // If set, the discovery will finish with an error
     QString _error;
     QPointer<LsColJob> _lsColJob;
@@ -204,6 +233,27 @@ class DiscoveryPhase : public QObject
 
     int _currentlyActiveJobs = 0;
 
+    /** Runs the DiscoverySingleLocalDirectoryJobs
+     *
+     * Sized by SyncOptions::_parallelLocalDiscoveryJobs, independently of
+     * the network job limit used by scheduleMoreJobs().
+     */
+    QThreadPool _localDiscoveryPool;
+
+    /// Number of local queries started by ProcessDirectoryJob::prefetchLocalQuery() for jobs not started yet
+    int _localQueryPrefetches = 0;
+    int maxLocalQueryPrefetches() const { return 4 * _localDiscoveryPool.maxThreadCount(); }
+
+    /** Server listings fetched ahead of time by recursive PROPFINDs
+     *
+     * Keyed by the server path relative to _remoteFolder. ProcessDirectoryJob
+     * takes its listing from here instead of querying the server again.
+     */
+    QHash<QString, RemoteDirectoryListing> _remoteListings;
+
+    /// Set once the server refused a recursive PROPFIND, the other directories use "Depth: 1" right away
+    bool _depthInfinityRefused = false;
+
     // both must contain a sorted list
     QStringList _selectiveSyncBlackList;
     QStringList _selectiveSyncWhiteList;
@@ -245,7 +295,9 @@ public:
         , _syncOptions(options)
         , _baseUrl(baseUrl)
     {
+        _localDiscoveryPool.setMaxThreadCount(qMax(1, _syncOptions._parallelLocalDiscoveryJobs));
     }
+    ~DiscoveryPhase();
     AccountPtr _account;
     const SyncOptions _syncOptions;
     const QUrl _baseUrl;
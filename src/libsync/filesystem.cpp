@@ -29,6 +29,12 @@
 #include <winsock2.h>
 #endif
 
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#endif
+
 namespace OCC {
 
 bool FileSystem::fileEquals(const QString &fn1, const QString &fn2)
@@ -179,6 +185,57 @@ bool FileSystem::removeRecursively(const QString &path,
     return allRemoved;
 }
 
+FileSystem::PreallocateResult FileSystem::preallocate(QFile &file, qint64 size, bool keepSize, QString *errorString)
+{
+#ifdef Q_OS_LINUX
+    int result;
+    do {
+        result = ::fallocate(file.handle(), keepSize ? FALLOC_FL_KEEP_SIZE : 0, 0, size);
+    } while (result != 0 && errno == EINTR);
+    if (result != 0) {
+        if (errno == EOPNOTSUPP || errno == ENOSYS) {
+            qCDebug(lcFileSystem) << "Preallocation is not supported for" << file.fileName();
+            return PreallocateResult::Unsupported;
+        }
+        *errorString = QString::fromLocal8Bit(strerror(errno));
+        qCWarning(lcFileSystem) << "Could not preallocate" << size << "bytes for" << file.fileName() << *errorString;
+        return PreallocateResult::Failed;
+    }
+    return PreallocateResult::Reserved;
+#else
+    Q_UNUSED(file)
+    Q_UNUSED(size)
+    Q_UNUSED(keepSize)
+    Q_UNUSED(errorString)
+    return PreallocateResult::Unsupported;
+#endif
+}
+
+void FileSystem::startWriteBack(QFile &file, qint64 offset, qint64 length)
+{
+#ifdef Q_OS_LINUX
+    ::sync_file_range(file.handle(), offset, length, SYNC_FILE_RANGE_WRITE);
+#else
+    Q_UNUSED(file)
+    Q_UNUSED(offset)
+    Q_UNUSED(length)
+#endif
+}
+
+void FileSystem::dropFromPageCache(QFile &file, qint64 offset, qint64 length)
+{
+#ifdef Q_OS_LINUX
+    // Only pages that are written back can be dropped
+    ::sync_file_range(file.handle(), offset, length,
+        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    ::posix_fadvise(file.handle(), offset, length, POSIX_FADV_DONTNEED);
+#else
+    Q_UNUSED(file)
+    Q_UNUSED(offset)
+    Q_UNUSED(length)
+#endif
+}
+
 bool FileSystem::getInode(const QString &filename, quint64 *inode)
 {
     csync_file_stat_t fs;
@@ -79,6 +79,37 @@ namespace FileSystem {
         qint64 previousSize,
         time_t previousMtime);
 
+    /**
+     * @brief Reserve the disk space for size bytes of the open \a file
+     *
+     * The space is allocated in one go, so the file doesn't end up fragmented
+     * when it is written piece by piece. With keepSize the size of the file
+     * stays the same, otherwise it grows to size.
+     *
+     * Does nothing where the platform or file system doesn't support it.
+     *
+     * @return Unsupported if nothing was done, Failed with errorString set
+     *         if the space could not be reserved.
+     */
+    enum class PreallocateResult {
+        Reserved,
+        Unsupported,
+        Failed
+    };
+    PreallocateResult OWNCLOUDSYNC_EXPORT preallocate(QFile &file, qint64 size, bool keepSize, QString *errorString);
+
+    /**
+     * @brief Start writing the data of a range of the open \a file to disk, without waiting for it
+     */
+    void OWNCLOUDSYNC_EXPORT startWriteBack(QFile &file, qint64 offset, qint64 length);
+
+    /**
+     * @brief Wait for the data of a range of the open \a file to be on disk and drop it from the page cache
+     *
+     * For data that is not read again soon, so it doesn't push out the data of other programs.
+     */
+    void OWNCLOUDSYNC_EXPORT dropFromPageCache(QFile &file, qint64 offset, qint64 length);
+
 
     struct RemoveEntry
     {
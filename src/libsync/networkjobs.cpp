@@ -40,6 +40,7 @@
 #include "creds/httpcredentials.h"
 #include "theme.h"
 
+#include <cctype>
 
 using namespace std::chrono_literals;
 
@@ -191,104 +192,167 @@ static QString readContentsAsString(QXmlStreamReader &reader)
 
 LsColXMLParser::LsColXMLParser()
 {
+    _reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration(QStringLiteral("d"), QStringLiteral("DAV:")));
 }
 
 bool LsColXMLParser::parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath)
 {
-    // Parse DAV response
-    QXmlStreamReader reader(xml);
-    reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration(QStringLiteral("d"), QStringLiteral("DAV:")));
+    return addData(xml, sizes, expectedPath) && finish();
+}
+
+// Returns the length of the leading part of data that ends right after a </d:response>
+// end tag, 0 if there is no complete response in data.
+// In XML text '<' is always escaped, so "</" can't be part of a file name.
+static int completeResponsesLength(const QByteArray &data)
+{
+    static const QByteArray tag = QByteArrayLiteral("response>");
+    const auto isPrefixChar = [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-' || c == '.';
+    };
+    int index = data.lastIndexOf(tag);
+    while (index > 0) {
+        int tagStart = index;
+        if (data.at(tagStart - 1) == ':') {
+            // skip the namespace prefix
+            --tagStart;
+            while (tagStart > 0 && isPrefixChar(data.at(tagStart - 1))) {
+                --tagStart;
+            }
+        }
+        if (tagStart >= 2 && data.at(tagStart - 1) == '/' && data.at(tagStart - 2) == '<') {
+            return index + tag.size();
+        }
+        index = data.lastIndexOf(tag, index - 1);
+    }
+    return 0;
+}
 
-    QStringList folders;
-    QString currentHref;
-    QMap<QString, QString> currentTmpProperties;
-    QMap<QString, QString> currentHttp200Properties;
-    bool currentPropsHaveHttp200 = false;
-    bool insidePropstat = false;
-    bool insideProp = false;
-    bool insideMultiStatus = false;
+bool LsColXMLParser::addData(const QByteArray &data, QHash<QString, qint64> *sizes, const QString &expectedPath)
+{
+    if (_failed) {
+        return false;
+    }
+    _sizes = sizes;
+    _expectedPath = expectedPath;
+
+    // Only hand complete responses to the reader, that way it never runs out of
+    // data in the middle of an element and we can simply resume with the next chunk.
+    _pending.append(data);
+    const int length = completeResponsesLength(_pending);
+    if (length == 0) {
+        return true;
+    }
+    _reader.addData(_pending.left(length));
+    _pending.remove(0, length);
+    return parseAvailable();
+}
 
-    while (!reader.atEnd()) {
-        QXmlStreamReader::TokenType type = reader.readNext();
-        QString name = reader.name().toString();
+bool LsColXMLParser::finish()
+{
+    if (_failed) {
+        return false;
+    }
+    _reader.addData(_pending);
+    _pending.clear();
+    if (!parseAvailable()) {
+        return false;
+    }
+
+    if (_reader.hasError()) {
+        // XML Parser error? Whatever had been emitted before will come as directoryListingIterated
+        qCWarning(lcLsColJob) << "ERROR" << _reader.errorString();
+        _failed = true;
+        return false;
+    } else if (!_insideMultiStatus) {
+        qCWarning(lcLsColJob) << "ERROR no WebDAV response?";
+        _failed = true;
+        return false;
+    }
+    emit directoryListingSubfolders(_folders);
+    emit finishedWithoutError();
+    return true;
+}
+
+bool LsColXMLParser::parseAvailable()
+{
+    while (!_reader.atEnd()) {
+        QXmlStreamReader::TokenType type = _reader.readNext();
+        QString name = _reader.name().toString();
         // Start elements with DAV:
-        if (type == QXmlStreamReader::StartElement && reader.namespaceUri() == QLatin1String("DAV:")) {
+        if (type == QXmlStreamReader::StartElement && _reader.namespaceUri() == QLatin1String("DAV:")) {
             if (name == QLatin1String("href")) {
                 // We don't use URL encoding in our request URL (which is the expected path) (QNAM will do it for us)
                 // but the result will have URL encoding..
-                QString hrefString = QString::fromUtf8(QByteArray::fromPercentEncoding(reader.readElementText().toUtf8()));
-                if (!hrefString.startsWith(expectedPath)) {
-                    qCWarning(lcLsColJob) << "Invalid href" << hrefString << "expected starting with" << expectedPath;
+                QString hrefString = QString::fromUtf8(QByteArray::fromPercentEncoding(_reader.readElementText().toUtf8()));
+                if (!hrefString.startsWith(_expectedPath)) {
+                    qCWarning(lcLsColJob) << "Invalid href" << hrefString << "expected starting with" << _expectedPath;
+                    _failed = true;
                     return false;
                 }
-                currentHref = hrefString;
+                _currentHref = hrefString;
             } else if (name == QLatin1String("response")) {
             } else if (name == QLatin1String("propstat")) {
-                insidePropstat = true;
-            } else if (name == QLatin1String("status") && insidePropstat) {
-                QString httpStatus = reader.readElementText();
+                _insidePropstat = true;
+            } else if (name == QLatin1String("status") && _insidePropstat) {
+                QString httpStatus = _reader.readElementText();
                 if (httpStatus.startsWith(QLatin1String("HTTP/1.1 200"))) {
-                    currentPropsHaveHttp200 = true;
+                    _currentPropsHaveHttp200 = true;
                 } else {
-                    currentPropsHaveHttp200 = false;
+                    _currentPropsHaveHttp200 = false;
                 }
             } else if (name == QLatin1String("prop")) {
-                insideProp = true;
+                _insideProp = true;
                 continue;
             } else if (name == QLatin1String("multistatus")) {
-                insideMultiStatus = true;
+                _insideMultiStatus = true;
                 continue;
             }
         }
 
-        if (type == QXmlStreamReader::StartElement && insidePropstat && insideProp) {
+        if (type == QXmlStreamReader::StartElement && _insidePropstat && _insideProp) {
             // All those elements are properties
-            QString propertyContent = readContentsAsString(reader);
+            QString propertyContent = readContentsAsString(_reader);
             if (name == QLatin1String("resourcetype") && propertyContent.contains(QLatin1String("collection"))) {
-                folders.append(currentHref);
+                _folders.append(_currentHref);
             } else if (name == QLatin1String("size")) {
                 bool ok = false;
                 auto s = propertyContent.toLongLong(&ok);
-                if (ok && sizes) {
-                    sizes->insert(currentHref, s);
+                if (ok && _sizes) {
+                    _sizes->insert(_currentHref, s);
                 }
             }
-            currentTmpProperties.insert(reader.name().toString(), propertyContent);
+            _currentTmpProperties.insert(_reader.name().toString(), propertyContent);
         }
 
         // End elements with DAV:
         if (type == QXmlStreamReader::EndElement) {
-            if (reader.namespaceUri() == QLatin1String("DAV:")) {
-                if (reader.name() == QLatin1String("response")) {
-                    if (currentHref.endsWith(QLatin1Char('/'))) {
-                        currentHref.chop(1);
+            if (_reader.namespaceUri() == QLatin1String("DAV:")) {
+                if (_reader.name() == QLatin1String("response")) {
+                    if (_currentHref.endsWith(QLatin1Char('/'))) {
+                        _currentHref.chop(1);
                     }
-                    emit directoryListingIterated(currentHref, currentHttp200Properties);
-                    currentHref.clear();
-                    currentHttp200Properties.clear();
-                } else if (reader.name() == QLatin1String("propstat")) {
-                    insidePropstat = false;
-                    if (currentPropsHaveHttp200) {
-                        currentHttp200Properties = std::move(currentTmpProperties);
+                    emit directoryListingIterated(_currentHref, _currentHttp200Properties);
+                    _currentHref.clear();
+                    _currentHttp200Properties.clear();
+                } else if (_reader.name() == QLatin1String("propstat")) {
+                    _insidePropstat = false;
+                    if (_currentPropsHaveHttp200) {
+                        _currentHttp200Properties = std::move(_currentTmpProperties);
                     }
-                    currentPropsHaveHttp200 = false;
-                } else if (reader.name() == QLatin1String("prop")) {
-                    insideProp = false;
+                    _currentPropsHaveHttp200 = false;
+                } else if (_reader.name() == QLatin1String("prop")) {
+                    _insideProp = false;
                 }
             }
         }
     }
 
-    if (reader.hasError()) {
-        // XML Parser error? Whatever had been emitted before will come as directoryListingIterated
-        qCWarning(lcLsColJob) << "ERROR" << reader.errorString() << xml;
-        return false;
-    } else if (!insideMultiStatus) {
-        qCWarning(lcLsColJob) << "ERROR no WebDAV response?" << xml;
+    // Running out of data is expected while more of the reply is still to come,
+    // finish() reports it if the document really is incomplete.
+    if (_reader.hasError() && _reader.error() != QXmlStreamReader::PrematureDocumentEndError) {
+        qCWarning(lcLsColJob) << "ERROR" << _reader.errorString();
+        _failed = true;
         return false;
-    } else {
-        emit directoryListingSubfolders(folders);
-        emit finishedWithoutError();
     }
     return true;
 }
@@ -314,44 +378,82 @@ QList<QByteArray> LsColJob::properties() const
     return _properties;
 }
 
+void LsColJob::setDepth(const QByteArray &depth)
+{
+    _depth = depth;
+}
+
 void LsColJob::start()
 {
     QNetworkRequest req;
-    req.setRawHeader(QByteArrayLiteral("Depth"), QByteArrayLiteral("1"));
+    req.setRawHeader(QByteArrayLiteral("Depth"), _depth);
+    // Listings of big folders are several megabytes, parse them while they arrive
+    _incrementalParsing = true;
     startImpl(req);
 }
 
-// TODO: Instead of doing all in this slot, we should iteratively parse in readyRead(). This
-// would allow us to be more asynchronous in processing while data is coming from the network,
-// not all in one big blob at the end.
-void LsColJob::finished()
+void LsColJob::newReplyHook(QNetworkReply *reply)
 {
-    qCInfo(lcLsColJob) << "LSCOL of" << reply()->request().url() << "FINISHED WITH STATUS"
-                       << replyStatusString();
+    // A new reply starts a new document
+    _parser.reset();
+    _parseFailed = false;
+    if (_incrementalParsing) {
+        connect(reply, &QNetworkReply::readyRead, this, &LsColJob::slotReadyRead);
+    }
+}
 
-    QString contentType = reply()->header(QNetworkRequest::ContentTypeHeader).toString();
-    int httpCode = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    if (httpCode == 207 && contentType.contains(QLatin1String("application/xml; charset=utf-8"))) {
-        LsColXMLParser parser;
-        connect(&parser, &LsColXMLParser::directoryListingSubfolders,
+bool LsColJob::isMultiStatusReply() const
+{
+    const QString contentType = reply()->header(QNetworkRequest::ContentTypeHeader).toString();
+    const int httpCode = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return httpCode == 207 && contentType.contains(QLatin1String("application/xml; charset=utf-8"));
+}
+
+LsColXMLParser *LsColJob::parser()
+{
+    if (!_parser) {
+        _parser.reset(new LsColXMLParser);
+        connect(_parser.get(), &LsColXMLParser::directoryListingSubfolders,
             this, &LsColJob::directoryListingSubfolders);
-        connect(&parser, &LsColXMLParser::directoryListingIterated,
+        connect(_parser.get(), &LsColXMLParser::directoryListingIterated,
             this, &LsColJob::directoryListingIterated);
-        connect(&parser, &LsColXMLParser::finishedWithError,
+        connect(_parser.get(), &LsColXMLParser::finishedWithError,
             this, &LsColJob::finishedWithError);
-        connect(&parser, &LsColXMLParser::finishedWithoutError,
+        connect(_parser.get(), &LsColXMLParser::finishedWithoutError,
             this, &LsColJob::finishedWithoutError);
+    }
+    return _parser.get();
+}
+
+void LsColJob::slotReadyRead()
+{
+    if (!isMultiStatusReply()) {
+        // errors are handled in finished()
+        return;
+    }
+    const QByteArray data = reply()->readAll();
+    if (_parseFailed) {
+        return;
+    }
+    QString expectedPath = reply()->request().url().path(); // something like "/owncloud/remote.php/webdav/folder"
+    if (!parser()->addData(data, &_sizes, expectedPath)) {
+        _parseFailed = true;
+    }
+}
 
+void LsColJob::finished()
+{
+    qCInfo(lcLsColJob) << "LSCOL of" << reply()->request().url() << "FINISHED WITH STATUS"
+                       << replyStatusString();
+
+    if (isMultiStatusReply()) {
         QString expectedPath = reply()->request().url().path(); // something like "/owncloud/remote.php/webdav/folder"
-        if (!parser.parse(reply()->readAll(), &_sizes, expectedPath)) {
+        if (_parseFailed || !parser()->addData(reply()->readAll(), &_sizes, expectedPath) || !parser()->finish()) {
             // XML parse error
             emit finishedWithError(reply());
         }
-    } else if (httpCode == 207) {
-        // wrong content type
-        emit finishedWithError(reply());
     } else {
-        // wrong HTTP code or any other network error
+        // wrong HTTP code, wrong content type or any other network error
         emit finishedWithError(reply());
     }
 }
@@ -20,7 +20,9 @@
 #include "common/result.h"
 #include <QJsonObject>
 #include <QUrlQuery>
+#include <QXmlStreamReader>
 #include <functional>
+#include <memory>
 
 class QUrl;
 
@@ -66,13 +68,44 @@ class OWNCLOUDSYNC_EXPORT LsColXMLParser : public QObject
 public:
     explicit LsColXMLParser();
 
+    /** Parses a complete PROPFIND reply */
     bool parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath);
 
+    /**
+     * Parses a PROPFIND reply while it is still arriving.
+     *
+     * Every <d:response> that is complete after adding data is reported
+     * with directoryListingIterated() right away, the rest is kept until
+     * the next call. Call finish() once the whole reply was added.
+     *
+     * Returns false on parse errors, the parser is unusable after that.
+     */
+    bool addData(const QByteArray &data, QHash<QString, qint64> *sizes, const QString &expectedPath);
+    bool finish();
+
 signals:
     void directoryListingSubfolders(const QStringList &items);
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
     void finishedWithError(QNetworkReply *reply);
     void finishedWithoutError();
+
+private:
+    bool parseAvailable();
+
+    QXmlStreamReader _reader;
+    QByteArray _pending;
+    QHash<QString, qint64> *_sizes = nullptr;
+    QString _expectedPath;
+    bool _failed = false;
+
+    QStringList _folders;
+    QString _currentHref;
+    QMap<QString, QString> _currentTmpProperties;
+    QMap<QString, QString> _currentHttp200Properties;
+    bool _currentPropsHaveHttp200 = false;
+    bool _insidePropstat = false;
+    bool _insideProp = false;
+    bool _insideMultiStatus = false;
 };
 
 class OWNCLOUDSYNC_EXPORT LsColJob : public AbstractNetworkJob
@@ -93,6 +126,9 @@ public:
     void setProperties(const QList<QByteArray> &properties);
     QList<QByteArray> properties() const;
 
+    /** The value of the Depth header, "1" by default */
+    void setDepth(const QByteArray &depth);
+
     const QHash<QString, qint64> &sizes() const;
 
 signals:
@@ -103,13 +139,24 @@ signals:
 
 private slots:
     void finished() override;
+    void slotReadyRead();
 
 protected:
     void startImpl(const QNetworkRequest &req);
+    void newReplyHook(QNetworkReply *reply) override;
 
 private:
+    bool isMultiStatusReply() const;
+    LsColXMLParser *parser();
+
     QList<QByteArray> _properties;
     QHash<QString, qint64> _sizes;
+    QByteArray _depth = QByteArrayLiteral("1");
+
+    // Whether the reply is parsed as it arrives, see slotReadyRead()
+    bool _incrementalParsing = false;
+    bool _parseFailed = false;
+    std::unique_ptr<LsColXMLParser> _parser;
 };
 
 /**
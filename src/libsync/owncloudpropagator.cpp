@@ -26,6 +26,7 @@
 #include "propagateremotemkdir.h"
 #include "propagateremotemove.h"
 #include "propagateupload.h"
+#include "propagateuploadbulk.h"
 #include "propagateuploadtus.h"
 #include "propagatorjobs.h"
 
@@ -77,20 +78,109 @@ qint64 freeSpaceLimit()
     return value;
 }
 
+namespace {
+    // All propagators of the process, they live in the main thread
+    QList<OwncloudPropagator *> &allPropagators()
+    {
+        static QList<OwncloudPropagator *> propagators;
+        return propagators;
+    }
+
+    int globalMaximumActiveJobsValue = 0;
+}
+
+OwncloudPropagator::OwncloudPropagator(AccountPtr account, const SyncOptions &options, const QUrl &baseUrl, const QString &localDir,
+    const QString &remoteFolder, SyncJournalDb *progressDb)
+    : _journal(progressDb)
+    , _finishedEmited(false)
+    , _bandwidthManager(this)
+    , _anotherSyncNeeded(false)
+    , _chunkSize(options._initialChunkSize)
+    , _account(account)
+    , _syncOptions(options)
+    , _localDir((localDir.endsWith(QLatin1Char('/'))) ? localDir : localDir + QLatin1Char('/'))
+    , _remoteFolder((remoteFolder.endsWith(QLatin1Char('/'))) ? remoteFolder : remoteFolder + QLatin1Char('/'))
+    , _webDavUrl(baseUrl)
+{
+    qRegisterMetaType<PropagatorJob::AbortType>("PropagatorJob::AbortType");
+    allPropagators().append(this);
+
+    connect(this, &OwncloudPropagator::itemCompleted, this, [this](const SyncFileItemPtr &item) {
+        _reportedProgress.remove(item->_file);
+    });
+}
+
 OwncloudPropagator::~OwncloudPropagator()
 {
+    allPropagators().removeAll(this);
+    // our jobs no longer count towards the global limit
+    wakeWaitingPropagators();
+}
+
+void OwncloudPropagator::setGlobalMaximumActiveJobs(int limit)
+{
+    globalMaximumActiveJobsValue = qMax(0, limit);
+}
+
+int OwncloudPropagator::globalMaximumActiveJobs()
+{
+    return globalMaximumActiveJobsValue;
+}
+
+int OwncloudPropagator::globalActiveJobCount()
+{
+    int count = 0;
+    for (const auto *p : qAsConst(allPropagators())) {
+        count += p->_activeJobList.count();
+    }
+    return count;
+}
+
+bool OwncloudPropagator::hasGlobalJobCapacity() const
+{
+    const int limit = globalMaximumActiveJobs();
+    if (limit == 0) {
+        return true;
+    }
+    if (globalActiveJobCount() >= limit) {
+        return false;
+    }
+    int waiting = 0;
+    for (const auto *p : qAsConst(allPropagators())) {
+        if (p != this && p->_waitingForGlobalCapacity) {
+            waiting++;
+        }
+    }
+    if (waiting == 0) {
+        return true;
+    }
+    // Don't take more than our share of the slots while others are waiting.
+    // Rounding up guarantees that one of the waiting propagators can always
+    // make progress while there is a free slot.
+    return _activeJobList.count() < qCeil(limit / static_cast<double>(waiting + 1));
+}
+
+void OwncloudPropagator::wakeWaitingPropagators()
+{
+    if (globalMaximumActiveJobs() == 0 || globalActiveJobCount() >= globalMaximumActiveJobs()) {
+        return;
+    }
+    for (auto *p : qAsConst(allPropagators())) {
+        if (p != this && p->_waitingForGlobalCapacity) {
+            p->scheduleNextJob();
+        }
+    }
 }
 
 
 int OwncloudPropagator::maximumActiveTransferJob()
 {
-    if (_downloadLimit != 0
-        || _uploadLimit != 0
-        || !_syncOptions._parallelNetworkJobs) {
-        // disable parallelism when there is a network limit.
+    if (!_syncOptions._parallelNetworkJobs) {
         return 1;
     }
-    return qMin(3, qCeil(_syncOptions._parallelNetworkJobs / 2.));
+    // Bandwidth limits don't need to disable parallelism, the BandwidthManager
+    // divides the quota among the running transfers.
+    return qBound(1, _account->transferConcurrency()->limit(), hardMaximumActiveJob());
 }
 
 /* The maximum number of active jobs in parallel  */
@@ -386,13 +476,16 @@ qint64 OwncloudPropagator::smallFileSize()
     return smallFileSize;
 }
 
-void OwncloudPropagator::start(SyncFileItemSet &&items)
+void OwncloudPropagator::start(SyncFileItemVector &&items)
 {
     /* This builds all the jobs needed for the propagation.
      * Each directory is a PropagateDirectory job, which contains the files in it.
      * In order to do that we loop over the items. (which are sorted by destination)
      * When we enter a directory, we can create the directory job and push it on the stack. */
 
+    // Don't let the transfer limit grow beyond what the scheduler will run
+    _account->transferConcurrency()->setMaximumLimit(hardMaximumActiveJob());
+
     _rootJob.reset(new PropagateRootDirectory(this));
     QStack<QPair<QString /* directory name */, PropagateDirectory * /* job */>> directories;
     directories.push(qMakePair(QString(), _rootJob.data()));
@@ -620,6 +713,13 @@ void OwncloudPropagator::scheduleNextJobImpl()
 
     _jobScheduled = false;
 
+    _waitingForGlobalCapacity = !hasGlobalJobCapacity();
+    // Either we are over our fair share or we might not use all of the free slots
+    wakeWaitingPropagators();
+    if (_waitingForGlobalCapacity) {
+        return;
+    }
+
     if (_activeJobList.count() < maximumActiveTransferJob()) {
         if (_rootJob->scheduleSelfOrChild()) {
             scheduleNextJob();
@@ -674,6 +774,13 @@ void OwncloudPropagator::abort()
 
 void OwncloudPropagator::reportProgress(const SyncFileItem &item, qint64 bytes)
 {
+    // Feed the throughput measurement of the account, progress may also be reset
+    auto &reported = _reportedProgress[item._file];
+    if (bytes > reported) {
+        _account->transferConcurrency()->addActiveTransfers(_activeJobList.count());
+        _account->transferConcurrency()->addTransferredBytes(bytes - reported);
+    }
+    reported = bytes;
     emit progress(item, bytes);
 }
 
@@ -881,9 +988,16 @@ bool PropagatorCompositeJob::scheduleSelfOrChild()
     // Now it's our turn, check if we have something left to do.
     // First, convert a task to a job if necessary
     while (_jobsToDo.empty() && !_tasksToDo.empty()) {
-        const SyncFileItemPtr nextTask = *_tasksToDo.begin();
-        _tasksToDo.erase(_tasksToDo.begin());
-        PropagatorJob *job = propagator()->createJob(nextTask);
+        const SyncFileItemPtr nextTask = _tasksToDo.front();
+        _tasksToDo.pop_front();
+        PropagatorJob *job = nullptr;
+        if (PropagateUploadBulk::canUpload(propagator(), *nextTask)) {
+            // Send small uploads of this directory in one request
+            job = PropagateUploadBulk::createBatch(propagator(), nextTask, _tasksToDo);
+        }
+        if (!job) {
+            job = propagator()->createJob(nextTask);
+        }
         if (!job) {
             qCWarning(lcDirectory) << "Useless task found for file" << nextTask->destination() << "instruction" << nextTask->_instruction;
             continue;
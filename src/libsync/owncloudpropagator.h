@@ -24,6 +24,9 @@
 #include <QIODevice>
 #include <QMutex>
 
+#include <algorithm>
+#include <deque>
+
 #include "csync.h"
 #include "syncfileitem.h"
 #include "common/syncjournaldb.h"
@@ -185,7 +188,8 @@ class PropagatorCompositeJob : public PropagatorJob
     Q_OBJECT
 public:
     QVector<PropagatorJob *> _jobsToDo;
-    SyncFileItemSet _tasksToDo;
+    /// Sorted by destination, taken from the front
+    std::deque<SyncFileItemPtr> _tasksToDo;
     QVector<PropagatorJob *> _runningJobs;
     SyncFileItem::Status _hasError; // NoStatus,  or NormalError / SoftError if there was an error
     quint64 _abortsCount;
@@ -206,7 +210,8 @@ public:
     void appendJob(PropagatorJob *job);
     void appendTask(const SyncFileItemPtr &item)
     {
-        _tasksToDo.insert(item);
+        // The items mostly arrive in order and go to the end
+        _tasksToDo.insert(std::upper_bound(_tasksToDo.begin(), _tasksToDo.end(), item), item);
     }
 
     bool scheduleSelfOrChild() override;
@@ -372,24 +377,11 @@ public:
 
 public:
     OwncloudPropagator(AccountPtr account, const SyncOptions &options, const QUrl &baseUrl, const QString &localDir,
-        const QString &remoteFolder, SyncJournalDb *progressDb)
-        : _journal(progressDb)
-        , _finishedEmited(false)
-        , _bandwidthManager(this)
-        , _anotherSyncNeeded(false)
-        , _chunkSize(options._initialChunkSize)
-        , _account(account)
-        , _syncOptions(options)
-        , _localDir((localDir.endsWith(QLatin1Char('/'))) ? localDir : localDir + QLatin1Char('/'))
-        , _remoteFolder((remoteFolder.endsWith(QLatin1Char('/'))) ? remoteFolder : remoteFolder + QLatin1Char('/'))
-        , _webDavUrl(baseUrl)
-    {
-        qRegisterMetaType<PropagatorJob::AbortType>("PropagatorJob::AbortType");
-    }
+        const QString &remoteFolder, SyncJournalDb *progressDb);
 
     ~OwncloudPropagator() override;
 
-    void start(SyncFileItemSet &&_syncedItems);
+    void start(SyncFileItemVector &&_syncedItems);
 
     const SyncOptions &syncOptions() const;
 
@@ -410,6 +402,12 @@ public:
     /** We detected that another sync is required after this one */
     bool _anotherSyncNeeded;
 
+    /** The server rejected the bulk upload endpoint, upload files on their own */
+    bool _bulkUploadUnsupported = false;
+
+    /** The server ignored a Range request, download files with a single GET */
+    bool _rangedDownloadUnsupported = false;
+
     /** Per-folder quota guesses.
      *
      * This starts out empty. When an upload in a folder fails due to insufficent
@@ -423,7 +421,11 @@ public:
      */
     QHash<QString, qint64> _folderQuota;
 
-    /* the maximum number of jobs using bandwidth (uploads or downloads, in parallel) */
+    /** The maximum number of jobs using bandwidth (uploads or downloads, in parallel)
+     *
+     * Adapted to the measured throughput and latency by the account's
+     * TransferConcurrency, bounded by hardMaximumActiveJob().
+     */
     int maximumActiveTransferJob();
 
     /** The size to use for upload chunks.
@@ -438,6 +440,18 @@ public:
     /* The maximum number of active jobs in parallel  */
     int hardMaximumActiveJob();
 
+    /** Limits the number of active jobs of all propagators in the process.
+     *
+     * When several folders sync at the same time, each propagator still
+     * honors its own hardMaximumActiveJob(). This caps the sum of them, and
+     * while propagators are waiting for a free slot each one only gets its
+     * fair share of it.
+     *
+     * 0 means no global limit (the default).
+     */
+    static void setGlobalMaximumActiveJobs(int limit);
+    static int globalMaximumActiveJobs();
+
     /** Check whether a download would clash with an existing file
      * in filesystems that are only case-preserving.
      * Returns the path of the clashed file
@@ -545,6 +559,16 @@ private slots:
 
     void scheduleNextJobImpl();
 
+private:
+    /** The number of active jobs of all propagators */
+    static int globalActiveJobCount();
+
+    /** Whether the global job limit allows this propagator to start another job */
+    bool hasGlobalJobCapacity() const;
+
+    /** Gives other propagators waiting for the global job limit a chance to schedule */
+    void wakeWaitingPropagators();
+
 signals:
     void newItem(const SyncFileItemPtr &);
     void itemCompleted(const SyncFileItemPtr &);
@@ -570,6 +594,10 @@ private:
     QScopedPointer<PropagateRootDirectory> _rootJob;
     SyncOptions _syncOptions;
     bool _jobScheduled = false;
+    bool _waitingForGlobalCapacity = false;
+
+    /// The last progress reportProgress() got for each running transfer
+    QHash<QString, qint64> _reportedProgress;
 
     const QString _localDir; // absolute path to the local directory. ends with '/'
     const QString _remoteFolder; // remote folder, ends with '/'
@@ -71,6 +71,18 @@ QString OWNCLOUDSYNC_EXPORT createDownloadTmpFileName(const QString &previous)
     }
 }
 
+namespace {
+    /// The checksum of the whole file the server sent along with the data
+    QByteArray transmissionChecksumHeader(QNetworkReply *reply)
+    {
+        auto checksumHeader = findBestChecksum(reply->rawHeader(checkSumHeaderC));
+        auto contentMd5Header = reply->rawHeader(contentMd5HeaderC);
+        if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty())
+            checksumHeader = "MD5:" + contentMd5Header;
+        return checksumHeader;
+    }
+}
+
 // DOES NOT take ownership of the device.
 GETFileJob::GETFileJob(AccountPtr account, const QUrl &url, const QString &path, QIODevice *device,
     const QMap<QByteArray, QByteArray> &headers, const QByteArray &expectedEtagForResume,
@@ -97,7 +109,9 @@ GETFileJob::GETFileJob(AccountPtr account, const QUrl &url, const QString &path,
 
 void GETFileJob::start()
 {
-    if (_resumeStart > 0) {
+    if (_rangeSize > 0) {
+        _headers["Range"] = "bytes=" + QByteArray::number(_resumeStart) + '-' + QByteArray::number(_resumeStart + _rangeSize - 1);
+    } else if (_resumeStart > 0) {
         _headers["Range"] = "bytes=" + QByteArray::number(_resumeStart) + '-';
         _headers["Accept-Ranges"] = "bytes";
         qCDebug(lcGetJob) << "Retry with range " << _headers["Range"];
@@ -109,6 +123,7 @@ void GETFileJob::start()
     }
 
     sendRequest("GET", req);
+    _requestTimer.start();
 
     qCDebug(lcGetJob) << _bandwidthManager << _bandwidthChoked << _bandwidthLimited;
     if (_bandwidthManager) {
@@ -122,6 +137,7 @@ void GETFileJob::finished()
     if (_bandwidthManager) {
         _bandwidthManager->unregisterDownloadJob(this);
     }
+    account()->transferConcurrency()->addFinishedRequest(reply(), timedOut());
     if (reply()->bytesAvailable() && _httpOk) {
         // we were throttled, write out the remaining data
         slotReadyRead();
@@ -131,7 +147,7 @@ void GETFileJob::finished()
 
 void GETFileJob::newReplyHook(QNetworkReply *reply)
 {
-    reply->setReadBufferSize(16 * 1024); // keep low so we can easier limit the bandwidth
+    reply->setReadBufferSize(replyReadBufferSize());
 
     connect(reply, &QNetworkReply::metaDataChanged, this, &GETFileJob::slotMetaDataChanged);
     connect(reply, &QNetworkReply::finished, this, &GETFileJob::slotReadyRead);
@@ -142,7 +158,7 @@ void GETFileJob::slotMetaDataChanged()
 {
     // For some reason setting the read buffer in GETFileJob::start doesn't seem to go
     // through the HTTP layer thread(?)
-    reply()->setReadBufferSize(16 * 1024);
+    reply()->setReadBufferSize(replyReadBufferSize());
 
     int httpStatus = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
@@ -157,6 +173,11 @@ void GETFileJob::slotMetaDataChanged()
         return;
     }
 
+    if (_requestTimer.isValid()) {
+        account()->transferConcurrency()->addResponseLatency(std::chrono::milliseconds(_requestTimer.elapsed()));
+        _requestTimer.invalidate();
+    }
+
     // If the status code isn't 2xx, don't write the reply body to the file.
     // For any error: handle it when the job is finished, not here.
     if (httpStatus / 100 != 2) {
@@ -185,6 +206,24 @@ void GETFileJob::slotMetaDataChanged()
         return;
     }
 
+    qint64 start = 0;
+    const QString ranges = QString::fromUtf8(reply()->rawHeader("Content-Range"));
+    if (!ranges.isEmpty()) {
+        static QRegularExpression rx(QStringLiteral("bytes (\\d+)-"));
+        const auto match = rx.match(ranges);
+        if (match.hasMatch()) {
+            start = match.captured(1).toLongLong();
+        }
+    }
+    if (_rangeSize > 0 && (httpStatus != 206 || start != _resumeStart)) {
+        qCWarning(lcGetJob) << "The server did not answer with the requested range" << httpStatus << ranges << "expected start was" << _resumeStart;
+        _errorString = tr("The server does not support downloading parts of files");
+        _errorStatus = SyncFileItem::NormalError;
+        _rangeUnsupported = true;
+        reply()->abort();
+        return;
+    }
+
     bool ok;
     _contentLength = reply()->header(QNetworkRequest::ContentLengthHeader).toLongLong(&ok);
     if (ok && _expectedContentLength != -1 && _contentLength != _expectedContentLength) {
@@ -196,15 +235,6 @@ void GETFileJob::slotMetaDataChanged()
         return;
     }
 
-    qint64 start = 0;
-    const QString ranges = QString::fromUtf8(reply()->rawHeader("Content-Range"));
-    if (!ranges.isEmpty()) {
-        static QRegularExpression rx(QStringLiteral("bytes (\\d+)-"));
-        const auto match = rx.match(ranges);
-        if (match.hasMatch()) {
-            start = match.captured(1).toLongLong();
-        }
-    }
     if (start != _resumeStart) {
         qCWarning(lcGetJob) << "Wrong content-range: " << ranges << " while expecting start was" << _resumeStart;
         if (ranges.isEmpty()) {
@@ -247,6 +277,9 @@ void GETFileJob::setChoked(bool c)
 void GETFileJob::setBandwidthLimited(bool b)
 {
     _bandwidthLimited = b;
+    if (_httpOk && reply()) {
+        reply()->setReadBufferSize(replyReadBufferSize());
+    }
     QMetaObject::invokeMethod(this, &GETFileJob::slotReadyRead, Qt::QueuedConnection);
 }
 
@@ -265,6 +298,51 @@ qint64 GETFileJob::currentDownloadPosition()
     return _resumeStart;
 }
 
+RangeWriteDevice::RangeWriteDevice(QFile *file, qint64 start, QObject *parent)
+    : QIODevice(parent)
+    , _file(file)
+{
+    open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+    seek(start);
+}
+
+qint64 RangeWriteDevice::writeData(const char *data, qint64 len)
+{
+    if (!_file->isOpen()) {
+        setErrorString(tr("The file was closed"));
+        return -1;
+    }
+#ifdef Q_OS_UNIX
+    qint64 written = 0;
+    while (written < len) {
+        const auto result = ::pwrite(_file->handle(), data + written, len - written, pos() + written);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            setErrorString(QString::fromLocal8Bit(strerror(errno)));
+            return -1;
+        }
+        written += result;
+    }
+    return written;
+#else
+    // The file is only used from this thread, the position can't change in between
+    if (!_file->seek(pos())) {
+        setErrorString(_file->errorString());
+        return -1;
+    }
+    const qint64 written = _file->write(data, len);
+    if (written < 0)
+        setErrorString(_file->errorString());
+    return written;
+#endif
+}
+
+qint64 GETFileJob::replyReadBufferSize() const
+{
+    return _bandwidthLimited ? 16 * 1024 : _downloadBufferSize;
+}
+
 void GETFileJob::slotReadyRead()
 {
     Q_ASSERT(reply());
@@ -272,8 +350,11 @@ void GETFileJob::slotReadyRead()
         return;
     }
 
-    const qint64 bufferSize = std::min<qint64>(1024 * 8, reply()->bytesAvailable());
-    QByteArray buffer(bufferSize, Qt::Uninitialized);
+    const qint64 bufferSize = std::min<qint64>(_downloadBufferSize, reply()->bytesAvailable());
+    if (_readBuffer.size() < bufferSize) {
+        _readBuffer.resize(bufferSize);
+    }
+    char *buffer = _readBuffer.data();
 
     while (reply()->bytesAvailable() > 0) {
         if (_bandwidthChoked) {
@@ -290,7 +371,7 @@ void GETFileJob::slotReadyRead()
             _bandwidthQuota -= toRead;
         }
 
-        const qint64 read = reply()->read(buffer.data(), toRead);
+        const qint64 read = reply()->read(buffer, toRead);
         if (read < 0) {
             _errorString = networkReplyErrorString(*reply());
             _errorStatus = SyncFileItem::NormalError;
@@ -299,7 +380,7 @@ void GETFileJob::slotReadyRead()
             return;
         }
 
-        const qint64 written = _device->write(buffer.constData(), read);
+        const qint64 written = _device->write(buffer, read);
         if (written != read) {
             _errorString = _device->errorString();
             _errorStatus = SyncFileItem::NormalError;
@@ -471,26 +552,54 @@ void PropagateDownloadFile::startDownload()
         } else {
             tmpFileName = progressInfo._tmpfile;
             _expectedEtagForResume = progressInfo._etag;
+            _rangeSize = progressInfo._rangeSize;
+            _completedRanges = progressInfo._completedRanges;
         }
     }
 
     if (tmpFileName.isEmpty()) {
         tmpFileName = createDownloadTmpFileName(_item->_file);
+        const qint64 rangeSize = propagator()->syncOptions()._downloadRangeSize;
+        if (rangeSize > 0 && _item->_size > rangeSize && _item->_directDownloadUrl.isEmpty()
+            && !propagator()->_rangedDownloadUnsupported) {
+            _rangeSize = rangeSize;
+        }
     }
+    _tmpFileName = tmpFileName;
     _tmpFile.setFileName(propagator()->fullLocalPath(tmpFileName));
 
-    _resumeStart = _tmpFile.size();
-    if (_resumeStart > 0 && _resumeStart == _item->_size) {
-        qCInfo(lcPropagateDownload) << "File is already complete, no need to download";
-        downloadFinished();
-        return;
+    if (_rangeSize > 0) {
+        const int rangeCount = static_cast<int>((_item->_size + _rangeSize - 1) / _rangeSize);
+        if (_completedRanges.size() != rangeCount || !_tmpFile.exists()) {
+            _completedRanges = QBitArray(rangeCount);
+        }
+        _resumeStart = 0;
+        for (int i = 0; i < rangeCount; ++i) {
+            if (_completedRanges.testBit(i)) {
+                _resumeStart += rangeLength(i);
+            }
+        }
+        if (_resumeStart == _item->_size) {
+            qCInfo(lcPropagateDownload) << "All ranges are already complete, no need to download";
+            downloadFinished();
+            return;
+        }
+    } else {
+        _resumeStart = _tmpFile.size();
+        if (_resumeStart > 0 && _resumeStart == _item->_size) {
+            qCInfo(lcPropagateDownload) << "File is already complete, no need to download";
+            downloadFinished();
+            return;
+        }
     }
 
     // Can't open(Append) read-only files, make sure to make
     // file writable if it exists.
     if (_tmpFile.exists())
         FileSystem::setFileReadOnly(_tmpFile.fileName(), false);
-    if (!_tmpFile.open(QIODevice::Append | QIODevice::Unbuffered)) {
+    // The ranges are written at their offsets, don't truncate the ones that are already there
+    const auto openMode = _rangeSize > 0 ? QIODevice::ReadWrite : QIODevice::Append;
+    if (!_tmpFile.open(openMode | QIODevice::Unbuffered)) {
         qCWarning(lcPropagateDownload) << "could not open temporary file" << _tmpFile.fileName();
         done(SyncFileItem::NormalError, _tmpFile.errorString());
         return;
@@ -521,16 +630,43 @@ void PropagateDownloadFile::startDownload()
         return;
     }
 
-    {
-        SyncJournalDb::DownloadInfo pi;
-        pi._etag = _item->_etag;
-        pi._tmpfile = tmpFileName;
-        pi._valid = true;
-        propagator()->_journal->setDownloadInfo(_item->_file, pi);
-        propagator()->_journal->commit(QStringLiteral("download file start"));
+    // Reserve the space of the whole file at once, a ranged download also needs the full size right away
+    if (_item->_size > _resumeStart) {
+        QString error;
+        const auto result = FileSystem::preallocate(_tmpFile, _item->_size, _rangeSize == 0, &error);
+        if (result == FileSystem::PreallocateResult::Failed) {
+            done(SyncFileItem::NormalError, tr("Could not reserve the disk space for the download: %1").arg(error));
+            if (_resumeStart == 0) {
+                _tmpFile.remove();
+            }
+            return;
+        }
+        _preallocated = result == FileSystem::PreallocateResult::Reserved;
     }
 
-    startFullDownload();
+    const qint64 cacheBypassSize = propagator()->syncOptions()._downloadCacheBypassSize;
+    _bypassCache = cacheBypassSize > 0 && _item->_size > cacheBypassSize;
+    _writeBackStart = _cacheDropStart = _resumeStart;
+
+    saveDownloadInfo();
+    propagator()->_journal->commitOrDefer(QStringLiteral("download file start"));
+
+    if (_rangeSize > 0) {
+        startRangedDownload();
+    } else {
+        startFullDownload();
+    }
+}
+
+void PropagateDownloadFile::saveDownloadInfo()
+{
+    SyncJournalDb::DownloadInfo pi;
+    pi._etag = _item->_etag;
+    pi._tmpfile = _tmpFileName;
+    pi._valid = true;
+    pi._rangeSize = _rangeSize;
+    pi._completedRanges = _completedRanges;
+    propagator()->_journal->setDownloadInfo(_item->_file, pi);
 }
 
 void PropagateDownloadFile::startFullDownload()
@@ -557,6 +693,7 @@ void PropagateDownloadFile::startFullDownload()
             &_tmpFile, headers, _expectedEtagForResume, _resumeStart, this);
     }
     _job->setBandwidthManager(&propagator()->_bandwidthManager);
+    _job->setDownloadBufferSize(propagator()->syncOptions()._downloadBufferSize);
     connect(_job.data(), &GETFileJob::finishedSignal, this, &PropagateDownloadFile::slotGetFinished);
     connect(qobject_cast<GETFileJob *>(_job.data()), &GETFileJob::downloadProgress,
         this, &PropagateDownloadFile::slotDownloadProgress);
@@ -564,9 +701,240 @@ void PropagateDownloadFile::startFullDownload()
     _job->start();
 }
 
+qint64 PropagateDownloadFile::rangeLength(int index) const
+{
+    return qMin(_rangeSize, _item->_size - index * _rangeSize);
+}
+
+void PropagateDownloadFile::startRangedDownload()
+{
+    // The ranges are written to their final place, where preallocate() wasn't able to grow the file
+    if (_tmpFile.size() != _item->_size && !_tmpFile.resize(_item->_size)) {
+        qCWarning(lcPropagateDownload) << "could not resize temporary file" << _tmpFile.fileName() << _tmpFile.errorString();
+        done(SyncFileItem::NormalError, _tmpFile.errorString());
+        return;
+    }
+
+    _pendingRanges.clear();
+    for (int i = 0; i < _completedRanges.size(); ++i) {
+        if (!_completedRanges.testBit(i)) {
+            _pendingRanges.append(i);
+        }
+    }
+    qCInfo(lcPropagateDownload) << "Downloading" << _item->_file << "in" << _completedRanges.size() << "ranges of" << _rangeSize
+                                << "bytes," << _pendingRanges.size() << "missing";
+    startNextRange();
+}
+
+void PropagateDownloadFile::startNextRange()
+{
+    if (propagator()->_abortRequested || _state == Finished)
+        return;
+
+    if (_pendingRanges.isEmpty()) {
+        // Wait for the remaining ranges before checking the whole file
+        if (_runningRanges.isEmpty())
+            rangedDownloadFinished();
+        return;
+    }
+
+    const int index = _pendingRanges.takeFirst();
+    const qint64 start = index * _rangeSize;
+    const qint64 size = rangeLength(index);
+
+    // The ranges must all come from the version of the item
+    auto device = new RangeWriteDevice(&_tmpFile, start);
+    auto job = new GETFileJob(propagator()->account(), propagator()->webDavUrl(),
+        propagator()->fullRemotePath(_item->_file),
+        device, {}, _item->_etag, start, this);
+    device->setParent(job);
+    _runningRanges.insert(job, { index, device, 0 });
+    job->setRangeSize(size);
+    job->setExpectedContentLength(size);
+    job->setBandwidthManager(&propagator()->_bandwidthManager);
+    job->setDownloadBufferSize(propagator()->syncOptions()._downloadBufferSize);
+    connect(job, &GETFileJob::finishedSignal, this, &PropagateDownloadFile::slotRangeFinished);
+    connect(job, &GETFileJob::downloadProgress, this, &PropagateDownloadFile::slotRangeProgress);
+    propagator()->_activeJobList.append(this);
+    job->start();
+
+    // The ranges are independent, fetch more of them while the propagator has free slots
+    if (!_pendingRanges.isEmpty() && propagator()->_activeJobList.count() < propagator()->maximumActiveTransferJob()) {
+        startNextRange();
+    }
+}
+
+void PropagateDownloadFile::slotRangeFinished()
+{
+    auto *job = qobject_cast<GETFileJob *>(sender());
+    OC_ASSERT(job);
+    propagator()->_activeJobList.removeOne(this);
+    const auto range = _runningRanges.take(job);
+    if (_state == Finished) {
+        return;
+    }
+
+    _item->_httpErrorCode = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    _item->_responseTimeStamp = job->responseTimestamp();
+    _item->_requestId = job->requestId();
+
+    const QNetworkReply::NetworkError err = job->reply()->error();
+    SyncFileItem::Status status = SyncFileItem::NoStatus;
+    QString errorString;
+    // Failures in transit are worth another try of the range
+    bool transient = false;
+    if (err != QNetworkReply::NoError) {
+        if (job->rangeUnsupported()) {
+            fallBackToFullDownload();
+            return;
+        }
+        if (!job->etag().isEmpty() && job->etag() != _item->_etag) {
+            // The file changed on the server, its data can't be combined with the ranges we have
+            abortRunningRanges();
+            _tmpFile.close();
+            FileSystem::remove(_tmpFile.fileName());
+            propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+            propagator()->_anotherSyncNeeded = true;
+            done(SyncFileItem::SoftError, job->errorString());
+            return;
+        }
+        errorString = _item->_httpErrorCode >= 400 ? job->errorStringParsingBody() : job->errorString();
+        status = job->errorStatus();
+        if (status == SyncFileItem::NoStatus) {
+            status = classifyError(err, _item->_httpErrorCode, &propagator()->_anotherSyncNeeded);
+        }
+        transient = _item->_httpErrorCode == 0 || _item->_httpErrorCode >= 500;
+    } else if (range.device->pos() != range.index * _rangeSize + rangeLength(range.index)) {
+        qCWarning(lcPropagateDownload) << "Range" << range.index << "of" << _item->_file << "ended at" << range.device->pos();
+        errorString = tr("The file could not be downloaded completely.");
+        status = SyncFileItem::SoftError;
+        transient = true;
+    }
+
+    if (status != SyncFileItem::NoStatus) {
+        if (transient && status != SyncFileItem::FatalError && !propagator()->_abortRequested
+            && ++_rangeAttempts[range.index] < maxRangeAttempts) {
+            qCWarning(lcPropagateDownload) << "Download of range" << range.index << "of" << _item->_file << "failed, retrying:" << errorString;
+            _pendingRanges.prepend(range.index);
+            startNextRange();
+            return;
+        }
+        // Keep the completed ranges for the next attempt
+        abortRunningRanges();
+        _tmpFile.close();
+        propagator()->_journal->commitOrDefer(QStringLiteral("download ranges"));
+        done(status, errorString);
+        return;
+    }
+
+    _completedRanges.setBit(range.index);
+    _rangesReceived += rangeLength(range.index);
+    if (_bypassCache) {
+        // Give the write back of a range the time of the next one before waiting for it
+        FileSystem::startWriteBack(_tmpFile, range.index * _rangeSize, rangeLength(range.index));
+        if (_lastWrittenRange >= 0) {
+            FileSystem::dropFromPageCache(_tmpFile, _lastWrittenRange * _rangeSize, rangeLength(_lastWrittenRange));
+        }
+        _lastWrittenRange = range.index;
+    }
+    if (job->lastModified()) {
+        // It is possible that the file was modified on the server since we did the discovery phase
+        // so make sure we have the up-to-date time
+        _item->_modtime = job->lastModified();
+    }
+    readConflictHeaders(job->reply());
+    const QByteArray checksumHeader = transmissionChecksumHeader(job->reply());
+    if (!checksumHeader.isEmpty()) {
+        _rangeChecksumHeader = checksumHeader;
+    }
+
+    // A later attempt only fetches the missing ranges
+    saveDownloadInfo();
+    propagator()->_journal->commitOrDefer(QStringLiteral("download range"));
+
+    startNextRange();
+}
+
+void PropagateDownloadFile::slotRangeProgress(qint64 received, qint64)
+{
+    auto it = _runningRanges.find(qobject_cast<GETFileJob *>(sender()));
+    if (it == _runningRanges.end())
+        return;
+    it->received = received;
+
+    qint64 inTransit = 0;
+    for (const auto &range : qAsConst(_runningRanges))
+        inTransit += range.received;
+    _downloadProgress = _rangesReceived + inTransit;
+    propagator()->reportProgress(*_item, _resumeStart + _downloadProgress);
+}
+
+void PropagateDownloadFile::rangedDownloadFinished()
+{
+    if (_bypassCache && _lastWrittenRange >= 0) {
+        FileSystem::dropFromPageCache(_tmpFile, _lastWrittenRange * _rangeSize, rangeLength(_lastWrittenRange));
+    }
+    _tmpFile.close();
+    if (_tmpFile.size() != _item->_size) {
+        qCWarning(lcPropagateDownload) << "Size of the ranges of" << _item->_file << "is" << _tmpFile.size() << "instead of" << _item->_size;
+        FileSystem::remove(_tmpFile.fileName());
+        propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
+        propagator()->_anotherSyncNeeded = true;
+        done(SyncFileItem::SoftError, tr("The file could not be downloaded completely."));
+        return;
+    }
+
+    validateTransmissionChecksum(_rangeChecksumHeader);
+}
+
+void PropagateDownloadFile::fallBackToFullDownload()
+{
+    qCWarning(lcPropagateDownload) << "The server ignored the range request, downloading" << _item->_file << "with a single GET";
+    // Don't try it again for the other files of this sync
+    propagator()->_rangedDownloadUnsupported = true;
+    abortRunningRanges();
+    _rangeSize = 0;
+    _completedRanges.clear();
+    _pendingRanges.clear();
+    _rangesReceived = 0;
+    _resumeStart = 0;
+    _downloadProgress = 0;
+    _lastWrittenRange = -1;
+    _writeBackStart = _cacheDropStart = 0;
+    // Opening the file truncates it and frees the reserved space
+    _preallocated = false;
+
+    _tmpFile.close();
+    if (!_tmpFile.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        qCWarning(lcPropagateDownload) << "could not open temporary file" << _tmpFile.fileName();
+        done(SyncFileItem::NormalError, _tmpFile.errorString());
+        return;
+    }
+    saveDownloadInfo();
+    propagator()->_journal->commitOrDefer(QStringLiteral("download file start"));
+    startFullDownload();
+}
+
+void PropagateDownloadFile::abortRunningRanges()
+{
+    const auto jobs = _runningRanges.keys();
+    _runningRanges.clear();
+    for (auto *job : jobs) {
+        disconnect(job, nullptr, this, nullptr);
+        // Late data must not end up in the file
+        if (auto *device = job->findChild<RangeWriteDevice *>())
+            device->close();
+        propagator()->_activeJobList.removeOne(this);
+        if (job->reply()) {
+            job->reply()->abort();
+        }
+    }
+}
+
 qint64 PropagateDownloadFile::committedDiskSpace() const
 {
-    if (_state == Running) {
+    // Preallocated space is already gone from the free space of the disk
+    if (_state == Running && !_preallocated) {
         return qBound(0LL, _item->_size - _resumeStart - _downloadProgress, _item->_size);
     }
     return 0;
@@ -667,6 +1035,9 @@ void PropagateDownloadFile::slotGetFinished()
         _item->_modtime = job->lastModified();
     }
 
+    if (_bypassCache) {
+        FileSystem::dropFromPageCache(_tmpFile, _cacheDropStart, qMax(0LL, _tmpFile.size() - _cacheDropStart));
+    }
     _tmpFile.close();
     _tmpFile.flush();
 
@@ -719,13 +1090,20 @@ void PropagateDownloadFile::slotGetFinished()
     // (we can't reliably determine the file id of the base file here,
     // it might still be downloaded in a parallel job and not exist in
     // the database yet!)
-    if (job->reply()->rawHeader("OC-Conflict") == "1") {
+    readConflictHeaders(job->reply());
+
+    validateTransmissionChecksum(transmissionChecksumHeader(job->reply()));
+}
+
+void PropagateDownloadFile::readConflictHeaders(QNetworkReply *reply)
+{
+    if (reply->rawHeader("OC-Conflict") == "1") {
         _conflictRecord.path = _item->_file.toUtf8();
-        _conflictRecord.initialBasePath = job->reply()->rawHeader("OC-ConflictInitialBasePath");
-        _conflictRecord.baseFileId = job->reply()->rawHeader("OC-ConflictBaseFileId");
-        _conflictRecord.baseEtag = job->reply()->rawHeader("OC-ConflictBaseEtag");
+        _conflictRecord.initialBasePath = reply->rawHeader("OC-ConflictInitialBasePath");
+        _conflictRecord.baseFileId = reply->rawHeader("OC-ConflictBaseFileId");
+        _conflictRecord.baseEtag = reply->rawHeader("OC-ConflictBaseEtag");
 
-        auto mtimeHeader = job->reply()->rawHeader("OC-ConflictBaseMtime");
+        auto mtimeHeader = reply->rawHeader("OC-ConflictBaseMtime");
         if (!mtimeHeader.isEmpty())
             _conflictRecord.baseModtime = mtimeHeader.toLongLong();
 
@@ -733,7 +1111,10 @@ void PropagateDownloadFile::slotGetFinished()
         // successfully, much further down. Here we just grab the headers because the
         // job will be deleted later.
     }
+}
 
+void PropagateDownloadFile::validateTransmissionChecksum(const QByteArray &checksumHeader)
+{
     // Do checksum validation for the download. If there is no checksum header, the validator
     // will also emit the validated() signal to continue the flow in slot transmissionChecksumValidated()
     // as this is (still) also correct.
@@ -742,16 +1123,14 @@ void PropagateDownloadFile::slotGetFinished()
         this, &PropagateDownloadFile::transmissionChecksumValidated);
     connect(validator, &ValidateChecksumHeader::validationFailed,
         this, &PropagateDownloadFile::slotChecksumFail);
-    auto checksumHeader = findBestChecksum(job->reply()->rawHeader(checkSumHeaderC));
-    auto contentMd5Header = job->reply()->rawHeader(contentMd5HeaderC);
-    if (checksumHeader.isEmpty() && !contentMd5Header.isEmpty())
-        checksumHeader = "MD5:" + contentMd5Header;
     validator->start(_tmpFile.fileName(), checksumHeader);
 }
 
 void PropagateDownloadFile::slotChecksumFail(const QString &errMsg)
 {
     FileSystem::remove(_tmpFile.fileName());
+    // The data is gone, don't resume from it
+    propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
     propagator()->_anotherSyncNeeded = true;
     done(SyncFileItem::SoftError, errMsg); // tr("The file downloaded with a broken checksum, will be redownloaded."));
 }
@@ -1014,7 +1393,7 @@ void PropagateDownloadFile::updateMetadata(bool isConflict)
         return;
     }
     propagator()->_journal->setDownloadInfo(_item->_file, SyncJournalDb::DownloadInfo());
-    propagator()->_journal->commit(QStringLiteral("download file start2"));
+    propagator()->_journal->commitOrDefer(QStringLiteral("download file start2"));
 
     done(isConflict ? SyncFileItem::Conflict : SyncFileItem::Success);
 
@@ -1037,15 +1416,37 @@ void PropagateDownloadFile::slotDownloadProgress(qint64 received, qint64)
     if (!_job)
         return;
     _downloadProgress = received;
+    if (_bypassCache) {
+        releaseWrittenData(_job->currentDownloadPosition());
+    }
 
     propagator()->reportProgress(*_item, _resumeStart + received);
 }
 
+void PropagateDownloadFile::releaseWrittenData(qint64 written)
+{
+    // Start the write back window by window, and only wait for a window
+    // once the one after it is on its way too
+    while (written - _writeBackStart >= cacheBypassWindow) {
+        FileSystem::startWriteBack(_tmpFile, _writeBackStart, cacheBypassWindow);
+        _writeBackStart += cacheBypassWindow;
+        if (_writeBackStart - _cacheDropStart > cacheBypassWindow) {
+            FileSystem::dropFromPageCache(_tmpFile, _cacheDropStart, cacheBypassWindow);
+            _cacheDropStart += cacheBypassWindow;
+        }
+    }
+}
+
 
 void PropagateDownloadFile::abort(PropagatorJob::AbortType abortType)
 {
     if (_job && _job->reply())
         _job->reply()->abort();
+    const auto rangeJobs = _runningRanges.keys();
+    for (auto *job : rangeJobs) {
+        if (job->reply())
+            job->reply()->abort();
+    }
 
     if (abortType == AbortType::Asynchronous) {
         emit abortFinished();
@@ -17,8 +17,10 @@
 #include "networkjobs.h"
 #include "owncloudpropagator.h"
 
+#include <QBitArray>
 #include <QBuffer>
 #include <QFile>
+#include <QHash>
 
 namespace OCC {
 
@@ -60,11 +62,23 @@ public:
     qint64 expectedContentLength() const { return _expectedContentLength; }
     void setExpectedContentLength(qint64 size) { _expectedContentLength = size; }
 
+    /**
+     * Only fetch size bytes from resumeStart on.
+     *
+     * Unlike a resumed download, the server must answer with exactly that
+     * range, otherwise the job fails with rangeUnsupported() set.
+     */
+    void setRangeSize(qint64 size) { _rangeSize = size; }
+    bool rangeUnsupported() const { return _rangeUnsupported; }
+
     void setChoked(bool c);
     void setBandwidthLimited(bool b);
     void giveBandwidthQuota(qint64 q);
     void setBandwidthManager(BandwidthManager *bwm);
 
+    /** The maximum amount of data read from the reply and written to the device at once */
+    void setDownloadBufferSize(qint64 size) { _downloadBufferSize = size; }
+
     QByteArray &etag() { return _etag; }
     time_t lastModified() { return _lastModified; }
 
@@ -83,6 +97,9 @@ signals:
 protected:
     bool restartDevice();
 
+    /** Keep the network buffer small while the bandwidth is limited, so the limit is applied smoothly */
+    qint64 replyReadBufferSize() const;
+
     QByteArray _etag;
     time_t _lastModified = 0;
     QString _errorString;
@@ -90,8 +107,40 @@ protected:
     bool _bandwidthLimited = false; // if _bandwidthQuota will be used
     bool _bandwidthChoked = false; // if download is paused (won't read on readyRead())
     qint64 _bandwidthQuota = 0;
+    qint64 _downloadBufferSize = 1024 * 1024;
+    qint64 _rangeSize = -1;
+    bool _rangeUnsupported = false;
+    // Reused by slotReadyRead(), only grows up to _downloadBufferSize
+    QByteArray _readBuffer;
     bool _httpOk = false;
     QPointer<BandwidthManager> _bandwidthManager = nullptr;
+    QElapsedTimer _requestTimer; // time to the response headers feeds TransferConcurrency
+};
+
+/**
+ * @brief Writes the data of one range of a download into the shared temporary file
+ * @ingroup libsync
+ *
+ * All ranges of a file write through the descriptor of the same open QFile,
+ * each at its own position: with pwrite() where available, so no range
+ * depends on the file position another one left behind. pos() is the
+ * absolute offset in the file.
+ */
+class RangeWriteDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    /// DOES NOT take ownership of the file, which must stay open while the device is
+    RangeWriteDevice(QFile *file, qint64 start, QObject *parent = nullptr);
+
+    bool isSequential() const override { return false; }
+
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    QFile *_file;
 };
 
 /**
@@ -136,6 +185,17 @@ protected:
         +-> updateMetadata() <---------------------------------------+
 
 \endcode
+ *
+ * Files larger than SyncOptions::_downloadRangeSize are fetched with
+ * startRangedDownload() instead of startFullDownload(): each range has a GET of
+ * its own that must match the etag of the item, several of them run in parallel
+ * if the propagator has free slots, and failed ones are retried on their own.
+ * The temporary file is preallocated and every range writes to its own offset
+ * with a RangeWriteDevice. Each GET is a download job of the BandwidthManager,
+ * so the limits are shared among the ranges like among separate files.
+ * The completed ranges are recorded in the DownloadInfo, so an interrupted
+ * download only fetches the missing ones. Once all are there the flow continues
+ * with the checksum validation of the whole file.
  */
 class PropagateDownloadFile : public PropagateItemJob
 {
@@ -188,15 +248,59 @@ private slots:
     void slotDownloadProgress(qint64, qint64);
     void slotChecksumFail(const QString &errMsg);
 
+    /// Called when the GETFileJob of a range finishes
+    void slotRangeFinished();
+    void slotRangeProgress(qint64, qint64);
+
 private:
     void deleteExistingFolder();
+    void readConflictHeaders(QNetworkReply *reply);
+    void validateTransmissionChecksum(const QByteArray &checksumHeader);
+    void saveDownloadInfo();
+
+    void startRangedDownload();
+    void startNextRange();
+    void rangedDownloadFinished();
+    void fallBackToFullDownload();
+    void abortRunningRanges();
+    qint64 rangeLength(int index) const;
+
+    /// Drops the data up to written from the page cache, see SyncOptions::_downloadCacheBypassSize
+    void releaseWrittenData(qint64 written);
+
+    /// How often a range is tried before the download fails
+    static constexpr int maxRangeAttempts = 3;
+    /// The amount of data that is written back and dropped from the page cache at once
+    static constexpr qint64 cacheBypassWindow = 8 * 1024 * 1024;
 
     qint64 _resumeStart;
     qint64 _downloadProgress;
     QPointer<GETFileJob> _job;
     QFile _tmpFile;
+    QString _tmpFileName; /// relative to the sync folder, as stored in the DownloadInfo
     bool _deleteExisting;
     ConflictRecord _conflictRecord;
+    bool _preallocated = false; /// the disk space of the whole file is already taken
+
+    bool _bypassCache = false;
+    qint64 _writeBackStart = 0; /// where the data that isn't written back yet starts
+    qint64 _cacheDropStart = 0; /// where the data that is still in the page cache starts
+    int _lastWrittenRange = -1; /// the range that is written back but not dropped yet
+
+    // For a ranged download: the size of the ranges, 0 for a single GET
+    qint64 _rangeSize = 0;
+    QBitArray _completedRanges;
+    QVector<int> _pendingRanges; /// ranges that still need a GET, by index
+    struct RunningRange
+    {
+        int index;
+        RangeWriteDevice *device; /// owned by the job
+        qint64 received;
+    };
+    QHash<GETFileJob *, RunningRange> _runningRanges;
+    QHash<int, int> _rangeAttempts; /// failed attempts by range index
+    qint64 _rangesReceived = 0; /// size of the ranges completed by this job
+    QByteArray _rangeChecksumHeader;
 
     QElapsedTimer _stopwatch;
 };
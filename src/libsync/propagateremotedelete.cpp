@@ -101,7 +101,7 @@ void PropagateRemoteDelete::slotDeleteJobFinished()
     }
 
     propagator()->_journal->deleteFileRecord(_item->_originalFile, _item->isDirectory());
-    propagator()->_journal->commit(QStringLiteral("Remote Remove"));
+    propagator()->_journal->commitOrDefer(QStringLiteral("Remote Remove"));
     done(SyncFileItem::Success);
 }
 }
@@ -93,6 +93,11 @@ void PUTFileJob::finished()
 {
     _device->close();
 
+    if (_msWhenSent >= 0 && reply()->error() == QNetworkReply::NoError) {
+        account()->transferConcurrency()->addResponseLatency(std::chrono::milliseconds(_requestTimer.elapsed() - _msWhenSent));
+    }
+    account()->transferConcurrency()->addFinishedRequest(reply(), timedOut());
+
     qCInfo(lcPutJob) << "PUT of" << reply()->request().url().toString() << "FINISHED WITH STATUS"
                      << replyStatusString()
                      << reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()
@@ -101,6 +106,12 @@ void PUTFileJob::finished()
 
 void PUTFileJob::newReplyHook(QNetworkReply *reply)
 {
+    _msWhenSent = -1;
+    connect(reply, &QNetworkReply::uploadProgress, this, [this](qint64 sent, qint64 total) {
+        if (sent == total && total > 0 && _msWhenSent < 0) {
+            _msWhenSent = _requestTimer.elapsed();
+        }
+    });
     connect(reply, &QNetworkReply::uploadProgress, this, &PUTFileJob::uploadProgress);
 }
 
@@ -173,36 +184,58 @@ void PropagateUploadFileCommon::slotComputeContentChecksum()
         return;
     }
 
-    // Compute the content checksum.
+    // Compute the content checksum, and a different transmission checksum in the
+    // same pass over the file
     auto computeChecksum = new ComputeChecksum(this);
-    computeChecksum->setChecksumType(checksumType);
+    const auto transmissionType = transmissionChecksumType(checksumType);
+    if (transmissionType != checksumType && transmissionType != CheckSums::Algorithm::PARSE_ERROR) {
+        computeChecksum->setChecksumTypes({ checksumType, transmissionType });
+    } else {
+        computeChecksum->setChecksumType(checksumType);
+    }
 
-    connect(computeChecksum, &ComputeChecksum::done,
-        this, &PropagateUploadFileCommon::slotComputeTransmissionChecksum);
+    connect(computeChecksum, &ComputeChecksum::allDone, this, [this](const QVector<ChecksumHeader> &checksums) {
+        if (checksums.size() > 1) {
+            _precomputedTransmissionChecksum = checksums.at(1);
+        }
+        slotComputeTransmissionChecksum(checksums.first().type(), checksums.first().checksum());
+    });
     connect(computeChecksum, &ComputeChecksum::done,
         computeChecksum, &QObject::deleteLater);
     computeChecksum->start(filePath);
 }
 
-void PropagateUploadFileCommon::slotComputeTransmissionChecksum(CheckSums::Algorithm contentChecksumType, const QByteArray &contentChecksum)
+CheckSums::Algorithm PropagateUploadFileCommon::transmissionChecksumType(CheckSums::Algorithm contentChecksumType) const
 {
-    _item->_checksumHeader = ChecksumHeader(contentChecksumType, contentChecksum).makeChecksumHeader();
-
     // Reuse the content checksum as the transmission checksum if possible
     const auto supportedTransmissionChecksums =
         propagator()->account()->capabilities().supportedChecksumTypes();
     if (supportedTransmissionChecksums.contains(contentChecksumType)) {
+        return contentChecksumType;
+    }
+    if (uploadChecksumEnabled()) {
+        return propagator()->account()->capabilities().uploadChecksumType();
+    }
+    return CheckSums::Algorithm::PARSE_ERROR;
+}
+
+void PropagateUploadFileCommon::slotComputeTransmissionChecksum(CheckSums::Algorithm contentChecksumType, const QByteArray &contentChecksum)
+{
+    _item->_checksumHeader = ChecksumHeader(contentChecksumType, contentChecksum).makeChecksumHeader();
+
+    const auto transmissionType = transmissionChecksumType(contentChecksumType);
+    if (transmissionType == contentChecksumType) {
         slotStartUpload(contentChecksumType, contentChecksum);
         return;
     }
+    if (_precomputedTransmissionChecksum.isValid() && _precomputedTransmissionChecksum.type() == transmissionType) {
+        slotStartUpload(transmissionType, _precomputedTransmissionChecksum.checksum());
+        return;
+    }
 
     // Compute the transmission checksum.
     auto computeChecksum = new ComputeChecksum(this);
-    if (uploadChecksumEnabled()) {
-        computeChecksum->setChecksumType(propagator()->account()->capabilities().uploadChecksumType());
-    } else {
-        computeChecksum->setChecksumType(CheckSums::Algorithm::PARSE_ERROR);
-    }
+    computeChecksum->setChecksumType(transmissionType);
 
     connect(computeChecksum, &ComputeChecksum::done,
         this, &PropagateUploadFileCommon::slotStartUpload);
@@ -425,10 +458,26 @@ void PropagateUploadFileCommon::checkResettingErrors()
                                       << "is" << uploadInfo._errorCount;
         }
         propagator()->_journal->setUploadInfo(_item->_file, uploadInfo);
-        propagator()->_journal->commit(QStringLiteral("Upload info"));
+        propagator()->_journal->commitOrDefer(QStringLiteral("Upload info"));
     }
 }
 
+bool PropagateUploadFileCommon::parallelChunkUploadEnabled() const
+{
+    if (propagator()->account()->capabilities().chunkingParallelUploadDisabled()) {
+        // Server may also disable parallel chunked upload for any higher version
+        return false;
+    }
+    static bool envEnabled = [] {
+        const auto env = qEnvironmentVariable("OWNCLOUD_PARALLEL_CHUNK");
+        if (!env.isEmpty()) {
+            return env != QLatin1String("false") && env != QLatin1String("0");
+        }
+        return true;
+    }();
+    return envEnabled;
+}
+
 void PropagateUploadFileCommon::commonErrorHandling(AbstractNetworkJob *job)
 {
     QByteArray replyContent;
@@ -596,7 +645,7 @@ void PropagateUploadFileCommon::finalize()
 
     // Remove from the progress database:
     propagator()->_journal->setUploadInfo(_item->_file, SyncJournalDb::UploadInfo());
-    propagator()->_journal->commit(QStringLiteral("upload file start"));
+    propagator()->_journal->commitOrDefer(QStringLiteral("upload file start"));
 
     done(SyncFileItem::Success);
 }
@@ -15,10 +15,13 @@
 
 #include "owncloudpropagator.h"
 #include "networkjobs.h"
+#include "common/checksums.h"
 
 #include <QBuffer>
 #include <QFile>
 #include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
 
 #include <unordered_set>
 
@@ -96,6 +99,7 @@ private:
     QMap<QByteArray, QByteArray> _headers;
     QString _errorString;
     QElapsedTimer _requestTimer;
+    qint64 _msWhenSent = -1; // when the whole body was sent, for TransferConcurrency
 
 public:
     explicit PUTFileJob(AccountPtr account, const QUrl &url, const QString &path, std::unique_ptr<QIODevice> &&device,
@@ -171,6 +175,9 @@ protected:
 
     QByteArray _transmissionChecksumHeader;
 
+    /// The transmission checksum, if it was computed in the same pass as the content checksum
+    ChecksumHeader _precomputedTransmissionChecksum;
+
 public:
     PropagateUploadFileCommon(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
         : PropagateItemJob(propagator, item)
@@ -199,6 +206,10 @@ private slots:
     // transmission checksum computed, prepare the upload
     void slotStartUpload(CheckSums::Algorithm transmissionChecksumType, const QByteArray &transmissionChecksum);
 
+private:
+    // The transmission checksum to send along with a file with the given content checksum
+    CheckSums::Algorithm transmissionChecksumType(CheckSums::Algorithm contentChecksumType) const;
+
 public:
     virtual void doStartUpload() = 0;
 
@@ -236,6 +247,13 @@ protected:
      */
     void checkResettingErrors();
 
+    /**
+     * Whether several chunks of a file may be uploaded at the same time.
+     *
+     * Can be disabled by the server capabilities or OWNCLOUD_PARALLEL_CHUNK=0.
+     */
+    bool parallelChunkUploadEnabled() const;
+
     /**
      * Error handling functionality that is shared between jobs.
      */
@@ -317,10 +335,21 @@ private slots:
  *
  * Propagation job, impementing the new chunking agorithm
  *
+ * With delta sync (SyncOptions::_deltaSyncEnabled and Capabilities::deltaSync())
+ * the SHA1 of each block of deltaSyncBlockSize bytes is stored in the journal
+ * after an upload. When the file is uploaded again, only the blocks whose
+ * checksum changed are sent as chunks, and the MOVE carries "OC-Delta-Sync: 1":
+ * the server takes the ranges without a chunk from the file it replaces. As the
+ * MOVE is conditioned on the etag the checksums were stored with, that file is
+ * the one they describe.
  */
 class PropagateUploadFileNG : public PropagateUploadFileCommon
 {
     Q_OBJECT
+public:
+    /** The size of the blocks that are compared for delta sync */
+    static constexpr qint64 deltaSyncBlockSize = 1024 * 1024; // 1MiB
+
 private:
     /** Amount of data that was already sent in bytes.
      *
@@ -340,8 +369,6 @@ private:
     qint64 _bytesToUpload;
 
     uint _transferId = 0; /// transfer id (part of the url)
-    qint64 _currentChunkOffset = 0; /// byte offset of the next chunk data that will be sent
-    qint64 _currentChunkSize = 0; /// current chunk size
     bool _removeJobError = false; /// if not null, there was an error removing the job
 
     // Map chunk number with its size  from the PROPFIND on resume.
@@ -353,7 +380,8 @@ private:
     };
     QMap<qint64, ServerChunkInfo> _serverChunks;
 
-    // Vector with expected PUT ranges.
+    // Vector with the ranges that still need a PUT, sorted by start.
+    // A chunk's range is removed from it when its PUT is started.
     struct UploadRangeInfo
     {
         qint64 start;
@@ -362,6 +390,22 @@ private:
     };
     QVector<UploadRangeInfo> _rangesToUpload;
 
+    // The chunk PUTs in transit, several if parallelChunkUploadEnabled().
+    // They may finish in any order since the chunks are addressed by offset.
+    struct RunningChunkInfo
+    {
+        qint64 start;
+        qint64 size;
+        qint64 sent; /// bytes of this chunk sent so far, for progress reporting
+    };
+    QHash<PUTFileJob *, RunningChunkInfo> _runningChunks;
+
+    /// The block checksums of the local file if delta sync is enabled for it, null otherwise
+    QByteArray _blockChecksums;
+    QFutureWatcher<QByteArray> _blockChecksumsWatcher;
+    /// Whether only the changed blocks are uploaded
+    bool _deltaSync = false;
+
     /**
      * Return the path of a chunk.
      * If chunkOffset == -1, returns the URL of the parent folder containing the chunks
@@ -369,8 +413,9 @@ private:
     QString chunkPath(qint64 chunkOffset = -1);
 
     /**
-     * Finds the range starting at 'start' in _rangesToUpload and removes the first
-     * 'size' bytes from it. If it becomes empty, remove the range.
+     * Finds the range in _rangesToUpload that contains 'size' bytes at 'start' and
+     * removes them from it, splitting the range in two if needed. Empty ranges are
+     * removed.
      *
      * Retuns false if no matching range was found.
      */
@@ -381,6 +426,8 @@ public:
     void doStartUpload() override;
 
 private:
+    bool deltaSyncEnabled() const;
+    void slotBlockChecksumsComputed();
     void doStartUploadNext();
     void startNewUpload();
     void startNextChunk();
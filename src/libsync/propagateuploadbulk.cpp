@@ -0,0 +1,337 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "propagateuploadbulk.h"
+#include "account.h"
+#include "capabilities.h"
+#include "common/asserts.h"
+#include "common/syncjournaldb.h"
+#include "common/utility.h"
+#include "filesystem.h"
+#include "networkjobs.h"
+#include "owncloudpropagator_p.h"
+#include "propagatorjobs.h"
+
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcPropagateUploadBulk, "sync.propagator.upload.bulk", QtInfoMsg)
+
+PropagateUploadFileBulk::PropagateUploadFileBulk(OwncloudPropagator *propagator, const SyncFileItemPtr &item, PropagateUploadBulk *bulk)
+    : PropagateUploadFileV1(propagator, item)
+    , _bulk(bulk)
+{
+}
+
+void PropagateUploadFileBulk::doStartUpload()
+{
+    const QString fileName = propagator()->fullLocalPath(_item->_file);
+    // If the file is currently locked, we want to retry the sync
+    // when it becomes available again.
+    const auto lockMode = propagator()->syncOptions().requiredLockMode();
+    if (FileSystem::isFileLocked(fileName, lockMode)) {
+        emit propagator()->seenLockedFile(fileName, lockMode);
+        abortWithError(SyncFileItem::SoftError, tr("%1 the file is currently in use").arg(QDir::toNativeSeparators(fileName)));
+        return;
+    }
+
+    // The files are small, read them now so the request doesn't depend on them staying unchanged
+    QFile file(fileName);
+    QString openError;
+    if (!FileSystem::openAndSeekFileSharedRead(&file, &openError, 0)) {
+        // Soft error because this is likely caused by the user modifying his files while syncing
+        abortWithError(SyncFileItem::SoftError, openError);
+        return;
+    }
+    _data = file.read(_item->_size);
+    if (_data.size() != _item->_size) {
+        propagator()->_anotherSyncNeeded = true;
+        abortWithError(SyncFileItem::Message, fileChangedMessage());
+        return;
+    }
+
+    if (!_item->_checksumHeader.isEmpty()) {
+        // Write the checksum in the database, so if the request is sent to the server, but
+        // the connection drops before we get the etag, we can check the checksum in reconcile (issue #5106)
+        SyncJournalDb::UploadInfo pi;
+        pi._valid = true;
+        pi._chunk = 0;
+        pi._transferid = 0; // We set a null transfer id because it is not chunked.
+        pi._modtime = _item->_modtime;
+        pi._errorCount = 0;
+        pi._contentChecksum = _item->_checksumHeader;
+        pi._size = _item->_size;
+        propagator()->_journal->setUploadInfo(_item->_file, pi);
+        propagator()->_journal->commitOrDefer(QStringLiteral("Upload info"));
+    }
+
+    propagator()->reportProgress(*_item, 0);
+    _bulk->memberReady(this);
+}
+
+QByteArray PropagateUploadFileBulk::bulkPath() const
+{
+    return Utility::concatUrlPath(propagator()->webDavUrl(), propagator()->fullRemotePath(_item->_file)).path(QUrl::FullyEncoded).toUtf8();
+}
+
+qint64 PropagateUploadFileBulk::appendPart(QByteArray &body, const QByteArray &boundary)
+{
+    auto partHeaders = headers();
+    partHeaders[QByteArrayLiteral("X-File-Path")] = bulkPath();
+    partHeaders[QByteArrayLiteral("Content-Length")] = QByteArray::number(_data.size());
+    if (!_transmissionChecksumHeader.isEmpty()) {
+        partHeaders[checkSumHeaderC] = _transmissionChecksumHeader;
+    }
+
+    body += "--" + boundary + "\r\n";
+    for (auto it = partHeaders.cbegin(); it != partHeaders.cend(); ++it) {
+        body += it.key() + ": " + it.value() + "\r\n";
+    }
+    body += "\r\n";
+    const qint64 offset = body.size();
+    body += _data;
+    body += "\r\n";
+    // Only needed again if the file has to be uploaded on its own, and then it is read again
+    _data.clear();
+    return offset;
+}
+
+void PropagateUploadFileBulk::reportBulkProgress(qint64 sent)
+{
+    propagator()->reportProgress(*_item, qBound<qint64>(0, sent, _item->_size));
+}
+
+void PropagateUploadFileBulk::bulkUploadFinished(AbstractNetworkJob *job, const QJsonObject &result)
+{
+    _item->_responseTimeStamp = job->responseTimestamp();
+    _item->_requestId = job->requestId();
+
+    if (result.isEmpty()) {
+        done(SyncFileItem::NormalError, tr("The server did not report the result of the upload"));
+        return;
+    }
+
+    if (result.value(QStringLiteral("error")).toBool()) {
+        _item->_httpErrorCode = result.value(QStringLiteral("status")).toInt();
+        if (_item->_httpErrorCode == 412) {
+            // Precondition Failed: Either an etag or a checksum mismatch,
+            // see PropagateUploadFileCommon::commonErrorHandling
+            propagator()->_journal->schedulePathForRemoteDiscovery(_item->_file);
+            propagator()->_anotherSyncNeeded = true;
+        }
+        checkResettingErrors();
+        done(classifyError(QNetworkReply::UnknownContentError, _item->_httpErrorCode, &propagator()->_anotherSyncNeeded),
+            result.value(QStringLiteral("message")).toString());
+        return;
+    }
+    _item->_httpErrorCode = result.value(QStringLiteral("status")).toInt(201);
+
+    const QByteArray etag = parseEtag(result.value(QStringLiteral("etag")).toString().toUtf8());
+    if (etag.isEmpty()) {
+        done(SyncFileItem::NormalError, tr("The server did not acknowledge the upload. (No e-tag was present)"));
+        return;
+    }
+    _item->_etag = etag;
+
+    // the file id should only be empty for new files up- or downloaded
+    const QByteArray fid = result.value(QStringLiteral("fileid")).toString().toUtf8();
+    if (!fid.isEmpty()) {
+        if (!_item->_fileId.isEmpty() && _item->_fileId != fid) {
+            qCWarning(lcPropagateUploadBulk) << "File ID changed!" << _item->_fileId << fid;
+        }
+        _item->_fileId = fid;
+    }
+
+    // The upload is done, changes since the file was read are picked up by the next sync
+    const QString fullFilePath(propagator()->fullLocalPath(_item->_file));
+    if (!FileSystem::fileExists(fullFilePath) || FileSystem::fileChanged(fullFilePath, _item->_size, _item->_modtime)) {
+        propagator()->_anotherSyncNeeded = true;
+    }
+
+    finalize();
+}
+
+void PropagateUploadFileBulk::uploadIndividually()
+{
+    PropagateUploadFileV1::doStartUpload();
+}
+
+bool PropagateUploadBulk::canUpload(OwncloudPropagator *propagator, const SyncFileItem &item)
+{
+    return (item._instruction == CSYNC_INSTRUCTION_NEW || item._instruction == CSYNC_INSTRUCTION_SYNC)
+        && item._direction == SyncFileItem::Up
+        && item._type == ItemTypeFile
+        && item._size <= propagator->smallFileSize()
+        && !propagator->_bulkUploadUnsupported
+        && propagator->account()->capabilities().bulkUpload();
+}
+
+PropagateUploadBulk *PropagateUploadBulk::createBatch(OwncloudPropagator *propagator, const SyncFileItemPtr &first, std::deque<SyncFileItemPtr> &tasks)
+{
+    QVector<SyncFileItemPtr> items { first };
+    qint64 bytes = first->_size;
+    for (auto it = tasks.begin(); it != tasks.end() && items.size() < maximumItems;) {
+        const auto &item = **it;
+        if (item._instruction == CSYNC_INSTRUCTION_RENAME || item._instruction == CSYNC_INSTRUCTION_REMOVE) {
+            // Don't move uploads ahead of jobs that might free their name
+            break;
+        }
+        if (canUpload(propagator, item) && bytes + item._size <= maximumBytes) {
+            bytes += item._size;
+            items.append(*it);
+            it = tasks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (items.size() < 2) {
+        return nullptr;
+    }
+
+    auto bulk = new PropagateUploadBulk(propagator);
+    for (const auto &item : qAsConst(items)) {
+        bulk->addMember(item);
+    }
+    return bulk;
+}
+
+PropagateUploadBulk::PropagateUploadBulk(OwncloudPropagator *propagator)
+    : PropagatorCompositeJob(propagator)
+{
+}
+
+void PropagateUploadBulk::addMember(const SyncFileItemPtr &item)
+{
+    auto member = new PropagateUploadFileBulk(propagator(), item, this);
+    _waiting.append(member);
+    connect(member, &PropagatorJob::finished, this, [member, this] { memberFinished(member); });
+    appendJob(member);
+}
+
+void PropagateUploadBulk::memberReady(PropagateUploadFileBulk *member)
+{
+    OC_ASSERT(_phase == Phase::Collecting);
+    _waiting.removeOne(member);
+    _ready.append(member);
+    if (_waiting.isEmpty()) {
+        send();
+    } else {
+        // The member left the list of active jobs, start the next one
+        propagator()->scheduleNextJob();
+    }
+}
+
+void PropagateUploadBulk::memberFinished(PropagateUploadFileBulk *member)
+{
+    // A member that failed before it was ready must not hold back the others
+    if (_waiting.removeOne(member) && _waiting.isEmpty() && !_ready.isEmpty()) {
+        send();
+    }
+}
+
+void PropagateUploadBulk::send()
+{
+    if (propagator()->_bulkUploadUnsupported) {
+        // Another batch failed while this one was collected
+        _phase = Phase::Individually;
+        _individually = _ready;
+        propagator()->scheduleNextJob();
+        return;
+    }
+    _phase = Phase::Sending;
+
+    const QByteArray boundary = QByteArrayLiteral("bulk-upload-") + QByteArray::number(QRandomGenerator::global()->generate64(), 16);
+    QByteArray body;
+    for (auto *member : qAsConst(_ready)) {
+        _partOffsets.append(member->appendPart(body, boundary));
+    }
+    body += "--" + boundary + "--\r\n";
+    qCInfo(lcPropagateUploadBulk) << "Uploading" << _ready.size() << "files in one request of" << body.size() << "bytes";
+
+    QNetworkRequest req;
+    req.setHeader(QNetworkRequest::ContentTypeHeader, QByteArray("multipart/related; boundary=" + boundary));
+    _job = new SimpleNetworkJob(propagator()->account(), propagator()->account()->url(), QStringLiteral("remote.php/dav/bulk"), "POST", std::move(body), req, this);
+    connect(_job, &SimpleNetworkJob::finishedSignal, this, &PropagateUploadBulk::slotFinished);
+    _job->addNewReplyHook([this](QNetworkReply *reply) {
+        connect(reply, &QNetworkReply::uploadProgress, this, &PropagateUploadBulk::slotUploadProgress);
+    });
+    // The whole batch takes a single slot of the scheduler
+    propagator()->_activeJobList.append(_ready.first());
+    _job->start();
+    propagator()->scheduleNextJob();
+}
+
+void PropagateUploadBulk::slotUploadProgress(qint64 sent, qint64 total)
+{
+    // See PropagateUploadFileV1::slotUploadProgress
+    if (sent == 0 && total == 0) {
+        return;
+    }
+    for (int i = 0; i < _ready.size(); ++i) {
+        _ready.at(i)->reportBulkProgress(sent - _partOffsets.at(i));
+    }
+}
+
+void PropagateUploadBulk::slotFinished()
+{
+    propagator()->_activeJobList.removeOne(_ready.first());
+    if (propagator()->_abortRequested) {
+        return;
+    }
+
+    const int httpStatus = _job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    QJsonDocument json;
+    if (_job->reply()->error() == QNetworkReply::NoError) {
+        json = QJsonDocument::fromJson(_job->reply()->readAll());
+    }
+    // Without a valid answer we don't know which files arrived, send them again
+    if (!json.isObject()) {
+        qCWarning(lcPropagateUploadBulk) << "Bulk upload failed:" << httpStatus << _job->errorString()
+                                         << "uploading" << _ready.size() << "files on their own";
+        // Whether the endpoint is missing, the body too large or the server broken,
+        // don't try again for the rest of this sync
+        propagator()->_bulkUploadUnsupported = true;
+        _phase = Phase::Individually;
+        _individually = _ready;
+        propagator()->scheduleNextJob();
+        return;
+    }
+
+    const auto results = json.object();
+    const auto members = _ready;
+    for (auto *member : members) {
+        member->bulkUploadFinished(_job, results.value(QString::fromUtf8(member->bulkPath())).toObject());
+    }
+}
+
+bool PropagateUploadBulk::scheduleSelfOrChild()
+{
+    if (_phase == Phase::Individually && !_individually.isEmpty()) {
+        // Start the fallback uploads one by one, within the limits of the scheduler
+        _individually.takeFirst()->uploadIndividually();
+        return true;
+    }
+    return PropagatorCompositeJob::scheduleSelfOrChild();
+}
+
+void PropagateUploadBulk::abort(PropagatorJob::AbortType abortType)
+{
+    if (_job && _job->reply() && _job->reply()->isRunning()) {
+        _job->reply()->abort();
+    }
+    PropagatorCompositeJob::abort(abortType);
+}
+}
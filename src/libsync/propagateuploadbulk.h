@@ -0,0 +1,138 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#pragma once
+
+#include "propagateupload.h"
+
+#include <QPointer>
+
+class QJsonObject;
+
+namespace OCC {
+Q_DECLARE_LOGGING_CATEGORY(lcPropagateUploadBulk)
+
+class PropagateUploadBulk;
+
+/**
+ * @brief The upload of a small file as a part of a PropagateUploadBulk
+ * @ingroup libsync
+ *
+ * Checksums and finalizes the file like any other upload, but hands the
+ * data to the batch instead of sending a PUT of its own. Only if the batch
+ * request fails, the file is uploaded on its own like PropagateUploadFileV1.
+ */
+class PropagateUploadFileBulk : public PropagateUploadFileV1
+{
+    Q_OBJECT
+
+public:
+    PropagateUploadFileBulk(OwncloudPropagator *propagator, const SyncFileItemPtr &item, PropagateUploadBulk *bulk);
+
+    void doStartUpload() override;
+
+    /// The path of the file on the server, identifies the part in the request and the response
+    QByteArray bulkPath() const;
+
+    /// Appends the part of this file to the multipart body, returns the offset of the data
+    qint64 appendPart(QByteArray &body, const QByteArray &boundary);
+
+    /// The bytes of this file's part that were sent so far
+    void reportBulkProgress(qint64 sent);
+
+    /// Handles the entry of the bulk response for this file
+    void bulkUploadFinished(AbstractNetworkJob *job, const QJsonObject &result);
+
+    /// Uploads the file with a PUT of its own
+    void uploadIndividually();
+
+private:
+    PropagateUploadBulk *_bulk;
+    QByteArray _data;
+};
+
+/**
+ * @brief Uploads several small files of a directory in one request
+ * @ingroup libsync
+ *
+ * If the server supports it (Capabilities::bulkUpload()), the new and changed
+ * files of up to OwncloudPropagator::smallFileSize() are sent as the parts of
+ * one multipart/related POST to remote.php/dav/bulk instead of one PUT each.
+ * Each part carries the usual upload headers plus X-File-Path, the full DAV
+ * path of the file.
+ *
+ * The request is sent once all files of the batch are checksummed and read.
+ * The server answers with a JSON object that maps the X-File-Path of each part
+ * to its result:
+ *
+ *     { "error": false, "etag": "...", "fileid": "..." }
+ *     { "error": true, "status": 412, "message": "..." }
+ *
+ * If the request fails as a whole, every file is uploaded with a PUT of its
+ * own and no further batches are built in this sync.
+ */
+class PropagateUploadBulk : public PropagatorCompositeJob
+{
+    Q_OBJECT
+
+public:
+    /// The maximum number of files in one request
+    static constexpr int maximumItems = 100;
+    /// The maximum size of the files in one request
+    static constexpr qint64 maximumBytes = 2 * 1024 * 1024;
+
+    /// Whether the item can be uploaded as part of a batch
+    static bool canUpload(OwncloudPropagator *propagator, const SyncFileItem &item);
+
+    /**
+     * Builds a batch of first and the other items of tasks that can be
+     * uploaded with it, removing them from tasks.
+     *
+     * Returns nullptr if no other item can be added: a single file is
+     * uploaded on its own.
+     */
+    static PropagateUploadBulk *createBatch(OwncloudPropagator *propagator, const SyncFileItemPtr &first, std::deque<SyncFileItemPtr> &tasks);
+
+    explicit PropagateUploadBulk(OwncloudPropagator *propagator);
+
+    /// The member read its data and waits for the request
+    void memberReady(PropagateUploadFileBulk *member);
+
+    bool scheduleSelfOrChild() override;
+    void abort(PropagatorJob::AbortType abortType) override;
+
+private:
+    void addMember(const SyncFileItemPtr &item);
+    void memberFinished(PropagateUploadFileBulk *member);
+    void send();
+    void slotFinished();
+    void slotUploadProgress(qint64 sent, qint64 total);
+
+    enum class Phase {
+        Collecting,
+        Sending,
+        Individually
+    };
+    Phase _phase = Phase::Collecting;
+
+    /// Members that are neither ready nor finished yet
+    QVector<PropagateUploadFileBulk *> _waiting;
+    /// Members that are part of the request, in the order of their parts
+    QVector<PropagateUploadFileBulk *> _ready;
+    /// The offsets of the member's data in the request body
+    QVector<qint64> _partOffsets;
+    /// Members that still have to be uploaded on their own
+    QVector<PropagateUploadFileBulk *> _individually;
+
+    QPointer<SimpleNetworkJob> _job;
+};
+}
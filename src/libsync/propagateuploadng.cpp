@@ -25,14 +25,18 @@
 #include "syncengine.h"
 #include "propagateremotemove.h"
 #include "propagateremotedelete.h"
+#include "capabilities.h"
 #include "common/asserts.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFileInfo>
 #include <QNetworkAccessManager>
 #include <QRandomGenerator>
+#include <QtConcurrent>
 
+#include <cstring>
 #include <memory>
 
 namespace OCC {
@@ -101,12 +105,83 @@ void PropagateUploadFileNG::doStartUpload()
 
     propagator()->_activeJobList.append(this);
 
+    if (deltaSyncEnabled()) {
+        // The checksums of the blocks determine what needs to be uploaded
+        connect(&_blockChecksumsWatcher, &QFutureWatcherBase::finished, this, &PropagateUploadFileNG::slotBlockChecksumsComputed);
+        _blockChecksumsWatcher.setFuture(QtConcurrent::run(ComputeChecksum::threadPool(), [fileName] {
+            QFile file(fileName);
+            if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+                qCWarning(lcPropagateUploadNG) << "Could not open" << fileName << "to compute the block checksums" << file.errorString();
+                return QByteArray();
+            }
+            return ComputeChecksum::computeBlocksNow(&file, deltaSyncBlockSize);
+        }));
+        return;
+    }
+
     UploadRangeInfo rangeinfo = { 0, _item->_size };
     _rangesToUpload.append(rangeinfo);
     _bytesToUpload = _item->_size;
     doStartUploadNext();
 }
 
+bool PropagateUploadFileNG::deltaSyncEnabled() const
+{
+    const auto &options = propagator()->syncOptions();
+    return options._deltaSyncEnabled && _item->_size >= options._deltaSyncMinFileSize
+        && propagator()->account()->capabilities().deltaSync();
+}
+
+void PropagateUploadFileNG::slotBlockChecksumsComputed()
+{
+    if (propagator()->_abortRequested) {
+        return;
+    }
+
+    _blockChecksums = _blockChecksumsWatcher.result();
+    _bytesToUpload = 0;
+
+    // The server fills the ranges we skip from the file we replace, which
+    // must be the version the previous checksums describe: the MOVE is
+    // conditioned on its etag.
+    const auto previous = propagator()->_journal->getBlockChecksums(_item->_file);
+    const int digestSize = QCryptographicHash::hashLength(QCryptographicHash::Sha1);
+    _deltaSync = !_blockChecksums.isNull() && previous.isValid()
+        && previous._blockSize == deltaSyncBlockSize
+        && previous._checksums.size() % digestSize == 0
+        && previous._etag == _item->_etag
+        && _item->_instruction == CSYNC_INSTRUCTION_SYNC
+        && headers().contains(QByteArrayLiteral("If-Match"));
+
+    if (!_deltaSync) {
+        UploadRangeInfo rangeinfo = { 0, _item->_size };
+        _rangesToUpload.append(rangeinfo);
+        _bytesToUpload = _item->_size;
+        doStartUploadNext();
+        return;
+    }
+
+    const qint64 previousBlockCount = previous._checksums.size() / digestSize;
+    const qint64 blockCount = _blockChecksums.size() / digestSize;
+    for (qint64 i = 0; i < blockCount; ++i) {
+        if (i < previousBlockCount
+            && std::memcmp(previous._checksums.constData() + i * digestSize, _blockChecksums.constData() + i * digestSize, digestSize) == 0) {
+            continue;
+        }
+        const qint64 start = i * deltaSyncBlockSize;
+        const qint64 size = qMin(deltaSyncBlockSize, _item->_size - start);
+        if (!_rangesToUpload.isEmpty() && _rangesToUpload.last().end() == start) {
+            _rangesToUpload.last().size += size;
+        } else {
+            _rangesToUpload.append({ start, size });
+        }
+        _bytesToUpload += size;
+    }
+    qCInfo(lcPropagateUploadNG) << "Delta sync of" << _item->_file << "uploads" << _bytesToUpload << "of" << _item->_size
+                                << "bytes in" << _rangesToUpload.size() << "ranges";
+    doStartUploadNext();
+}
+
 
 void PropagateUploadFileNG::doStartUploadNext()
 {
@@ -152,28 +227,30 @@ void PropagateUploadFileNG::slotPropfindIterate(const QString &name, const QMap<
 
 bool PropagateUploadFileNG::markRangeAsDone(qint64 start, qint64 size)
 {
-    bool found = false;
     for (auto iter = _rangesToUpload.begin(); iter != _rangesToUpload.end(); ++iter) {
-        /* Only remove if they start at exactly the same chunk */
-        if (iter->start == start && iter->size >= size) {
-            found = true;
-            iter->start += size;
-            iter->size -= size;
-            if (iter->size <= 0) {
-                _rangesToUpload.erase(iter);
-                break;
-            }
+        if (start < iter->start || start + size > iter->end())
+            continue;
+
+        const UploadRangeInfo remainder = { start + size, iter->end() - (start + size) };
+        iter->size = start - iter->start;
+        if (iter->size <= 0) {
+            iter = _rangesToUpload.erase(iter);
+        } else {
+            ++iter;
+        }
+        if (remainder.size > 0) {
+            _rangesToUpload.insert(iter, remainder);
         }
+        return true;
     }
 
-    return found;
+    return false;
 }
 
 void PropagateUploadFileNG::slotPropfindFinished()
 {
     propagator()->_activeJobList.removeOne(this);
 
-    _currentChunkOffset = 0;
     _sent = 0;
 
     // here is a copy because we might need to remove item(s) during iteration
@@ -213,9 +290,9 @@ void PropagateUploadFileNG::slotPropfindFinished()
         propagator()->_activeJobList.append(this);
         _removeJobError = false;
 
-        // Make sure that if there is a "hole" and then a few more chunks, on the server
-        // we should remove the later chunks. Otherwise when we do dynamic chunk sizing, we may end up
-        // with corruptions if there are too many chunks, or if we abort and there are still stale chunks.
+        // Chunks that don't fit into a range that still needs uploading (for example
+        // because they overlap with another chunk) must be removed. Otherwise we may end up
+        // with corruptions when the server assembles the file.
         for (auto it = _serverChunks.begin(); it != _serverChunks.end(); ++it) {
             auto job = new DeleteJob(propagator()->account(), propagator()->account()->url(), chunkPath() + QLatin1Char('/') + it->originalName, this);
             addChildJob(job);
@@ -299,7 +376,7 @@ void PropagateUploadFileNG::startNewUpload()
     pi._contentChecksum = _item->_checksumHeader;
     pi._size = _item->_size;
     propagator()->_journal->setUploadInfo(_item->_file, pi);
-    propagator()->_journal->commit(QStringLiteral("Upload info"));
+    propagator()->_journal->commitOrDefer(QStringLiteral("Upload info"));
     QMap<QByteArray, QByteArray> headers;
     headers["OC-Total-Length"] = QByteArray::number(_item->_size);
     auto job = new MkColJob(propagator()->account(), propagator()->account()->url(), chunkPath(), headers, this);
@@ -354,6 +431,9 @@ void PropagateUploadFileNG::doFinalMove()
     }
     headers[QByteArrayLiteral("OC-Total-Length")] = QByteArray::number(_bytesToUpload);
     headers[QByteArrayLiteral("OC-Total-File-Length")] = QByteArray::number(_item->_size);
+    if (_deltaSync) {
+        headers[QByteArrayLiteral("OC-Delta-Sync")] = QByteArrayLiteral("1");
+    }
 
     const QString source = chunkPath() + QStringLiteral("/.file");
 
@@ -388,15 +468,17 @@ void PropagateUploadFileNG::startNextChunk()
 
     // All ranges complete!
     if (_rangesToUpload.isEmpty()) {
-        doFinalMove();
+        // Wait for the remaining chunks to arrive before assembling the file
+        if (_runningChunks.isEmpty())
+            doFinalMove();
         return;
     }
 
-    _currentChunkOffset = _rangesToUpload.first().start;
-    _currentChunkSize = qMin(propagator()->_chunkSize, _rangesToUpload.first().size);
+    const qint64 chunkOffset = _rangesToUpload.first().start;
+    const qint64 chunkSize = qMin(propagator()->_chunkSize, _rangesToUpload.first().size);
 
     const QString fileName = propagator()->fullLocalPath(_item->_file);
-    auto device = std::make_unique<UploadDevice>(fileName, _currentChunkOffset, _currentChunkSize,
+    auto device = std::make_unique<UploadDevice>(fileName, chunkOffset, chunkSize,
         &propagator()->_bandwidthManager);
     if (!device->open(QIODevice::ReadOnly)) {
         qCWarning(lcPropagateUploadNG) << "Could not prepare upload device: " << device->errorString();
@@ -404,14 +486,16 @@ void PropagateUploadFileNG::startNextChunk()
         abortWithError(SyncFileItem::SoftError, device->errorString());
         return;
     }
+    markRangeAsDone(chunkOffset, chunkSize);
 
     QMap<QByteArray, QByteArray> headers;
-    headers["OC-Chunk-Offset"] = QByteArray::number(_currentChunkOffset);
+    headers["OC-Chunk-Offset"] = QByteArray::number(chunkOffset);
 
     // job takes ownership of device via a QScopedPointer. Job deletes itself when finishing
     auto devicePtr = device.get(); // for connections later
-    PUTFileJob *job = new PUTFileJob(propagator()->account(), propagator()->account()->url(), chunkPath(_currentChunkOffset), std::move(device), headers, 0, this);
+    PUTFileJob *job = new PUTFileJob(propagator()->account(), propagator()->account()->url(), chunkPath(chunkOffset), std::move(device), headers, 0, this);
     addChildJob(job);
+    _runningChunks.insert(job, { chunkOffset, chunkSize, 0 });
     connect(job, &PUTFileJob::finishedSignal, this, &PropagateUploadFileNG::slotPutFinished);
     connect(job, &PUTFileJob::uploadProgress,
         this, &PropagateUploadFileNG::slotUploadProgress);
@@ -419,6 +503,13 @@ void PropagateUploadFileNG::startNextChunk()
         devicePtr, &UploadDevice::slotJobUploadProgress);
     job->start();
     propagator()->_activeJobList.append(this);
+
+    // The chunks are addressed by their offset, so more of them can be sent
+    // while this one is in transit if the propagator has free slots.
+    if (!_rangesToUpload.isEmpty() && parallelChunkUploadEnabled()
+        && propagator()->_activeJobList.count() < propagator()->maximumActiveTransferJob()) {
+        startNextChunk();
+    }
 }
 
 void PropagateUploadFileNG::slotPutFinished()
@@ -444,9 +535,9 @@ void PropagateUploadFileNG::slotPutFinished()
         return;
     }
 
-    // Mark the range as uploaded
-    markRangeAsDone(_currentChunkOffset, _currentChunkSize);
-    _sent += _currentChunkSize;
+    // Mark the chunk as uploaded
+    const auto chunk = _runningChunks.take(job);
+    _sent += chunk.size;
 
     OC_ENFORCE_X(_sent <= _bytesToUpload, "can't send more than size");
 
@@ -457,7 +548,7 @@ void PropagateUploadFileNG::slotPutFinished()
     auto targetDuration = propagator()->syncOptions()._targetChunkUploadDuration;
     if (targetDuration.count() > 0) {
         auto uploadTime = ++job->msSinceStart(); // add one to avoid div-by-zero
-        qint64 predictedGoodSize = (_currentChunkSize * targetDuration) / uploadTime;
+        qint64 predictedGoodSize = (chunk.size * targetDuration) / uploadTime;
 
         // The whole targeting is heuristic. The predictedGoodSize will fluctuate
         // quite a bit because of external factors (like available bandwidth)
@@ -473,7 +564,7 @@ void PropagateUploadFileNG::slotPutFinished()
             targetSize,
             propagator()->syncOptions()._maxChunkSize);
 
-        qCInfo(lcPropagateUploadNG) << "Chunked upload of" << _currentChunkSize << "bytes took" << uploadTime.count()
+        qCInfo(lcPropagateUploadNG) << "Chunked upload of" << chunk.size << "bytes took" << uploadTime.count()
                                   << "ms, desired is" << targetDuration.count() << "ms, expected good chunk size is"
                                   << predictedGoodSize << "bytes and nudged next chunk size to "
                                   << propagator()->_chunkSize << "bytes";
@@ -512,7 +603,7 @@ void PropagateUploadFileNG::slotPutFinished()
         auto uploadInfo = propagator()->_journal->getUploadInfo(_item->_file);
         uploadInfo._errorCount = 0;
         propagator()->_journal->setUploadInfo(_item->_file, uploadInfo);
-        propagator()->_journal->commit(QStringLiteral("Upload info"));
+        propagator()->_journal->commitOrDefer(QStringLiteral("Upload info"));
     }
     startNextChunk();
 }
@@ -560,6 +651,17 @@ void PropagateUploadFileNG::slotMoveJobFinished()
         abortWithError(SyncFileItem::NormalError, tr("Missing ETag from server"));
         return;
     }
+
+    if (!_blockChecksums.isNull()) {
+        // Remember the blocks of this version for the next upload
+        SyncJournalDb::BlockChecksums checksums;
+        if (!FileSystem::fileChanged(propagator()->fullLocalPath(_item->_file), _item->_size, _item->_modtime)) {
+            checksums._blockSize = deltaSyncBlockSize;
+            checksums._etag = _item->_etag;
+            checksums._checksums = _blockChecksums;
+        }
+        propagator()->_journal->setBlockChecksums(_item->_file, checksums);
+    }
     finalize();
 }
 
@@ -572,7 +674,15 @@ void PropagateUploadFileNG::slotUploadProgress(qint64 sent, qint64 total)
     if (sent == 0 && total == 0) {
         return;
     }
-    propagator()->reportProgress(*_item, _sent + sent);
+    auto it = _runningChunks.find(qobject_cast<PUTFileJob *>(sender()));
+    if (it == _runningChunks.end())
+        return;
+    it->sent = sent;
+
+    qint64 inTransit = 0;
+    for (const auto &chunk : qAsConst(_runningChunks))
+        inTransit += chunk.sent;
+    propagator()->reportProgress(*_item, _sent + inTransit);
 }
 
 void PropagateUploadFileNG::abort(PropagatorJob::AbortType abortType)
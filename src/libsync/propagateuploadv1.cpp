@@ -78,7 +78,7 @@ void PropagateUploadFileV1::doStartUpload()
         pi._contentChecksum = _item->_checksumHeader;
         pi._size = _item->_size;
         propagator()->_journal->setUploadInfo(_item->_file, pi);
-        propagator()->_journal->commit(QStringLiteral("Upload info"));
+        propagator()->_journal->commitOrDefer(QStringLiteral("Upload info"));
     }
 
     _currentChunk = 0;
@@ -162,22 +162,7 @@ void PropagateUploadFileV1::startNextChunk()
     propagator()->_activeJobList.append(this);
     _currentChunk++;
 
-    bool parallelChunkUpload = true;
-
-    if (propagator()->account()->capabilities().chunkingParallelUploadDisabled()) {
-        // Server may also disable parallel chunked upload for any higher version
-        parallelChunkUpload = false;
-    } else {
-        static bool envEnabled = [] {
-            const auto env = qEnvironmentVariable("OWNCLOUD_PARALLEL_CHUNK");
-            if (!env.isEmpty()) {
-                return env != QLatin1String("false") && env != QLatin1String("0");
-            }
-            return true;
-        }();
-        parallelChunkUpload = envEnabled;
-    }
-
+    bool parallelChunkUpload = parallelChunkUploadEnabled();
 
     if (_currentChunk + _startChunk >= _chunkCount - 1) {
         // Don't do parallel upload of chunk if this might be the last chunk because the server cannot handle that
@@ -285,7 +270,7 @@ void PropagateUploadFileV1::slotPutFinished()
         pi._contentChecksum = _item->_checksumHeader;
         pi._size = _item->_size;
         propagator()->_journal->setUploadInfo(_item->_file, pi);
-        propagator()->_journal->commit(QStringLiteral("Upload info"));
+        propagator()->_journal->commitOrDefer(QStringLiteral("Upload info"));
         startNextChunk();
         return;
     }
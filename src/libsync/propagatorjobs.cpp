@@ -138,7 +138,7 @@ void PropagateLocalRemove::start()
     }
     propagator()->reportProgress(*_item, 0);
     propagator()->_journal->deleteFileRecord(_item->_originalFile, _item->isDirectory());
-    propagator()->_journal->commit(QStringLiteral("Local remove"));
+    propagator()->_journal->commitOrDefer(QStringLiteral("Local remove"));
     done(SyncFileItem::Success);
 }
 
@@ -198,7 +198,7 @@ void PropagateLocalMkdir::start()
         done(SyncFileItem::SoftError, tr("The file %1 is currently in use").arg(newItem._file));
         return;
     }
-    propagator()->_journal->commit(QStringLiteral("localMkdir"));
+    propagator()->_journal->commitOrDefer(QStringLiteral("localMkdir"));
 
     auto resultStatus = _item->_instruction == CSYNC_INSTRUCTION_CONFLICT
         ? SyncFileItem::Conflict
@@ -37,6 +37,7 @@
 
 #include <climits>
 #include <assert.h>
+#include <algorithm>
 #include <chrono>
 
 #include <QCoreApplication>
@@ -75,6 +76,14 @@ Q_LOGGING_CATEGORY(lcEngine, "sync.engine", QtInfoMsg)
  */
 static const std::chrono::milliseconds s_touchedFilesMaxAgeMs(3 * 1000);
 
+/** Budget of the journal write batches during propagation
+ *
+ * Updates are committed once this many are pending or the oldest is this old.
+ * A crash loses at most that much progress, the next sync redoes it.
+ */
+static const int journalWriteBatchSize = 500;
+static const std::chrono::milliseconds journalWriteBatchAge(2 * 1000);
+
 // doc in header
 std::chrono::milliseconds SyncEngine::minimumFileAgeForUpload(2000);
 
@@ -98,7 +107,7 @@ SyncEngine::SyncEngine(AccountPtr account, const QUrl &baseUrl, const QString &l
     qRegisterMetaType<SyncFileItemPtr>("SyncFileItemPtr");
     qRegisterMetaType<SyncFileItem::Status>("SyncFileItem::Status");
     qRegisterMetaType<SyncFileStatus>("SyncFileStatus");
-    qRegisterMetaType<SyncFileItemSet>("SyncFileItemSet");
+    qRegisterMetaType<SyncFileItemVector>("SyncFileItemVector");
     qRegisterMetaType<SyncFileItem::Direction>("SyncFileItem::Direction");
 
     // Everything in the SyncEngine expects a trailing slash for the localPath.
@@ -205,7 +214,7 @@ static bool isFileTransferInstruction(SyncInstructions instruction)
         || instruction == CSYNC_INSTRUCTION_TYPE_CHANGE;
 }
 
-void SyncEngine::deleteStaleDownloadInfos(const SyncFileItemSet &syncItems)
+void SyncEngine::deleteStaleDownloadInfos(const SyncFileItemVector &syncItems)
 {
     // Find all downloadinfo paths that we want to preserve.
     QSet<QString> download_file_paths;
@@ -227,7 +236,7 @@ void SyncEngine::deleteStaleDownloadInfos(const SyncFileItemSet &syncItems)
     }
 }
 
-void SyncEngine::deleteStaleUploadInfos(const SyncFileItemSet &syncItems)
+void SyncEngine::deleteStaleUploadInfos(const SyncFileItemVector &syncItems)
 {
     // Find all blacklisted paths that we want to preserve.
     QSet<QString> upload_file_paths;
@@ -252,7 +261,7 @@ void SyncEngine::deleteStaleUploadInfos(const SyncFileItemSet &syncItems)
     }
 }
 
-void SyncEngine::deleteStaleErrorBlacklistEntries(const SyncFileItemSet &syncItems)
+void SyncEngine::deleteStaleErrorBlacklistEntries(const SyncFileItemVector &syncItems)
 {
     // Find all blacklisted paths that we want to preserve.
     QSet<QString> blacklist_file_paths;
@@ -340,16 +349,8 @@ void OCC::SyncEngine::slotItemDiscovered(const OCC::SyncFileItemPtr &item)
     checkErrorBlacklisting(*item);
     _needsUpdate = true;
 
-    Q_ASSERT([&] {
-        const auto it = _syncItems.find(item);
-        if (it != _syncItems.cend()) {
-            const auto &item2 = it->get();
-            qCWarning(lcEngine) << "We already have an item for " << item2->_file << ":" << item2->_instruction << item2->_direction << "|" << item->_instruction << item->_direction;
-            return false;
-        }
-        return true;
-    }());
-    _syncItems.insert(item);
+    // Sorted once the discovery is done
+    _syncItems.push_back(item);
 
     slotNewItem(item);
 
@@ -568,6 +569,19 @@ void SyncEngine::slotDiscoveryFinished()
     _progressInfo->_status = ProgressInfo::Reconcile;
     emit transmissionProgress(*_progressInfo);
 
+    // Stable, so that like in the std::set we used before the first discovered item wins
+    std::stable_sort(_syncItems.begin(), _syncItems.end());
+    // The discovery should never produce two items for one destination, but if it does
+    // propagating both would be worse than dropping one
+    _syncItems.erase(std::unique(_syncItems.begin(), _syncItems.end(), [](const SyncFileItemPtr &item1, const SyncFileItemPtr &item2) {
+        if (item1->destination() != item2->destination()) {
+            return false;
+        }
+        qCWarning(lcEngine) << "We already have an item for " << item1->_file << ":" << item1->_instruction << item1->_direction << "|" << item2->_instruction << item2->_direction;
+        return true;
+    }),
+        _syncItems.end());
+
     //    qCInfo(lcEngine) << "Permissions of the root folder: " << _csync_ctx->remote.root_perms.toString();
     auto finish = [this]{
 
@@ -601,22 +615,10 @@ void SyncEngine::slotDiscoveryFinished()
                     } while (index > 0);
                 }
             }
-            //std::erase_if c++20
-            // https://en.cppreference.com/w/cpp/container/set/erase_if
-            const auto erase_if = [](auto &c, const auto &pred) {
-                auto old_size = c.size();
-                for (auto i = c.begin(), last = c.end(); i != last;) {
-                    if (pred(*i)) {
-                        i = c.erase(i);
-                    } else {
-                        ++i;
-                    }
-                }
-                return old_size - c.size();
-            };
-            erase_if(_syncItems, [&names](const SyncFileItemPtr &i) {
+            _syncItems.erase(std::remove_if(_syncItems.begin(), _syncItems.end(), [&names](const SyncFileItemPtr &i) {
                 return !names.contains(QStringRef { &i->_file });
-            });
+            }),
+                _syncItems.end());
         }
 
         qCInfo(lcEngine) << "#### Reconcile (aboutToPropagate) #################################################### " << _stopWatch.addLapTime(QStringLiteral("Reconcile (aboutToPropagate)")) << "ms";
@@ -674,6 +676,8 @@ void SyncEngine::slotDiscoveryFinished()
         if (_needsUpdate)
             Q_EMIT started();
 
+        // The per item updates of the propagation are written in batches
+        _journal->enableWriteBatching(journalWriteBatchSize, journalWriteBatchAge);
         _propagator->start(std::move(_syncItems));
 
         qCInfo(lcEngine) << "#### Post-Reconcile end #################################################### " << _stopWatch.addLapTime(QStringLiteral("Post-Reconcile Finished")) << "ms";
@@ -748,6 +752,14 @@ void SyncEngine::slotPropagationFinished(bool success)
         _anotherSyncNeeded = ImmediateFollowUp;
     }
 
+    // The items of a batch that could not be written are missing in the journal: fail the sync so they are redone
+    const auto batchResult = _journal->disableWriteBatching();
+    if (!batchResult) {
+        qCWarning(lcEngine) << "Writing to the sync journal failed:" << batchResult.error();
+        Q_EMIT syncError(tr("Unable to write to the sync journal: %1").arg(batchResult.error()));
+        success = false;
+    }
+
     if (success && _discoveryPhase) {
         _journal->setDataFingerprint(_discoveryPhase->_dataFingerprint);
     }
@@ -772,6 +784,8 @@ void SyncEngine::finalize(bool success)
     qCInfo(lcEngine) << "Sync run took " << _stopWatch.addLapTime(QStringLiteral("Sync Finished")) << "ms";
     _stopWatch.stop();
 
+    _journal->disableWriteBatching();
+
     if (_discoveryPhase) {
         _discoveryPhase.take()->deleteLater();
     }
@@ -799,7 +813,7 @@ void SyncEngine::updateFileTotal(const SyncFileItem &item, qint64 newSize)
     _progressInfo->updateTotalsForFile(item, newSize);
     emit transmissionProgress(*_progressInfo);
 }
-void SyncEngine::restoreOldFiles(SyncFileItemSet &syncItems)
+void SyncEngine::restoreOldFiles(SyncFileItemVector &syncItems)
 {
     /* When the server is trying to send us lots of file in the past, this means that a backup
        was restored in the server.  In that case, we should not simply overwrite the newer file
@@ -152,7 +152,7 @@ signals:
     void rootEtag(const QByteArray &, const QDateTime &);
 
     // after the above signals. with the items that actually need propagating
-    void aboutToPropagate(const SyncFileItemSet &items);
+    void aboutToPropagate(const SyncFileItemVector &items);
 
     // after each item completed by a job (successful or not)
     void itemCompleted(const SyncFileItemPtr &);
@@ -220,13 +220,13 @@ private:
 
     // Cleans up unnecessary downloadinfo entries in the journal as well
     // as their temporary files.
-    void deleteStaleDownloadInfos(const SyncFileItemSet &syncItems);
+    void deleteStaleDownloadInfos(const SyncFileItemVector &syncItems);
 
     // Removes stale uploadinfos from the journal.
-    void deleteStaleUploadInfos(const SyncFileItemSet &syncItems);
+    void deleteStaleUploadInfos(const SyncFileItemVector &syncItems);
 
     // Removes stale error blacklist entries from the journal.
-    void deleteStaleErrorBlacklistEntries(const SyncFileItemSet &syncItems);
+    void deleteStaleErrorBlacklistEntries(const SyncFileItemVector &syncItems);
 
     // Removes stale and adds missing conflict records after sync
     void conflictRecordMaintenance();
@@ -235,7 +235,7 @@ private:
     void finalize(bool success);
 
     // Must only be acessed during update and reconcile
-    SyncFileItemSet _syncItems;
+    SyncFileItemVector _syncItems;
 
     AccountPtr _account;
     const QUrl _baseUrl;
@@ -261,13 +261,13 @@ private:
      * check if we are allowed to propagate everything, and if we are not, adjust the instructions
      * to recover
      */
-    void checkForPermission(SyncFileItemSet &syncItems);
+    void checkForPermission(SyncFileItemVector &syncItems);
     RemotePermissions getPermissions(const QString &file) const;
 
     /**
      * Instead of downloading files from the server, upload the files to the server
      */
-    void restoreOldFiles(SyncFileItemSet &syncItems);
+    void restoreOldFiles(SyncFileItemVector &syncItems);
 
     // true if there is at least one file which was not changed on the server
     bool _hasNoneFiles;
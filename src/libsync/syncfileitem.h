@@ -21,7 +21,7 @@
 #include <QMetaType>
 #include <QSharedPointer>
 
-#include <set>
+#include <vector>
 
 #include <common/utility.h>
 #include <csync.h>
@@ -173,7 +173,7 @@ public:
         return data1[prefixL] < data2[prefixL];
     }
 
-    QString destination() const
+    const QString &destination() const
     {
         if (!_renameTarget.isEmpty()) {
             return _renameTarget;
@@ -299,10 +299,17 @@ inline bool operator<(const SyncFileItemPtr &item1, const SyncFileItemPtr &item2
     return *item1 < *item2;
 }
 
-using SyncFileItemSet = std::set<SyncFileItemPtr>;
+/**
+ * The items of a sync, sorted by destination.
+ *
+ * The discovery appends the items and sorts them once when it is done.
+ * For millions of items that is far cheaper than keeping a tree with a
+ * node allocation per item balanced on every insertion.
+ */
+using SyncFileItemVector = std::vector<SyncFileItemPtr>;
 }
 
-Q_DECLARE_METATYPE(OCC::SyncFileItemSet)
+Q_DECLARE_METATYPE(OCC::SyncFileItemVector)
 Q_DECLARE_METATYPE(OCC::SyncFileItem)
 Q_DECLARE_METATYPE(OCC::SyncFileItemPtr)
 
@@ -20,14 +20,13 @@
 #include "common/asserts.h"
 #include "csync_exclude.h"
 
-#include <QFileInfo>
 #include <QLoggingCategory>
 
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcStatusTracker, "sync.statustracker", QtInfoMsg)
 
-bool SyncFileStatusTracker::PathComparator::operator()( const QString& lhs, const QString& rhs ) const
+bool SyncFileStatusTracker::PathComparator::operator()(QStringView lhs, QStringView rhs) const
 {
     // This will make sure that the std::map is ordered and queried case-insensitively on macOS and Windows.
     // we want don't want to pay for the runtime check on every comparison.
@@ -35,30 +34,167 @@ bool SyncFileStatusTracker::PathComparator::operator()( const QString& lhs, cons
     return lhs.compare(rhs, sensitivity) < 0;
 }
 
-SyncFileStatus::SyncFileStatusTag SyncFileStatusTracker::lookupProblem(const QString &pathToMatch, const SyncFileStatusTracker::ProblemsMap &problemMap)
+bool SyncFileStatusTracker::Node::isEmpty() const
 {
-    auto lower = problemMap.lower_bound(pathToMatch);
-    for (auto it = lower; it != problemMap.cend(); ++it) {
-        const QString &problemPath = it->first;
-        SyncFileStatus::SyncFileStatusTag severity = it->second;
-
-        if (problemPath.compare(pathToMatch, _caseSensitivity) == 0) {
-            return severity;
-        } else if (severity == SyncFileStatus::StatusError
-            && problemPath.startsWith(pathToMatch, _caseSensitivity)
-            && (pathToMatch.isEmpty() || problemPath.at(pathToMatch.size()) == QLatin1Char('/'))) {
-            return SyncFileStatus::StatusWarning;
-        } else if (!problemPath.startsWith(pathToMatch, _caseSensitivity)) {
-            // Starting at lower_bound we get the first path that is not smaller,
-            // since: "a/" < "a/aa" < "a/aa/aaa" < "a/ab/aba"
-            // If problemMap keys are ["a/aa/aaa", "a/ab/aba"] and pathToMatch == "a/aa",
-            // lower_bound(pathToMatch) will point to "a/aa/aaa", and the moment that
-            // problemPath.startsWith(pathToMatch) == false, we know that we've looked
-            // at everything that interest us.
-            break;
+    return children.empty() && !known && !dirty && !syncCount && problem == SyncFileStatus::StatusNone;
+}
+
+SyncFileStatusTracker::Node *SyncFileStatusTracker::findNode(QStringView relativePath, bool *belowExcluded)
+{
+    if (belowExcluded) {
+        *belowExcluded = false;
+    }
+    Node *node = &_root;
+    for (qsizetype start = 0; start < relativePath.size();) {
+        qsizetype end = relativePath.indexOf(QLatin1Char('/'), start);
+        if (end == -1) {
+            end = relativePath.size();
+        }
+        if (belowExcluded && node->problem == SyncFileStatus::StatusExcluded) {
+            *belowExcluded = true;
+        }
+        const auto it = node->children.find(relativePath.mid(start, end - start));
+        if (it == node->children.cend()) {
+            return nullptr;
+        }
+        node = it->second.get();
+        start = end + 1;
+    }
+    return node;
+}
+
+SyncFileStatusTracker::Node &SyncFileStatusTracker::createNode(QStringView relativePath)
+{
+    Node *node = &_root;
+    for (qsizetype start = 0; start < relativePath.size();) {
+        qsizetype end = relativePath.indexOf(QLatin1Char('/'), start);
+        if (end == -1) {
+            end = relativePath.size();
+        }
+        const auto name = relativePath.mid(start, end - start);
+        auto it = node->children.find(name);
+        if (it == node->children.cend()) {
+            auto child = std::make_unique<Node>();
+            child->parent = node;
+            it = node->children.emplace(name.toString(), std::move(child)).first;
+        }
+        node = it->second.get();
+        start = end + 1;
+    }
+    return *node;
+}
+
+void SyncFileStatusTracker::removeEmptyNodes(QStringView relativePath)
+{
+    // Walk back from the path to the root, a parent can only be empty if its child was
+    while (!relativePath.isEmpty()) {
+        Node *node = findNode(relativePath);
+        if (!node || !node->isEmpty()) {
+            return;
+        }
+        const qsizetype lastSlashIndex = relativePath.lastIndexOf(QLatin1Char('/'));
+        auto &siblings = node->parent->children;
+        siblings.erase(siblings.find(relativePath.mid(lastSlashIndex + 1)));
+        relativePath.truncate(qMax<qsizetype>(lastSlashIndex, 0));
+    }
+}
+
+template <typename F>
+void SyncFileStatusTracker::forEachNode(Node &node, QString &path, F &&f)
+{
+    f(node, path);
+    const auto size = path.size();
+    for (auto &child : node.children) {
+        if (size) {
+            path += QLatin1Char('/');
+        }
+        path += child.first;
+        forEachNode(*child.second, path, f);
+        path.truncate(size);
+    }
+}
+
+void SyncFileStatusTracker::setProblem(Node &node, SyncFileStatus::SyncFileStatusTag problem)
+{
+    const int errorDelta = (problem == SyncFileStatus::StatusError) - (node.problem == SyncFileStatus::StatusError);
+    node.problem = problem;
+    if (errorDelta) {
+        for (Node *parent = node.parent; parent; parent = parent->parent) {
+            parent->errorsBelow += errorDelta;
+        }
+    }
+}
+
+SyncFileStatus::SyncFileStatusTag SyncFileStatusTracker::lookupProblem(const Node *node) const
+{
+    if (!node) {
+        return SyncFileStatus::StatusNone;
+    }
+    if (node->problem != SyncFileStatus::StatusNone) {
+        return node->problem;
+    }
+    // Parent directories show a warning for an error child
+    return node->errorsBelow ? SyncFileStatus::StatusWarning : SyncFileStatus::StatusNone;
+}
+
+void SyncFileStatusTracker::loadDirectory(QStringView relativePath)
+{
+    Node &dir = createNode(relativePath);
+    if (dir.childrenLoaded) {
+        return;
+    }
+    // One query for the directory instead of a lookup for every status request
+    dir.childrenLoaded = _syncEngine->journal()->listFilesInPath(relativePath.toUtf8(), [this](const SyncJournalFileRecord &rec) {
+        auto &node = createNode(QString::fromUtf8(rec._path));
+        node.known = true;
+        node.shared = rec._remotePerm.hasPermission(RemotePermissions::IsShared);
+    });
+}
+
+void SyncFileStatusTracker::updateJournalState(const SyncFileItem &item)
+{
+    // Failed and ignored items leave the journal as it was
+    if ((item._status != SyncFileItem::Success && item._status != SyncFileItem::NoStatus
+            && item._status != SyncFileItem::Conflict && item._status != SyncFileItem::Restoration)
+        || item._instruction == CSYNC_INSTRUCTION_NONE
+        || item._instruction == CSYNC_INSTRUCTION_IGNORE
+        || item._instruction == CSYNC_INSTRUCTION_ERROR) {
+        return;
+    }
+    if (item._originalFile != item.destination()) {
+        forgetJournalState(item._originalFile);
+    }
+    if (item._instruction == CSYNC_INSTRUCTION_REMOVE) {
+        forgetJournalState(item.destination());
+        return;
+    }
+    auto &node = createNode(item.destination());
+    node.known = true;
+    node.shared = item._remotePerm.hasPermission(RemotePermissions::IsShared);
+}
+
+void SyncFileStatusTracker::forgetJournalState(const QString &relativePath)
+{
+    if (Node *node = findNode(relativePath)) {
+        // Removed directories are deleted from the journal with all their children
+        forgetJournalState(*node);
+        removeEmptyNodes(relativePath);
+    }
+}
+
+void SyncFileStatusTracker::forgetJournalState(Node &node)
+{
+    node.known = false;
+    node.shared = false;
+    node.childrenLoaded = false;
+    for (auto it = node.children.begin(); it != node.children.end();) {
+        forgetJournalState(*it->second);
+        if (it->second->isEmpty()) {
+            it = node.children.erase(it);
+        } else {
+            ++it;
         }
     }
-    return SyncFileStatus::StatusNone;
 }
 
 /**
@@ -91,12 +227,12 @@ static inline bool hasExcludedStatus(const SyncFileItem &item)
 
 SyncFileStatusTracker::SyncFileStatusTracker(SyncEngine *syncEngine)
     : _syncEngine(syncEngine)
-    , _caseSensitivity(Utility::fsCaseSensitivity())
 {
     connect(syncEngine, &SyncEngine::aboutToPropagate,
         this, &SyncFileStatusTracker::slotAboutToPropagate);
     connect(syncEngine, &SyncEngine::itemCompleted,
         this, &SyncFileStatusTracker::slotItemCompleted);
+    connect(syncEngine, &SyncEngine::started, this, &SyncFileStatusTracker::slotSyncStarted);
     connect(syncEngine, &SyncEngine::finished, this, &SyncFileStatusTracker::slotSyncFinished);
     connect(syncEngine, &SyncEngine::started, this, &SyncFileStatusTracker::slotSyncEngineRunningChanged);
     connect(syncEngine, &SyncEngine::finished, this, &SyncFileStatusTracker::slotSyncEngineRunningChanged);
@@ -111,37 +247,36 @@ SyncFileStatus SyncFileStatusTracker::fileStatus(const QString &relativePath)
         return resolveSyncAndErrorStatus(QString(), NotShared);
     }
 
-    const QString absolutePath = _syncEngine->localPath() + relativePath;
-
-    if (!QFileInfo::exists(absolutePath)) {
-        return SyncFileStatus(SyncFileStatus::StatusNone);
+    loadDirectory(QStringView(relativePath).left(qMax<qsizetype>(relativePath.lastIndexOf(QLatin1Char('/')), 0)));
+
+    bool belowExcluded;
+    const Node *node = findNode(relativePath, &belowExcluded);
+
+    // csync stops at excluded directories, their children are excluded as well.
+    // Paths that were never synced might be new files that are excluded, the
+    // SyncEngine won't notify us at all for those until the next sync, and
+    // never for CSYNC_FILE_SILENTLY_EXCLUDED and CSYNC_FILE_EXCLUDE_AND_REMOVE
+    // excludes. Only those are matched on the disk, where the exclude list
+    // can tell directories from files.
+    if (belowExcluded
+        || (node && node->problem == SyncFileStatus::StatusExcluded)
+        || ((!node || !node->known)
+            && _syncEngine->excludedFiles().isExcluded(_syncEngine->syncOptions()._vfs->underlyingFileName(_syncEngine->localPath() + relativePath),
+                _syncEngine->localPath(),
+                _syncEngine->ignoreHiddenFiles()))) {
+        return SyncFileStatus(SyncFileStatus::StatusExcluded);
     }
 
-    // The SyncEngine won't notify us at all for CSYNC_FILE_SILENTLY_EXCLUDED
-    // and CSYNC_FILE_EXCLUDE_AND_REMOVE excludes. Even though it's possible
-    // that the status of CSYNC_FILE_EXCLUDE_LIST excludes will change if the user
-    // update the exclude list at runtime and doing it statically here removes
-    // our ability to notify changes through the fileStatusChanged signal,
-    // it's an acceptable compromize to treat all exclude types the same.
-    // Update: This extra check shouldn't hurt even though silently excluded files
-    // are now available via slotAddSilentlyExcluded().
-    if (_syncEngine->excludedFiles().isExcluded(_syncEngine->syncOptions()._vfs->underlyingFileName(absolutePath),
-            _syncEngine->localPath(),
-            _syncEngine->ignoreHiddenFiles())) {
-        return SyncFileStatus(SyncFileStatus::StatusExcluded);
+    if (!node) {
+        // Neither synced nor touched
+        return SyncFileStatus(SyncFileStatus::StatusNone);
     }
 
-    if (_dirtyPaths.contains(relativePath))
+    if (node->dirty)
         return SyncFileStatus::StatusSync;
 
-    // First look it up in the database to know if it's shared
-    SyncJournalFileRecord rec;
-    if (_syncEngine->journal()->getFileRecord(relativePath, &rec) && rec.isValid()) {
-        return resolveSyncAndErrorStatus(relativePath, rec._remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared);
-    }
-
-    // Must be a new file not yet in the database, check if it's syncing or has an error.
-    return resolveSyncAndErrorStatus(relativePath, NotShared, PathUnknown);
+    // A new file not yet in the database is only shown while it's syncing or has an error.
+    return resolveSyncAndErrorStatus(relativePath, node->shared ? Shared : NotShared, node->known ? PathKnown : PathUnknown);
 }
 
 void SyncFileStatusTracker::slotPathTouched(const QString &fileName)
@@ -150,21 +285,21 @@ void SyncFileStatusTracker::slotPathTouched(const QString &fileName)
 
     OC_ASSERT(fileName.startsWith(folderPath));
     QString localPath = fileName.mid(folderPath.size());
-    _dirtyPaths.insert(localPath);
+    createNode(localPath).dirty = true;
 
     emit fileStatusChanged(fileName, SyncFileStatus::StatusSync);
 }
 
 void SyncFileStatusTracker::slotAddSilentlyExcluded(const QString &folderPath)
 {
-    _syncProblems[folderPath] = SyncFileStatus::StatusExcluded;
+    setProblem(createNode(folderPath), SyncFileStatus::StatusExcluded);
     emit fileStatusChanged(getSystemDestination(folderPath), resolveSyncAndErrorStatus(folderPath, NotShared));
 }
 
 void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
 {
-    // Will return 0 (and increase to 1) if the path wasn't in the map yet
-    int count = _syncCount[relativePath]++;
+    // Will be 0 (and increase to 1) if the path wasn't syncing yet
+    int count = createNode(relativePath).syncCount++;
     if (!count) {
         SyncFileStatus status = sharedFlag == UnknownShared
             ? fileStatus(relativePath)
@@ -184,15 +319,18 @@ void SyncFileStatusTracker::incSyncCountAndEmitStatusChanged(const QString &rela
 
 void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedFlag)
 {
-    int count = --_syncCount[relativePath];
+    Node *node = findNode(relativePath);
+    if (!node || !node->syncCount) {
+        // The counts were already cleared by slotSyncFinished
+        return;
+    }
+    int count = --node->syncCount;
     if (!count) {
-        // Remove from the map, same as 0
-        _syncCount.remove(relativePath);
-
         SyncFileStatus status = sharedFlag == UnknownShared
             ? fileStatus(relativePath)
             : resolveSyncAndErrorStatus(relativePath, sharedFlag);
         emit fileStatusChanged(getSystemDestination(relativePath), status);
+        removeEmptyNodes(relativePath);
 
         // We passed from SYNC to OK, decrement our parent.
         OC_ASSERT(!relativePath.endsWith(QLatin1Char('/')));
@@ -204,23 +342,34 @@ void SyncFileStatusTracker::decSyncCountAndEmitStatusChanged(const QString &rela
     }
 }
 
-void SyncFileStatusTracker::slotAboutToPropagate(const SyncFileItemSet &items)
+void SyncFileStatusTracker::slotAboutToPropagate(const SyncFileItemVector &items)
 {
-    OC_ASSERT(_syncCount.isEmpty());
-
-    ProblemsMap oldProblems;
-    std::swap(_syncProblems, oldProblems);
+    OC_ASSERT(!_root.syncCount);
+
+    // Start over with the problems of this sync
+    std::vector<std::pair<QString, SyncFileStatus::SyncFileStatusTag>> oldProblems;
+    QString path;
+    forEachNode(_root, path, [&](Node &node, const QString &nodePath) {
+        if (node.problem != SyncFileStatus::StatusNone) {
+            oldProblems.emplace_back(nodePath, node.problem);
+            setProblem(node, SyncFileStatus::StatusNone);
+        }
+    });
 
     for (const auto &item : qAsConst(items)) {
         qCDebug(lcStatusTracker) << "Investigating" << item->destination() << item->_status << item->_instruction;
-        _dirtyPaths.remove(item->destination());
-        _dirtyPaths.remove(item->_originalFile);
+        if (Node *node = findNode(item->destination())) {
+            node->dirty = false;
+        }
+        if (Node *node = findNode(item->_originalFile)) {
+            node->dirty = false;
+        }
 
         if (hasErrorStatus(*item)) {
-            _syncProblems[item->destination()] = SyncFileStatus::StatusError;
+            setProblem(createNode(item->destination()), SyncFileStatus::StatusError);
             invalidateParentPaths(item->destination());
         } else if (hasExcludedStatus(*item)) {
-            _syncProblems[item->destination()] = SyncFileStatus::StatusExcluded;
+            setProblem(createNode(item->destination()), SyncFileStatus::StatusExcluded);
         }
 
         SharedFlag sharedFlag = item->_remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared;
@@ -237,22 +386,31 @@ void SyncFileStatusTracker::slotAboutToPropagate(const SyncFileItemSet &items)
 
     // Some metadata status won't trigger files to be synced, make sure that we
     // push the OK status for dirty files that don't need to be propagated.
-    // Swap into a copy since fileStatus() reads _dirtyPaths to determine the status
-    QSet<QString> oldDirtyPaths;
-    std::swap(_dirtyPaths, oldDirtyPaths);
-    for (auto it = oldDirtyPaths.constBegin(); it != oldDirtyPaths.constEnd(); ++it)
-        emit fileStatusChanged(getSystemDestination(*it), fileStatus(*it));
+    // Clear them first since fileStatus() reads the dirty flag to determine the status
+    QStringList oldDirtyPaths;
+    forEachNode(_root, path, [&oldDirtyPaths](Node &node, const QString &nodePath) {
+        if (node.dirty) {
+            node.dirty = false;
+            oldDirtyPaths.append(nodePath);
+        }
+    });
+    for (const auto &dirtyPath : qAsConst(oldDirtyPaths)) {
+        emit fileStatusChanged(getSystemDestination(dirtyPath), fileStatus(dirtyPath));
+        removeEmptyNodes(dirtyPath);
+    }
 
     // Make sure to push any status that might have been resolved indirectly since the last sync
     // (like an error file being deleted from disk)
-    for (auto it = _syncProblems.begin(); it != _syncProblems.end(); ++it)
-        oldProblems.erase(it->first);
-    for (auto it = oldProblems.begin(); it != oldProblems.end(); ++it) {
-        const QString &path = it->first;
-        SyncFileStatus::SyncFileStatusTag severity = it->second;
-        if (severity == SyncFileStatus::StatusError)
-            invalidateParentPaths(path);
-        emit fileStatusChanged(getSystemDestination(path), fileStatus(path));
+    for (const auto &oldProblem : oldProblems) {
+        const QString &problemPath = oldProblem.first;
+        const Node *node = findNode(problemPath);
+        if (node && node->problem != SyncFileStatus::StatusNone) {
+            continue;
+        }
+        if (oldProblem.second == SyncFileStatus::StatusError)
+            invalidateParentPaths(problemPath);
+        emit fileStatusChanged(getSystemDestination(problemPath), fileStatus(problemPath));
+        removeEmptyNodes(problemPath);
     }
 }
 
@@ -261,14 +419,17 @@ void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
     qCDebug(lcStatusTracker) << "Item completed" << item->destination() << item->_status << item->_instruction;
 
     if (hasErrorStatus(*item)) {
-        _syncProblems[item->destination()] = SyncFileStatus::StatusError;
+        setProblem(createNode(item->destination()), SyncFileStatus::StatusError);
         invalidateParentPaths(item->destination());
     } else if (hasExcludedStatus(*item)) {
-        _syncProblems[item->destination()] = SyncFileStatus::StatusExcluded;
-    } else {
-        _syncProblems.erase(item->destination());
+        setProblem(createNode(item->destination()), SyncFileStatus::StatusExcluded);
+    } else if (Node *node = findNode(item->destination())) {
+        setProblem(*node, SyncFileStatus::StatusNone);
     }
 
+    // Keep the index in line with the records the propagation wrote or removed
+    updateJournalState(*item);
+
     SharedFlag sharedFlag = item->_remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared;
     if (item->_instruction != CSYNC_INSTRUCTION_NONE
         && item->_instruction != CSYNC_INSTRUCTION_UPDATE_METADATA
@@ -278,16 +439,32 @@ void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
         decSyncCountAndEmitStatusChanged(item->destination(), sharedFlag);
     } else {
         emit fileStatusChanged(getSystemDestination(item->destination()), resolveSyncAndErrorStatus(item->destination(), sharedFlag));
+        removeEmptyNodes(item->destination());
     }
 }
 
+void SyncFileStatusTracker::slotSyncStarted()
+{
+    // The journal might have changed without a sync, e.g. records removed
+    // for selective sync, read it again when a status is requested
+    forgetJournalState(_root);
+}
+
 void SyncFileStatusTracker::slotSyncFinished()
 {
     // Clear the sync counts to reduce the impact of unsymetrical inc/dec calls (e.g. when directory job abort)
-    QHash<QString, int> oldSyncCount;
-    std::swap(_syncCount, oldSyncCount);
-    for (auto it = oldSyncCount.begin(); it != oldSyncCount.end(); ++it)
-        emit fileStatusChanged(getSystemDestination(it.key()), fileStatus(it.key()));
+    QStringList oldSyncPaths;
+    QString path;
+    forEachNode(_root, path, [&oldSyncPaths](Node &node, const QString &nodePath) {
+        if (node.syncCount) {
+            node.syncCount = 0;
+            oldSyncPaths.append(nodePath);
+        }
+    });
+    for (const auto &syncPath : qAsConst(oldSyncPaths)) {
+        emit fileStatusChanged(getSystemDestination(syncPath), fileStatus(syncPath));
+        removeEmptyNodes(syncPath);
+    }
 }
 
 void SyncFileStatusTracker::slotSyncEngineRunningChanged()
@@ -300,12 +477,13 @@ SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const QString &r
     // If it's a new file and that we're not syncing it yet,
     // don't show any icon and wait for the filesystem watcher to trigger a sync.
     SyncFileStatus status(isPathKnown ? SyncFileStatus::StatusUpToDate : SyncFileStatus::StatusNone);
-    if (_syncCount.value(relativePath)) {
+    const Node *node = findNode(relativePath);
+    if (node && node->syncCount) {
         status.set(SyncFileStatus::StatusSync);
     } else {
         // After a sync finished, we need to show the users issues from that last sync like the activity list does.
         // Also used for parent directories showing a warning for an error child.
-        SyncFileStatus::SyncFileStatusTag problemStatus = lookupProblem(relativePath, _syncProblems);
+        SyncFileStatus::SyncFileStatusTag problemStatus = lookupProblem(node);
         if (problemStatus != SyncFileStatus::StatusNone)
             status.set(problemStatus);
     }
@@ -20,7 +20,7 @@
 #include "syncfileitem.h"
 #include "common/syncfilestatus.h"
 #include <map>
-#include <QSet>
+#include <memory>
 
 namespace OCC {
 
@@ -30,6 +30,11 @@ class SyncEngine;
  * @brief Takes care of tracking the status of individual files as they
  *        go through the SyncEngine, to be reported as overlay icons in the shell.
  * @ingroup libsync
+ *
+ * The file manager asks for the status of every file it shows, so fileStatus()
+ * is answered from an index of the sync state kept in memory. The journal
+ * records of a directory are read into the index when the status of one of
+ * its children is first requested, and forgotten when a sync starts.
  */
 class OWNCLOUDSYNC_EXPORT SyncFileStatusTracker : public QObject
 {
@@ -47,17 +52,61 @@ signals:
     void fileStatusChanged(const QString &systemFileName, SyncFileStatus fileStatus);
 
 private slots:
-    void slotAboutToPropagate(const SyncFileItemSet &items);
+    void slotAboutToPropagate(const SyncFileItemVector &items);
     void slotItemCompleted(const SyncFileItemPtr &item);
+    void slotSyncStarted();
     void slotSyncFinished();
     void slotSyncEngineRunningChanged();
 
 private:
     struct PathComparator {
-        bool operator()( const QString& lhs, const QString& rhs ) const;
+        using is_transparent = void;
+        bool operator()(QStringView lhs, QStringView rhs) const;
+    };
+
+    /**
+     * A path of the sync folder in the in-memory index of the sync state.
+     *
+     * Every path that has a record in the journal, or that is dirty, syncing,
+     * excluded or failed has a node. A directory counts the errors below it,
+     * so its warning status doesn't need a look at its children.
+     */
+    struct Node
+    {
+        Node *parent = nullptr;
+        std::map<QString, std::unique_ptr<Node>, PathComparator> children;
+        // The path has a record in the journal
+        bool known = false;
+        bool shared = false;
+        // The journal records of the children were read into the index
+        bool childrenLoaded = false;
+        // Touched by the file system watcher since the last sync
+        bool dirty = false;
+        // Counts the number direct children currently being synced (has unfinished propagation jobs).
+        // We'll show a file/directory as SYNC as long as its sync count is > 0.
+        // A directory that starts/ends propagation will in turn increase/decrease its own parent by 1.
+        int syncCount = 0;
+        // StatusError or StatusExcluded if the last sync had a problem with the path
+        SyncFileStatus::SyncFileStatusTag problem = SyncFileStatus::StatusNone;
+        // The number of paths below this one that have an error
+        int errorsBelow = 0;
+
+        bool isEmpty() const;
     };
-    typedef std::map<QString, SyncFileStatus::SyncFileStatusTag, PathComparator> ProblemsMap;
-    SyncFileStatus::SyncFileStatusTag lookupProblem(const QString &pathToMatch, const ProblemsMap &problemMap);
+
+    Node *findNode(QStringView relativePath, bool *belowExcluded = nullptr);
+    Node &createNode(QStringView relativePath);
+    void removeEmptyNodes(QStringView relativePath);
+    template <typename F>
+    void forEachNode(Node &node, QString &path, F &&f);
+
+    void setProblem(Node &node, SyncFileStatus::SyncFileStatusTag problem);
+    SyncFileStatus::SyncFileStatusTag lookupProblem(const Node *node) const;
+
+    void loadDirectory(QStringView relativePath);
+    void updateJournalState(const SyncFileItem &item);
+    void forgetJournalState(const QString &relativePath);
+    void forgetJournalState(Node &node);
 
     enum SharedFlag { UnknownShared,
         NotShared,
@@ -73,15 +122,8 @@ private:
 
     SyncEngine *_syncEngine;
 
-    ProblemsMap _syncProblems;
-    QSet<QString> _dirtyPaths;
-    // Counts the number direct children currently being synced (has unfinished propagation jobs).
-    // We'll show a file/directory as SYNC as long as its sync count is > 0.
-    // A directory that starts/ends propagation will in turn increase/decrease its own parent by 1.
-    QHash<QString, int> _syncCount;
-
-    // case sensitivity used for path comparisons
-    Qt::CaseSensitivity _caseSensitivity;
+    // The sync folder itself
+    Node _root;
 };
 }
 
@@ -49,6 +49,27 @@ void SyncOptions::fillFromEnvironmentVariables()
     int maxParallel = qEnvironmentVariableIntValue("OWNCLOUD_MAX_PARALLEL");
     if (maxParallel > 0)
         _parallelNetworkJobs = maxParallel;
+
+    int maxParallelLocalDiscovery = qEnvironmentVariableIntValue("OWNCLOUD_MAX_PARALLEL_LOCAL_DISCOVERY");
+    if (maxParallelLocalDiscovery > 0)
+        _parallelLocalDiscoveryJobs = maxParallelLocalDiscovery;
+
+    bool downloadBufferSizeOk = false;
+    const qint64 downloadBufferSize = qgetenv("OWNCLOUD_DOWNLOAD_BUFFER_SIZE").toLongLong(&downloadBufferSizeOk);
+    if (downloadBufferSizeOk)
+        _downloadBufferSize = qMax<qint64>(16 * 1024, downloadBufferSize); // same lower bound as ConfigFile
+
+    QByteArray contentChecksumMaxSizeEnv = qgetenv("OWNCLOUD_CONTENT_CHECKSUM_MAX_SIZE");
+    if (!contentChecksumMaxSizeEnv.isEmpty())
+        _contentChecksumMaxSize = contentChecksumMaxSizeEnv.toLongLong();
+
+    QByteArray downloadRangeSizeEnv = qgetenv("OWNCLOUD_DOWNLOAD_RANGE_SIZE");
+    if (!downloadRangeSizeEnv.isEmpty())
+        _downloadRangeSize = downloadRangeSizeEnv.toLongLong();
+
+    QByteArray downloadCacheBypassSizeEnv = qgetenv("OWNCLOUD_DOWNLOAD_CACHE_BYPASS_SIZE");
+    if (!downloadCacheBypassSizeEnv.isEmpty())
+        _downloadCacheBypassSize = downloadCacheBypassSizeEnv.toLongLong();
 }
 
 void SyncOptions::verifyChunkSizes()
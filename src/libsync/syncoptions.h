@@ -73,10 +73,49 @@ public:
     /** The maximum number of active jobs in parallel  */
     int _parallelNetworkJobs = 6;
 
+    /** The maximum number of local directories listed in parallel during discovery */
+    int _parallelLocalDiscoveryJobs = 8;
+
+    /** The size in bytes of the buffer used to write downloaded data to disk */
+    qint64 _downloadBufferSize = 1024 * 1024; // 1MiB
+
+    /** Files up to this size in bytes are hashed during discovery when their
+     * mtime changed but their size didn't. If the content checksum matches
+     * the one in the journal only the metadata is updated instead of
+     * uploading the file again.
+     *
+     * 0 disables it for all but .eml files (the default).
+     */
+    qint64 _contentChecksumMaxSize = 0;
+
+    /** Files larger than this are downloaded in ranges of this size in bytes,
+     * which are fetched, retried and resumed on their own.
+     *
+     * 0 downloads all files with a single GET.
+     */
+    qint64 _downloadRangeSize = 64 * 1024 * 1024; // 64MiB
+
+    /** Downloads of files larger than this are dropped from the page cache
+     * as they are written, so they don't push out the data of other programs.
+     *
+     * 0 keeps all downloads in the cache.
+     */
+    qint64 _downloadCacheBypassSize = 0;
+
+    /** Whether only the changed blocks of modified files are uploaded
+     * if the server supports it, see PropagateUploadFileNG.
+     */
+    bool _deltaSyncEnabled = false;
+
+    /** The minimum size in bytes of files that are uploaded with delta sync */
+    qint64 _deltaSyncMinFileSize = 10 * 1000 * 1000; // 10MB
+
     /** Reads settings from env vars where available.
      *
      * Currently reads _initialChunkSize, _minChunkSize, _maxChunkSize,
-     * _targetChunkUploadDuration, _parallelNetworkJobs.
+     * _targetChunkUploadDuration, _parallelNetworkJobs, _parallelLocalDiscoveryJobs,
+     * _downloadBufferSize, _contentChecksumMaxSize, _downloadRangeSize,
+     * _downloadCacheBypassSize.
      */
     void fillFromEnvironmentVariables();
 
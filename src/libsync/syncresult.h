@@ -89,7 +89,7 @@ public:
 
 private:
     Status _status = Undefined;
-    SyncFileItemSet _syncItems;
+    SyncFileItemVector _syncItems;
     QDateTime _syncTime;
     /**
      * when the sync tool support this...
@@ -0,0 +1,107 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "transferconcurrency.h"
+
+#include <QLoggingCategory>
+#include <QNetworkReply>
+
+#include <algorithm>
+
+using namespace std::chrono;
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcTransferConcurrency, "sync.transferconcurrency", QtInfoMsg)
+
+namespace {
+// More parallelism has to gain at least that much throughput to be kept raising
+constexpr double minimumThroughputGain = 1.05;
+// Responses that take this much longer than the base latency indicate congestion
+constexpr int latencyInflationFactor = 2;
+// ... but only if they are also slower by this absolute amount, to ignore jitter on fast links
+constexpr milliseconds minimumLatencyInflation { 200 };
+}
+
+void TransferConcurrency::setMaximumLimit(int maximum)
+{
+    _maximumLimit = std::max(1, maximum);
+    _limit = std::min(_limit, _maximumLimit);
+}
+
+void TransferConcurrency::addTransferredBytes(qint64 bytes, Clock::time_point now)
+{
+    if (_windowStart == Clock::time_point()) {
+        _windowStart = now;
+    }
+    _windowBytes += bytes;
+    if (now - _windowStart >= measuringWindow) {
+        evaluate(now);
+    }
+}
+
+void TransferConcurrency::addResponseLatency(milliseconds latency)
+{
+    _windowLatency += latency;
+    _windowLatencySamples++;
+}
+
+void TransferConcurrency::addFinishedRequest(QNetworkReply *reply, bool timedOut)
+{
+    const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (timedOut || httpStatus == 429 || httpStatus == 503
+        || reply->error() == QNetworkReply::RemoteHostClosedError
+        || reply->error() == QNetworkReply::TimeoutError) {
+        addCongestion();
+    }
+}
+
+void TransferConcurrency::evaluate(Clock::time_point now)
+{
+    const double throughput = _windowBytes / duration<double>(now - _windowStart).count();
+    const int oldLimit = _limit;
+
+    const auto latency = _windowLatencySamples > 0 ? _windowLatency / _windowLatencySamples : milliseconds(0);
+    bool latencyInflated = false;
+    if (_windowLatencySamples > 0) {
+        latencyInflated = _baseLatency.count() > 0
+            && latency > latencyInflationFactor * _baseLatency
+            && latency - _baseLatency > minimumLatencyInflation;
+        // Let the base drift upwards so a permanently slower link doesn't count as congested forever
+        _baseLatency = _baseLatency.count() > 0 ? std::min(latency, _baseLatency + _baseLatency / 8) : latency;
+    }
+
+    if (_windowCongested || latencyInflated) {
+        _limit = std::max(1, _limit / 2);
+    } else if (_windowBytes > 0 && _windowActiveTransfers >= _limit && throughput > _lastThroughput * minimumThroughputGain) {
+        // More slots only help if the current ones are all in use
+        _limit = std::min(_maximumLimit, _limit + 1);
+    }
+
+    if (_limit != oldLimit) {
+        qCInfo(lcTransferConcurrency) << "Changed transfer limit from" << oldLimit << "to" << _limit
+                                      << "throughput:" << qint64(throughput) << "B/s, previously" << qint64(_lastThroughput)
+                                      << "latency:" << latency.count() << "ms, base" << _baseLatency.count()
+                                      << "congested:" << _windowCongested;
+    }
+
+    if (_windowBytes > 0) {
+        _lastThroughput = throughput;
+    }
+    _windowStart = now;
+    _windowBytes = 0;
+    _windowLatency = milliseconds(0);
+    _windowLatencySamples = 0;
+    _windowActiveTransfers = 0;
+    _windowCongested = false;
+}
+}
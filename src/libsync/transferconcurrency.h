@@ -0,0 +1,92 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+#pragma once
+
+#include "owncloudlib.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <chrono>
+
+class QNetworkReply;
+
+namespace OCC {
+
+/**
+ * @brief Adapts the number of parallel transfers of an account to the network
+ * @ingroup libsync
+ *
+ * The throughput of all uploads and downloads of the account is measured in
+ * windows of measuringWindow. As long as the throughput still grows and the
+ * transfers used all the slots of the limit, it is raised by one after each
+ * window (additive increase), up to maximumLimit(). When the server takes
+ * much longer to respond than before, or requests time out or get rejected as
+ * overloaded, the limit is halved (multiplicative decrease).
+ *
+ * Only used from the main thread.
+ */
+class OWNCLOUDSYNC_EXPORT TransferConcurrency
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int initialLimit = 3;
+    static constexpr int defaultMaximumLimit = 16;
+    static constexpr std::chrono::milliseconds measuringWindow { 3000 };
+
+    /** The number of transfers that should run in parallel */
+    int limit() const { return _limit; }
+
+    /** The most transfers that can actually run, e.g. the configured parallel jobs */
+    int maximumLimit() const { return _maximumLimit; }
+    void setMaximumLimit(int maximum);
+
+    /** The number of transfers currently running, the limit only grows while it is used up */
+    void addActiveTransfers(int count) { _windowActiveTransfers = std::max(_windowActiveTransfers, count); }
+
+    /** Bytes sent or received by any transfer of the account */
+    void addTransferredBytes(qint64 bytes, Clock::time_point now = Clock::now());
+
+    /** The time the server took to respond to a transfer request
+     *
+     * For downloads that is the time until the headers arrived, for
+     * uploads the time between sending the last byte and the reply.
+     */
+    void addResponseLatency(std::chrono::milliseconds latency);
+
+    /** Checks a finished transfer request for signs of congestion */
+    void addFinishedRequest(QNetworkReply *reply, bool timedOut);
+
+    /** A transfer failed in a way that suggests too much parallelism */
+    void addCongestion() { _windowCongested = true; }
+
+private:
+    void evaluate(Clock::time_point now);
+
+    int _limit = initialLimit;
+    int _maximumLimit = defaultMaximumLimit;
+
+    Clock::time_point _windowStart;
+    qint64 _windowBytes = 0;
+    std::chrono::milliseconds _windowLatency { 0 };
+    int _windowLatencySamples = 0;
+    /// The most transfers that ran at once
+    int _windowActiveTransfers = 0;
+    bool _windowCongested = false;
+
+    /// Bytes per second in the last window that had transfers
+    double _lastThroughput = 0;
+    /// The lowest average latency of a window, slowly drifts upwards
+    std::chrono::milliseconds _baseLatency { 0 };
+};
+}
@@ -0,0 +1,186 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "testutils/syncenginetestutils.h"
+#include "testutils/testutils.h"
+
+#include <syncengine.h>
+
+#include <QtTest>
+
+using namespace OCC;
+
+namespace {
+QVariantMap bulkUploadCapabilities()
+{
+    auto cap = TestUtils::testCapabilities();
+    cap.insert(QStringLiteral("dav"),
+        QVariantMap { { QStringLiteral("chunking"), QStringLiteral("1.0") }, { QStringLiteral("bulk_upload"), QVariantMap { { QStringLiteral("version"), QStringLiteral("1.0") } } } });
+    return cap;
+}
+
+struct RequestCounter
+{
+    int bulkUploads = 0;
+    int puts = 0;
+
+    FakeAM::Override override(int bulkUploadError = 0)
+    {
+        return [this, bulkUploadError](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.url().path() == sBulkUploadUrl.path()) {
+                ++bulkUploads;
+                if (bulkUploadError != 0) {
+                    return new FakeErrorReply(op, request, nullptr, bulkUploadError);
+                }
+            } else if (op == QNetworkAccessManager::PutOperation) {
+                ++puts;
+            }
+            return nullptr;
+        };
+    }
+};
+}
+
+class TestBulkUpload : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testBulkUpload()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        fakeFolder.account()->setCapabilities(bulkUploadCapabilities());
+        RequestCounter counter;
+        fakeFolder.setServerOverride(counter.override());
+
+        for (int i = 0; i < 10; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("A/new%1").arg(i), 100 + i);
+        }
+        fakeFolder.localModifier().appendByte(QStringLiteral("A/a1"));
+        // Too large to be part of the batch
+        fakeFolder.localModifier().insert(QStringLiteral("A/big"), 200 * 1024);
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.bulkUploads, 1);
+        QCOMPARE(counter.puts, 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // The etags and file ids from the bulk response were stored
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.bulkUploads, 1);
+        QCOMPARE(counter.puts, 1);
+
+        // A single small file is sent on its own
+        fakeFolder.localModifier().insert(QStringLiteral("B/new"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.bulkUploads, 1);
+        QCOMPARE(counter.puts, 2);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testNoCapability()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        // The capability of a server with a different request format
+        auto cap = TestUtils::testCapabilities();
+        cap.insert(QStringLiteral("dav"), QVariantMap { { QStringLiteral("chunking"), QStringLiteral("1.0") }, { QStringLiteral("bulkupload"), QStringLiteral("1.0") } });
+        fakeFolder.account()->setCapabilities(cap);
+        RequestCounter counter;
+        fakeFolder.setServerOverride(counter.override());
+
+        for (int i = 0; i < 5; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("A/new%1").arg(i));
+        }
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.bulkUploads, 0);
+        QCOMPARE(counter.puts, 5);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    // The server rejects single files of the batch
+    void testItemError()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        fakeFolder.account()->setCapabilities(bulkUploadCapabilities());
+        RequestCounter counter;
+        fakeFolder.setServerOverride(counter.override());
+        ItemCompletedSpy completeSpy(fakeFolder);
+
+        for (int i = 0; i < 5; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("A/new%1").arg(i));
+        }
+        fakeFolder.serverErrorPaths().append(QStringLiteral("A/new2"), 403);
+
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(counter.bulkUploads, 1);
+        QCOMPARE(counter.puts, 0);
+        QCOMPARE(completeSpy.findItem(QStringLiteral("A/new2"))->_status, SyncFileItem::NormalError);
+        QCOMPARE(completeSpy.findItem(QStringLiteral("A/new2"))->_httpErrorCode, 403);
+        QVERIFY(!fakeFolder.currentRemoteState().find(QStringLiteral("A/new2")));
+        for (const auto &name : { QStringLiteral("A/new0"), QStringLiteral("A/new1"), QStringLiteral("A/new3"), QStringLiteral("A/new4") }) {
+            QCOMPARE(completeSpy.findItem(name)->_status, SyncFileItem::Success);
+            QVERIFY(fakeFolder.currentRemoteState().find(name));
+        }
+    }
+
+    // A batch is limited by the size of its files as well
+    void testMaximumBytes()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        fakeFolder.account()->setCapabilities(bulkUploadCapabilities());
+        RequestCounter counter;
+        fakeFolder.setServerOverride(counter.override());
+
+        for (int i = 0; i < 30; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("A/new%1").arg(i), 100 * 1024);
+        }
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.bulkUploads, 2);
+        QCOMPARE(counter.puts, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testFallback_data()
+    {
+        QTest::addColumn<int>("httpStatus");
+        QTest::newRow("not found") << 404;
+        QTest::newRow("too large") << 413;
+        QTest::newRow("server error") << 500;
+    }
+
+    // If the request fails as a whole, the files are uploaded one by one
+    void testFallback()
+    {
+        QFETCH(int, httpStatus);
+
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        fakeFolder.account()->setCapabilities(bulkUploadCapabilities());
+        RequestCounter counter;
+        fakeFolder.setServerOverride(counter.override(httpStatus));
+
+        for (int i = 0; i < 5; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("A/new%1").arg(i));
+        }
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.bulkUploads, 1);
+        QCOMPARE(counter.puts, 5);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // Next time the endpoint is tried again
+        for (int i = 0; i < 5; ++i) {
+            fakeFolder.localModifier().insert(QStringLiteral("B/new%1").arg(i));
+        }
+        fakeFolder.setServerOverride(counter.override());
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(counter.bulkUploads, 2);
+        QCOMPARE(counter.puts, 5);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestBulkUpload)
+#include "testbulkupload.moc"
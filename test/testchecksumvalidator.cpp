@@ -171,6 +171,46 @@ using namespace OCC::Utility;
         delete vali;
     }
 
+    void testComputeAllChecksums()
+    {
+        const QVector<CheckSums::Algorithm> types { CheckSums::Algorithm::MD5, CheckSums::Algorithm::SHA1, CheckSums::Algorithm::ADLER32 };
+        QVector<QByteArray> expected;
+        for (const auto type : types) {
+            expected.append(ComputeChecksum::computeNowOnFile(_testfile, type));
+            QVERIFY(!expected.last().isEmpty());
+        }
+
+        QFile file(_testfile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(ComputeChecksum::computeAllNow(&file, types), expected);
+        file.close();
+
+        // All of them are computed in one pass in a thread
+        auto vali = new ComputeChecksum(this);
+        vali->setChecksumTypes(types);
+        QVector<ChecksumHeader> result;
+        connect(vali, &ComputeChecksum::allDone, this, [&](const QVector<ChecksumHeader> &checksums) { result = checksums; });
+        vali->start(_testfile);
+
+        QEventLoop loop;
+        connect(vali, &ComputeChecksum::allDone, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+        loop.exec();
+
+        QCOMPARE(result.size(), types.size());
+        for (int i = 0; i < types.size(); ++i) {
+            QVERIFY(result.at(i).type() == types.at(i));
+            QCOMPARE(result.at(i).checksum(), expected.at(i));
+        }
+        delete vali;
+
+        // Empty files have no adler32 checksum, but the other ones
+        QBuffer empty;
+        QVERIFY(empty.open(QIODevice::ReadOnly));
+        const auto emptySums = ComputeChecksum::computeAllNow(&empty, types);
+        QCOMPARE(emptySums.at(0), QByteArray("d41d8cd98f00b204e9800998ecf8427e"));
+        QVERIFY(emptySums.at(2).isNull());
+    }
+
     void testDownloadChecksummingAdler() {
         ValidateChecksumHeader *vali = new ValidateChecksumHeader(this);
         connect(vali, &ValidateChecksumHeader::validated, this, &TestChecksumValidator::slotDownValidated);
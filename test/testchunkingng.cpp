@@ -7,6 +7,7 @@
 #include "testutils/syncenginetestutils.h"
 #include "testutils/testutils.h"
 
+#include <propagateupload.h>
 #include <syncengine.h>
 
 #include <QtTest>
@@ -78,6 +79,35 @@ private slots:
         QCOMPARE(fakeFolder.uploadState().children.count(), 2); // the transfer was done with chunking
     }
 
+    // Several chunks of the same file are in transit at once
+    void testParallelChunks()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        setChunkSize(fakeFolder.syncEngine(), 1 * 1000 * 1000);
+        const int size = 10 * 1000 * 1000; // 10 MB
+
+        int putsInTransit = 0;
+        int maxPutsInTransit = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation) {
+                auto reply = new FakePutReply(fakeFolder.uploadState(), op, request, outgoingData->readAll(), &fakeFolder.syncEngine());
+                maxPutsInTransit = std::max(maxPutsInTransit, ++putsInTransit);
+                QObject::connect(reply, &QNetworkReply::finished, &fakeFolder.syncEngine(), [&putsInTransit] { --putsInTransit; });
+                return reply;
+            }
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().insert(QStringLiteral("A/a0"), size);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->contentSize, size);
+
+        // Limited by OwncloudPropagator::maximumActiveTransferJob()
+        QVERIFY(maxPutsInTransit > 1);
+        QVERIFY(maxPutsInTransit <= 3);
+    }
+
     // Test resuming when there's a confusing chunk added
     void testResume1() {
         FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
@@ -126,21 +156,24 @@ private slots:
         QVERIFY(uploadedSize > 2 * 1000 * 1000); // at least 50 MB
         QVERIFY(chunkMap.size() >= 3); // at least three chunks
 
-        QStringList chunksToDelete;
-
-        // Remove the second chunk, so all further chunks will be deleted and resent
+        // Remove the second chunk, only that one needs to be resent: the chunks
+        // are addressed by their offset so the further chunks are reused
         auto firstChunk = chunkMap.first();
         auto secondChunk = *(chunkMap.begin() + 1);
+        QSet<qint64> reusedChunks;
         for (auto it = chunkMap.cbegin() + 2; it != chunkMap.cend(); ++it) {
-            chunksToDelete.append(it.key());
+            reusedChunks.insert(it.key().toLongLong());
         }
         fakeFolder.uploadState().children.first().remove(secondChunk.name);
 
         QStringList deletedPaths;
+        QSet<qint64> putOffsets;
         fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
             if (op == QNetworkAccessManager::PutOperation) {
                 // Test that we properly resuming, not resending the first chunk
-                Q_ASSERT(request.rawHeader("OC-Chunk-Offset").toLongLong() >= firstChunk.contentSize);
+                const auto offset = request.rawHeader("OC-Chunk-Offset").toLongLong();
+                Q_ASSERT(offset >= firstChunk.contentSize);
+                putOffsets.insert(offset);
             } else if (op == QNetworkAccessManager::DeleteOperation) {
                 deletedPaths.append(request.url().path());
             }
@@ -149,16 +182,9 @@ private slots:
 
         QVERIFY(fakeFolder.syncOnce());
 
-        for (const auto& toDelete : chunksToDelete) {
-            bool wasDeleted = false;
-            for (const auto& deleted : deletedPaths) {
-                if (deleted.mid(deleted.lastIndexOf('/') + 1) == toDelete) {
-                    wasDeleted = true;
-                    break;
-                }
-            }
-            QVERIFY(wasDeleted);
-        }
+        QVERIFY(deletedPaths.isEmpty());
+        QVERIFY(putOffsets.contains(secondChunk.name.toLongLong()));
+        QVERIFY(!putOffsets.intersects(reusedChunks));
 
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
         QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->contentSize, size);
@@ -266,7 +292,7 @@ private slots:
 
         // Now the next sync gets a NEW/NEW conflict and since there's no checksum
         // it just becomes a UPDATE_METADATA
-        auto checkIsUpdateMetaData = [&](const SyncFileItemSet &items) {
+        auto checkIsUpdateMetaData = [&](const SyncFileItemVector &items) {
             QCOMPARE(items.size(), 2);
             auto it = items.cbegin();
             QCOMPARE(it->get()->_file, QLatin1String("A"));
@@ -624,7 +650,61 @@ private slots:
         QCOMPARE(fakeFolder.currentRemoteState().find("A/a0")->contentSize, size + 1);
     }
 
+    // Only the changed blocks of a modified file are uploaded
+    void testDeltaSync()
+    {
+        FakeFolder fakeFolder { FileInfo::A12_B12_C12_S12() };
+        auto capabilities = TestUtils::testCapabilities();
+        capabilities.insert(QStringLiteral("dav"), QVariantMap { { QStringLiteral("chunking"), QStringLiteral("1.0") }, { QStringLiteral("deltasync"), true } });
+        fakeFolder.account()->setCapabilities(capabilities);
+        setChunkSize(fakeFolder.syncEngine(), 1 * 1000 * 1000);
+        SyncOptions options = fakeFolder.syncEngine().syncOptions();
+        options._deltaSyncEnabled = true;
+        options._deltaSyncMinFileSize = 0;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        const qint64 blockSize = PropagateUploadFileNG::deltaSyncBlockSize;
+        const qint64 size = 5 * blockSize + 100;
+        auto uploadedBytes = [&fakeFolder] {
+            qint64 bytes = 0;
+            for (const auto &transfer : qAsConst(fakeFolder.uploadState().children)) {
+                for (const auto &chunk : transfer.children) {
+                    bytes += chunk.contentSize;
+                }
+            }
+            return bytes;
+        };
+
+        // The first upload sends the whole file and remembers its blocks
+        fakeFolder.localModifier().insert(QStringLiteral("A/big"), size);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(uploadedBytes(), size);
+        QCOMPARE(fakeFolder.syncJournal().getBlockChecksums(QStringLiteral("A/big"))._checksums.size(),
+            6 * QCryptographicHash::hashLength(QCryptographicHash::Sha1));
 
+        // A change in the middle only sends its block
+        fakeFolder.localModifier().modifyByte(QStringLiteral("A/big"), 2 * blockSize + 10, 'Z');
+        fakeFolder.localModifier().setModTime(QStringLiteral("A/big"), QDateTime::currentDateTimeUtc().addDays(1));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(uploadedBytes(), size + blockSize);
+
+        // Appending only sends the last block
+        fakeFolder.localModifier().appendByte(QStringLiteral("A/big"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(uploadedBytes(), size + blockSize + 101);
+        QCOMPARE(fakeFolder.currentRemoteState().find(QStringLiteral("A/big"))->contentSize, size + 1);
+
+        // Without support of the server the whole file is sent
+        fakeFolder.account()->setCapabilities(TestUtils::testCapabilities());
+        fakeFolder.localModifier().modifyByte(QStringLiteral("A/big"), 10, 'Z');
+        fakeFolder.localModifier().setModTime(QStringLiteral("A/big"), QDateTime::currentDateTimeUtc().addDays(2));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(uploadedBytes(), size + blockSize + 101 + size + 1);
+    }
 };
 
 QTEST_GUILESS_MAIN(TestChunkingNG)
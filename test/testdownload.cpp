@@ -102,6 +102,116 @@ private slots:
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
 
+    void testRangedDownload()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().setIgnoreHiddenFiles(true);
+        auto opts = fakeFolder.syncEngine().syncOptions();
+        opts._downloadRangeSize = 1024 * 1024;
+        fakeFolder.syncEngine().setSyncOptions(opts);
+        const qint64 size = 5 * 1024 * 1024 + 512 * 1024;
+        const QByteArray lastRange = "bytes=" + QByteArray::number(5 * 1024 * 1024) + '-' + QByteArray::number(size - 1);
+
+        QList<QByteArray> ranges;
+        QByteArray failingRange;
+        int failures = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().contains(QLatin1String("A/big"))) {
+                ranges.append(request.rawHeader("Range"));
+                if (failures > 0 && request.rawHeader("Range") == failingRange) {
+                    --failures;
+                    return new FakeErrorReply(op, request, this, 500);
+                }
+            }
+            return nullptr;
+        });
+
+        // Every range has a GET of its own, a failed one is retried on its own
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big"), size);
+        failingRange = "bytes=" + QByteArray::number(1024 * 1024) + '-' + QByteArray::number(2 * 1024 * 1024 - 1);
+        failures = 1;
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(ranges.size(), 7);
+        QCOMPARE(ranges.count(failingRange), 2);
+        QVERIFY(ranges.contains(lastRange));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // If a range keeps failing, the next sync only fetches that one
+        ranges.clear();
+        fakeFolder.remoteModifier().appendByte(QStringLiteral("A/big"));
+        failingRange = "bytes=" + QByteArray::number(5 * 1024 * 1024) + '-' + QByteArray::number(size);
+        failures = 3;
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(ranges.count(failingRange), 3);
+        ranges.clear();
+        fakeFolder.syncJournal().wipeErrorBlacklist();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(ranges, QList<QByteArray>{ failingRange });
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // A server that ignores the ranges sends the whole file with a single GET
+        ranges.clear();
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation && request.url().path().contains(QLatin1String("A/big"))) {
+                ranges.append(request.rawHeader("Range"));
+                auto reply = new FakeGetReply(fakeFolder.remoteModifier(), op, request, this);
+                reply->rangeStart = -1;
+                return reply;
+            }
+            return nullptr;
+        });
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big2"), size);
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/big3"), size);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(ranges.count(QByteArray()), 2);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testRangedDownloadContent_data()
+    {
+        QTest::addColumn<qint64>("rangeSize");
+        QTest::addColumn<qint64>("cacheBypassSize");
+        QTest::addColumn<int>("expectedGets");
+
+        QTest::newRow("ranges") << qint64(64 * 1024) << qint64(0) << 16;
+        QTest::newRow("ranges, bypassing the cache") << qint64(64 * 1024) << qint64(1) << 16;
+        QTest::newRow("single GET, bypassing the cache") << qint64(0) << qint64(1) << 1;
+    }
+
+    // All ranges write to their own place of the shared temporary file
+    void testRangedDownloadContent()
+    {
+        QFETCH(qint64, rangeSize);
+        QFETCH(qint64, cacheBypassSize);
+        QFETCH(int, expectedGets);
+
+        FakeFolder fakeFolder{ FileInfo{} };
+        auto opts = fakeFolder.syncEngine().syncOptions();
+        opts._downloadRangeSize = rangeSize;
+        opts._downloadCacheBypassSize = cacheBypassSize;
+        fakeFolder.syncEngine().setSyncOptions(opts);
+
+        QByteArray data(1000 * 1000, Qt::Uninitialized);
+        for (int i = 0; i < data.size(); ++i) {
+            data[i] = char(i % 251);
+        }
+        int gets = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation) {
+                ++gets;
+                return new FakeGetWithDataReply(fakeFolder.remoteModifier(), data, op, request, this);
+            }
+            return nullptr;
+        });
+        fakeFolder.remoteModifier().insert(QStringLiteral("big"), data.size());
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(gets, expectedGets);
+
+        QFile file(fakeFolder.localPath() + QStringLiteral("big"));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), data);
+    }
+
     void testErrorMessage () {
         // This test's main goal is to test that the error string from the server is shown in the UI
 
@@ -258,6 +368,40 @@ private slots:
         QCOMPARE(getItem(completeSpy, "A/resendme")->_status, SyncFileItem::NormalError);
         QVERIFY(getItem(completeSpy, "A/resendme")->_errorString.contains(serverMessage));
     }
+
+    void testDownloadThroughput_data()
+    {
+        QTest::addColumn<qint64>("bufferSize");
+
+        QTest::newRow("8KiB") << qint64(8 * 1024);
+        QTest::newRow("1MiB") << qint64(1024 * 1024);
+    }
+
+    void testDownloadThroughput()
+    {
+        QFETCH(qint64, bufferSize);
+
+        FakeFolder fakeFolder{ FileInfo{} };
+        auto opts = fakeFolder.syncEngine().syncOptions();
+        opts._downloadBufferSize = bufferSize;
+        fakeFolder.syncEngine().setSyncOptions(opts);
+
+        // Large enough to dominate the per-sync overhead, small enough for the regular test run
+        const qint64 size = 8 * 1024 * 1024;
+        const QByteArray data(size, 'A');
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation)
+                return new FakeGetWithDataReply(fakeFolder.remoteModifier(), data, op, request, this);
+            return nullptr;
+        });
+
+        int i = 0;
+        QBENCHMARK {
+            fakeFolder.remoteModifier().insert(QStringLiteral("big%1").arg(i++), size, 'A');
+            QVERIFY(fakeFolder.syncOnce());
+        }
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestDownload)
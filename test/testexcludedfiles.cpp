@@ -126,10 +126,11 @@ private slots:
 
         QVERIFY(excludedFiles->_fullRegexFile.pattern().contains("csync1"));
         QVERIFY(excludedFiles->_fullTraversalRegexFile.pattern().contains("csync1"));
-        QVERIFY(!excludedFiles->_bnameTraversalRegexFile.pattern().contains("csync1"));
+        QCOMPARE(excludedFiles->_bnameTriggerFile.patterns(), QStringList{ QStringLiteral("*") });
+        QVERIFY(excludedFiles->_bnameExcludeFile.patterns().isEmpty());
 
         excludedFiles->addManualExclude(QStringLiteral("foo"));
-        QVERIFY(excludedFiles->_bnameTraversalRegexFile.pattern().contains("foo"));
+        QCOMPARE(excludedFiles->_bnameExcludeFile.patterns(), QStringList{ QStringLiteral("foo") });
         QVERIFY(excludedFiles->_fullRegexFile.pattern().contains("foo"));
         QVERIFY(!excludedFiles->_fullTraversalRegexFile.pattern().contains("foo"));
     }
@@ -619,6 +620,39 @@ private slots:
         }
     }
 
+    // Many patterns as in a large sync-exclude.lst, checked against a tree of typical paths
+    void check_csync_excluded_performance3()
+    {
+        setup_init();
+        for (int i = 0; i < 100; ++i) {
+            excludedFiles->addManualExclude(QStringLiteral("*.ext%1").arg(i));
+            excludedFiles->addManualExclude(QStringLiteral("cache%1").arg(i));
+            excludedFiles->addManualExclude(QStringLiteral("~tmp%1*").arg(i));
+        }
+        excludedFiles->addManualExclude(QStringLiteral("build/*.o"));
+        excludedFiles->addManualExclude(QStringLiteral("*.sw[px]"));
+
+        QStringList paths;
+        for (int dir = 0; dir < 20; ++dir) {
+            const auto dirPath = QStringLiteral("Documents/project%1/src").arg(dir);
+            paths.append(dirPath);
+            for (int file = 0; file < 50; ++file) {
+                paths.append(QStringLiteral("%1/file%2.cpp").arg(dirPath).arg(file));
+            }
+        }
+        paths.append(QStringLiteral("Documents/.file.swp"));
+        paths.append(QStringLiteral("Documents/cache42"));
+
+        int excluded = 0;
+        QBENCHMARK {
+            excluded = 0;
+            for (const auto &path : qAsConst(paths)) {
+                excluded += check_file_traversal(path) != CSYNC_NOT_EXCLUDED;
+            }
+        }
+        QCOMPARE(excluded, 2);
+    }
+
     void check_csync_exclude_expand_escapes()
     {
         extern void csync_exclude_expand_escapes(QByteArray &input);
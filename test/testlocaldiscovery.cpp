@@ -11,6 +11,9 @@
 #include <syncengine.h>
 #include <localdiscoverytracker.h>
 
+#include "csync/csync.h"
+#include "csync/vio/csync_vio_local.h"
+
 #include <QtTest>
 
 using namespace OCC;
@@ -187,6 +190,40 @@ private slots:
         QCOMPARE(fakeFolder.currentRemoteState(), expectedState);
     }
 
+    // Local listings of queued directories are prefetched on the discovery's own pool
+    void testLocalDiscoveryPool_data()
+    {
+        QTest::addColumn<int>("parallelLocalDiscoveryJobs");
+        QTest::newRow("single thread") << 1;
+        QTest::newRow("default") << SyncOptions()._parallelLocalDiscoveryJobs;
+    }
+
+    void testLocalDiscoveryPool()
+    {
+        QFETCH(int, parallelLocalDiscoveryJobs);
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._parallelLocalDiscoveryJobs = parallelLocalDiscoveryJobs;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // More directories than can be prefetched at once, a few levels deep
+        for (int i = 0; i < 50; ++i) {
+            const QString dir = QStringLiteral("A/dir%1").arg(i);
+            fakeFolder.localModifier().mkdir(dir);
+            fakeFolder.localModifier().mkdir(dir + QStringLiteral("/sub"));
+            fakeFolder.localModifier().insert(dir + QStringLiteral("/sub/file"), 10);
+        }
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        fakeFolder.localModifier().appendByte(QStringLiteral("A/dir42/sub/file"));
+        fakeFolder.localModifier().remove(QStringLiteral("A/dir7"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(!fakeFolder.currentRemoteState().find("A/dir7"));
+    }
+
     // Tests the behavior of invalid filename detection
     void testServerBlacklist()
     {
@@ -207,6 +244,74 @@ private slots:
         QVERIFY(!fakeFolder.currentRemoteState().find("C/.foo"));
         QVERIFY(!fakeFolder.currentRemoteState().find("C/bar"));
     }
+
+    void testReadDir()
+    {
+        auto tempDir = TestUtils::createTempDir();
+        QDir dir(tempDir.path());
+        QVERIFY(dir.mkdir(QStringLiteral("sub")));
+        // More entries than fit into one batch of the scanner
+        for (int i = 0; i < 3000; ++i) {
+            QFile f(dir.filePath(QStringLiteral("file_with_a_rather_long_name_%1").arg(i)));
+            QVERIFY(f.open(QFile::WriteOnly));
+            f.write(QByteArray(i % 7, 'x'));
+        }
+
+        auto dh = csync_vio_local_opendir(tempDir.path());
+        QVERIFY(dh);
+        QSet<QString> seen;
+        while (auto dirent = csync_vio_local_readdir(dh, nullptr)) {
+            QVERIFY(!seen.contains(dirent->path));
+            seen.insert(dirent->path);
+            if (dirent->path == QLatin1String("sub")) {
+                QCOMPARE(dirent->type, ItemTypeDirectory);
+            } else {
+                QCOMPARE(dirent->type, ItemTypeFile);
+                const int index = dirent->path.mid(dirent->path.lastIndexOf(QLatin1Char('_')) + 1).toInt();
+                QCOMPARE(dirent->size, static_cast<int64_t>(index % 7));
+            }
+            QVERIFY(dirent->inode != 0);
+            QVERIFY(dirent->modtime != 0);
+        }
+        QCOMPARE(csync_vio_local_closedir(dh), 0);
+        QCOMPARE(seen.size(), 3001);
+
+        QVERIFY(!csync_vio_local_opendir(tempDir.path() + QStringLiteral("/missing")));
+#ifndef Q_OS_WIN
+        QCOMPARE(errno, ENOENT);
+#endif
+    }
+
+    void testReadDirPerformance()
+    {
+        // A synthetic tree of 100 directories with 100 files each
+        auto tempDir = TestUtils::createTempDir();
+        QDir dir(tempDir.path());
+        for (int d = 0; d < 100; ++d) {
+            const QString sub = QStringLiteral("dir%1").arg(d);
+            QVERIFY(dir.mkdir(sub));
+            for (int i = 0; i < 100; ++i) {
+                QFile f(dir.filePath(sub + QStringLiteral("/file%1").arg(i)));
+                QVERIFY(f.open(QFile::WriteOnly));
+            }
+        }
+
+        QBENCHMARK {
+            int count = 0;
+            auto root = csync_vio_local_opendir(tempDir.path());
+            QVERIFY(root);
+            while (auto dirent = csync_vio_local_readdir(root, nullptr)) {
+                auto dh = csync_vio_local_opendir(tempDir.path() + QLatin1Char('/') + dirent->path);
+                QVERIFY(dh);
+                while (csync_vio_local_readdir(dh, nullptr)) {
+                    ++count;
+                }
+                csync_vio_local_closedir(dh);
+            }
+            csync_vio_local_closedir(root);
+            QCOMPARE(count, 100 * 100);
+        }
+    }
 };
 
 QTEST_GUILESS_MAIN(TestLocalDiscovery)
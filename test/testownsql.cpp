@@ -127,6 +127,31 @@ private slots:
         }
     }
 
+    void testBulkInsertPerformance()
+    {
+        SqlQuery create(_db);
+        create.prepare("CREATE TABLE IF NOT EXISTS bulk ( id INTEGER, name VARCHAR(4096), "
+                       "address VARCHAR(4096), entered INTEGER(8), flag INTEGER, PRIMARY KEY(id));");
+        QVERIFY(create.exec());
+
+        SqlQuery q(_db);
+        q.prepare("INSERT OR REPLACE INTO bulk (id, name, address, entered, flag) VALUES (?1, ?2, ?3, ?4, ?5);");
+        const QByteArray address = QByteArrayLiteral("some/rather/long/path/to/a/directory/in/the/sync/folder");
+        QBENCHMARK {
+            QVERIFY(_db.transaction());
+            for (int i = 0; i < 10000; ++i) {
+                q.reset_and_clear_bindings();
+                q.bindValue(1, i);
+                q.bindValue(2, QStringLiteral("Gonzo Alberto %1").arg(i));
+                q.bindValue(3, address);
+                q.bindValue(4, 1403100844ll + i);
+                q.bindValue(5, i % 2 == 0);
+                QVERIFY(q.exec());
+            }
+            QVERIFY(_db.commit());
+        }
+    }
+
     void testDestructor()
     {
         // This test make sure that the destructor of SqlQuery works even if the SqlDatabase
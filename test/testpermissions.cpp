@@ -42,7 +42,7 @@ static void assertCsyncJournalOk(SyncJournalDb &journal)
     journal.allowReopen();
 }
 
-SyncFileItemPtr findDiscoveryItem(const SyncFileItemSet &spy, const QString &path)
+SyncFileItemPtr findDiscoveryItem(const SyncFileItemVector &spy, const QString &path)
 {
     for (const auto &item : spy) {
         if (item->destination() == path)
@@ -58,7 +58,7 @@ bool itemInstruction(const ItemCompletedSpy &spy, const QString &path, const Syn
     return item->_instruction == instr;
 }
 
-bool discoveryInstruction(const SyncFileItemSet &spy, const QString &path, const SyncInstructions instr)
+bool discoveryInstruction(const SyncFileItemVector &spy, const QString &path, const SyncInstructions instr)
 {
     auto item = findDiscoveryItem(spy, path);
     return item->_instruction == instr;
@@ -408,7 +408,7 @@ private slots:
         lm.rename(QStringLiteral("zallowed/sub2"), QStringLiteral("nocreatedir/zsub2"));
 
         // also hook into discovery!!
-        SyncFileItemSet discovery;
+        SyncFileItemVector discovery;
         connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, this, [&discovery](auto v) { discovery = v; });
         ItemCompletedSpy completeSpy(fakeFolder);
         QVERIFY(!fakeFolder.syncOnce());
@@ -171,6 +171,90 @@ private slots:
         QVERIFY(completeSpy.findItem("nofileid")->_errorString.contains("file id"));
         QVERIFY(completeSpy.findItem("nopermissions/A")->_errorString.contains("permissions"));
     }
+
+    void testDepthInfinity_data()
+    {
+        QTest::addColumn<bool>("serverRefusesInfinity");
+
+        QTest::newRow("supported") << false;
+        QTest::newRow("refused") << true;
+    }
+
+    // If the server supports it, unknown subtrees are listed with a single PROPFIND
+    void testDepthInfinity()
+    {
+        QFETCH(bool, serverRefusesInfinity);
+
+        FakeFolder fakeFolder{ FileInfo() };
+        auto cap = TestUtils::testCapabilities();
+        cap.insert({ { "dav", QVariantMap { { "chunking", "1.0" }, { "propfind", QVariantMap { { "depth_infinity", true } } } } } });
+        fakeFolder.account()->setCapabilities(cap);
+
+        QStringList propfinds;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND") {
+                const auto depth = QString::fromUtf8(req.rawHeader("Depth"));
+                propfinds.append(getFilePathFromUrl(req.url()) + QLatin1Char(':') + depth);
+                if (serverRefusesInfinity && depth == QLatin1String("infinity"))
+                    return new FakeErrorReply(op, req, this, 403);
+            }
+            return nullptr;
+        });
+
+        // The initial sync lists everything at once
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/a1"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/B"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/B/b1"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A/B/C"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("D"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        if (serverRefusesInfinity) {
+            // Falls back to listing every directory on its own, without trying infinity again
+            propfinds.sort();
+            QCOMPARE(propfinds, QStringList({ QStringLiteral(":1"), QStringLiteral(":infinity"), QStringLiteral("A/B/C:1"),
+                                    QStringLiteral("A/B:1"), QStringLiteral("A:1"), QStringLiteral("D:1") }));
+        } else {
+            QCOMPARE(propfinds, QStringList({ QStringLiteral(":infinity") }));
+        }
+
+        // Afterwards only new remote directories are listed recursively
+        propfinds.clear();
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("E"));
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("E/F"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("E/F/f1"));
+        fakeFolder.remoteModifier().insert(QStringLiteral("A/B/b2"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(propfinds.contains(QStringLiteral("E:infinity")));
+        QCOMPARE(propfinds.contains(QStringLiteral("E/F:1")), serverRefusesInfinity);
+        QVERIFY(!propfinds.contains(QStringLiteral("E/F:infinity")));
+        QVERIFY(propfinds.contains(QStringLiteral("A/B:1")));
+        QVERIFY(!propfinds.contains(QStringLiteral(":infinity")));
+    }
+
+    // Only refusals of the recursive listing fall back to "Depth: 1", other errors are reported
+    void testDepthInfinityError()
+    {
+        FakeFolder fakeFolder{ FileInfo() };
+        auto cap = TestUtils::testCapabilities();
+        cap.insert({ { "dav", QVariantMap { { "chunking", "1.0" }, { "propfind", QVariantMap { { "depth_infinity", true } } } } } });
+        fakeFolder.account()->setCapabilities(cap);
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("A"));
+
+        int propfinds = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND") {
+                ++propfinds;
+                return new FakeErrorReply(op, req, this, 500);
+            }
+            return nullptr;
+        });
+
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(propfinds, 1);
+    }
 };
 
 QTEST_GUILESS_MAIN(TestRemoteDiscovery)
@@ -5,11 +5,13 @@
  *
  */
 
+#include <owncloudpropagator.h>
 #include <syncengine.h>
 
 #include "testutils/syncenginetestutils.h"
 #include "testutils/testutils.h"
 
+#include <QScopeGuard>
 #include <QtTest>
 
 using namespace std::chrono_literals;
@@ -157,6 +159,42 @@ private slots:
         QVERIFY(fakeFolder.currentLocalState().equals(fakeFolder.currentRemoteState(), FileInfo::IgnoreLastModified));
     }
 
+    void testContentChecksumMaxSize()
+    {
+        FakeFolder fakeFolder{FileInfo{}};
+        fakeFolder.account()->setCapabilities(TestUtils::testCapabilities(CheckSums::Algorithm::SHA1));
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._contentChecksumMaxSize = 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        fakeFolder.localModifier().insert(QStringLiteral("small.txt"), 64, 'A');
+        fakeFolder.localModifier().insert(QStringLiteral("changed.txt"), 64, 'A');
+        fakeFolder.localModifier().insert(QStringLiteral("large.bin"), 2000, 'A');
+        QVERIFY(fakeFolder.syncOnce());
+
+        // Make sure that the lastModified time caused by the setContent calls below is actually different:
+        QThread::sleep(1);
+
+        ItemCompletedSpy completeSpy(fakeFolder);
+        // Touch the files without changing the content
+        fakeFolder.localModifier().setContents(QStringLiteral("small.txt"), 'A');
+        fakeFolder.localModifier().setContents(QStringLiteral("large.bin"), 'A');
+        fakeFolder.localModifier().setContents(QStringLiteral("changed.txt"), 'B');
+        QVERIFY(fakeFolder.syncOnce());
+
+        // Only hashed up to the size limit
+        QVERIFY(!itemDidComplete(completeSpy, "small.txt"));
+        QVERIFY(itemDidCompleteSuccessfully(completeSpy, "large.bin"));
+        QVERIFY(itemDidCompleteSuccessfully(completeSpy, "changed.txt"));
+        QCOMPARE(fakeFolder.currentRemoteState().find("changed.txt")->contentChar, 'B');
+
+        // The new mtime was stored: no more checksum comparison needed
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("small.txt"), &record));
+        QCOMPARE(qint64(record._modtime), fakeFolder.currentLocalState().find("small.txt")->lastModifiedInSecondsUTC());
+        QVERIFY(fakeFolder.currentLocalState().equals(fakeFolder.currentRemoteState(), FileInfo::IgnoreLastModified));
+    }
+
     void testSelectiveSyncBug() {
         // issue owncloud/enterprise#1965: files from selective-sync ignored
         // folders are uploaded anyway is some circumstances.
@@ -414,7 +452,7 @@ private slots:
         fakeFolder.remoteModifier().appendByte(QStringLiteral("C/c1"));
         fakeFolder.remoteModifier().setModTime(QStringLiteral("C/c1"), changedMtime2);
 
-        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, [&](const SyncFileItemSet &items) {
+        connect(&fakeFolder.syncEngine(), &SyncEngine::aboutToPropagate, [&](const SyncFileItemVector &items) {
             SyncFileItemPtr a1, b1, c1;
             for (auto &item : items) {
                 if (item->_file == QLatin1String("A/a1"))
@@ -774,6 +812,53 @@ private slots:
 
         QCOMPARE(QFileInfo(fakeFolder.localPath() + "foo").lastModified(), datetime);
     }
+
+    // Folders syncing at the same time share the process-wide job limit
+    void testGlobalMaximumActiveJobs()
+    {
+        FakeFolder fakeFolder1{ FileInfo{} };
+        FakeFolder fakeFolder2{ FileInfo{} };
+        for (int i = 0; i < 10; ++i) {
+            fakeFolder1.remoteModifier().insert(QStringLiteral("a%1").arg(i));
+            fakeFolder2.remoteModifier().insert(QStringLiteral("b%1").arg(i));
+        }
+
+        QObject parent;
+        int runningGets = 0;
+        int maxRunningGets = 0;
+        auto makeOverride = [&](FakeFolder &fakeFolder) -> FakeAM::Override {
+            return [&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+                if (op == QNetworkAccessManager::GetOperation) {
+                    auto reply = new DelayedReply<FakeGetReply>(50ms, fakeFolder.remoteModifier(), op, request, &parent);
+                    maxRunningGets = qMax(maxRunningGets, ++runningGets);
+                    connect(reply, &QNetworkReply::finished, &parent, [&] { --runningGets; });
+                    return reply;
+                }
+                return nullptr;
+            };
+        };
+        fakeFolder1.setServerOverride(makeOverride(fakeFolder1));
+        fakeFolder2.setServerOverride(makeOverride(fakeFolder2));
+
+        const int oldMaximumActiveJobs = OwncloudPropagator::globalMaximumActiveJobs();
+        const auto restoreMaximumActiveJobs = qScopeGuard([oldMaximumActiveJobs] {
+            OwncloudPropagator::setGlobalMaximumActiveJobs(oldMaximumActiveJobs);
+        });
+        OwncloudPropagator::setGlobalMaximumActiveJobs(3);
+        QSignalSpy finished1(&fakeFolder1.syncEngine(), &SyncEngine::finished);
+        QSignalSpy finished2(&fakeFolder2.syncEngine(), &SyncEngine::finished);
+        fakeFolder1.scheduleSync();
+        fakeFolder2.scheduleSync();
+        QVERIFY(finished1.wait());
+        QVERIFY(!finished2.isEmpty() || finished2.wait());
+
+        QVERIFY(finished1[0][0].toBool());
+        QVERIFY(finished2[0][0].toBool());
+        QCOMPARE(fakeFolder1.currentLocalState(), fakeFolder1.currentRemoteState());
+        QCOMPARE(fakeFolder2.currentLocalState(), fakeFolder2.currentRemoteState());
+        QVERIFY(maxRunningGets > 1);
+        QVERIFY(maxRunningGets <= 3);
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncEngine)
@@ -8,6 +8,9 @@
 
 #include "syncfileitem.h"
 
+#include <algorithm>
+#include <random>
+
 using namespace OCC;
 
 class TestSyncFileItem : public QObject
@@ -63,6 +66,33 @@ private slots:
         QVERIFY(!(b < b));
         QVERIFY(!(c < c));
     }
+
+    // The discovery appends the items in any order and sorts them once
+    void testSortItems()
+    {
+        SyncFileItemVector items;
+        for (int dir = 0; dir < 100; ++dir) {
+            const QString dirName = QStringLiteral("dir%1").arg(dir);
+            items.push_back(SyncFileItemPtr::create(createItem(dirName)));
+            items.push_back(SyncFileItemPtr::create(createItem(dirName + QStringLiteral("-file"))));
+            for (int file = 0; file < 1000; ++file) {
+                items.push_back(SyncFileItemPtr::create(createItem(dirName + QStringLiteral("/file%1").arg(file))));
+            }
+        }
+        std::shuffle(items.begin(), items.end(), std::mt19937(42));
+
+        QBENCHMARK {
+            auto sorted = items;
+            std::sort(sorted.begin(), sorted.end());
+        }
+
+        std::sort(items.begin(), items.end());
+        QVERIFY(std::is_sorted(items.cbegin(), items.cend()));
+        // The contents of a directory directly follow it
+        QCOMPARE(items[0]->_file, QStringLiteral("dir0"));
+        QCOMPARE(items[1]->_file.section(QLatin1Char('/'), 0, 0), QStringLiteral("dir0"));
+        QCOMPARE(items[1001]->_file, QStringLiteral("dir0-file"));
+    }
 };
 
 QTEST_APPLESS_MAIN(TestSyncFileItem)
@@ -517,6 +517,58 @@ private slots:
         statusSpy.clear();
     }
 
+    // What the file manager asks for when it opens a large directory
+    void statusOfManyFiles() {
+        FakeFolder fakeFolder{FileInfo{}};
+        fakeFolder.remoteModifier().mkdir(QStringLiteral("D"));
+        QStringList files;
+        for (int i = 0; i < 1000; ++i) {
+            files.append(QStringLiteral("D/d%1").arg(i));
+            fakeFolder.remoteModifier().insert(files.last());
+        }
+        QVERIFY(fakeFolder.syncOnce());
+
+        auto &tracker = fakeFolder.syncEngine().syncFileStatusTracker();
+        QBENCHMARK {
+            for (const auto &file : qAsConst(files)) {
+                tracker.fileStatus(file);
+            }
+        }
+        for (const auto &file : qAsConst(files)) {
+            QCOMPARE(tracker.fileStatus(file), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        }
+
+        // New files are only known to the exclude list until they are synced
+        fakeFolder.syncEngine().excludedFiles().addManualExclude(QStringLiteral("*.tmp"));
+        fakeFolder.localModifier().insert(QStringLiteral("D/new.tmp"));
+        fakeFolder.localModifier().insert(QStringLiteral("D/new"));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D/new.tmp")), SyncFileStatus(SyncFileStatus::StatusExcluded));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D/new")), SyncFileStatus(SyncFileStatus::StatusNone));
+        // Directory patterns only match directories
+        fakeFolder.syncEngine().excludedFiles().addManualExclude(QStringLiteral("build/"));
+        fakeFolder.localModifier().mkdir(QStringLiteral("D/build"));
+        fakeFolder.localModifier().insert(QStringLiteral("build"));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D/build")), SyncFileStatus(SyncFileStatus::StatusExcluded));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("build")), SyncFileStatus(SyncFileStatus::StatusNone));
+
+        fakeFolder.serverErrorPaths().append(QStringLiteral("D/d500"));
+        fakeFolder.localModifier().appendByte(QStringLiteral("D/d500"));
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(tracker.fileStatus(QString()), SyncFileStatus(SyncFileStatus::StatusWarning));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D")), SyncFileStatus(SyncFileStatus::StatusWarning));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D/d500")), SyncFileStatus(SyncFileStatus::StatusError));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D/d501")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D/new")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D/new.tmp")), SyncFileStatus(SyncFileStatus::StatusExcluded));
+
+        // Once the error is gone the parents lose their warning
+        fakeFolder.serverErrorPaths().clear();
+        fakeFolder.syncEngine().journal()->wipeErrorBlacklistEntry(QStringLiteral("D/d500"));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(tracker.fileStatus(QString()), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(tracker.fileStatus(QStringLiteral("D/d500")), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncFileStatusTracker)
@@ -312,6 +312,81 @@ private slots:
         QVERIFY(checkElements());
     }
 
+    void testFilesBelowPathOrder()
+    {
+        QByteArrayList elements { "order", "order/foo", "order/foo/file", "order/foo-2", "order/foo.txt", "order/foo0",
+            "order/foo/sub", "order/foo/sub/file", "order/a", "order/foo bar" };
+        for (const auto &elem : qAsConst(elements)) {
+            SyncJournalFileRecord record;
+            record._path = elem;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            QVERIFY(_db.setFileRecord(record));
+        }
+
+        // The contents of a directory come directly after the directory itself
+        const QByteArrayList expected { "order/a", "order/foo bar", "order/foo-2", "order/foo.txt", "order/foo",
+            "order/foo/file", "order/foo/sub", "order/foo/sub/file", "order/foo0" };
+        QByteArrayList below;
+        QVERIFY(_db.getFilesBelowPath("order", [&](const SyncJournalFileRecord &rec) { below.append(rec._path); }));
+        QCOMPARE(below, expected);
+
+        below.clear();
+        QVERIFY(_db.getFilesBelowPath("", [&](const SyncJournalFileRecord &rec) {
+            if (rec._path.startsWith("order"))
+                below.append(rec._path);
+        }));
+        QCOMPARE(below, QByteArrayList { "order" } + expected);
+
+        QByteArrayList children;
+        QVERIFY(_db.listFilesInPath("order/foo", [&](const SyncJournalFileRecord &rec) { children.append(rec._path); }));
+        QCOMPARE(children, (QByteArrayList { "order/foo/file", "order/foo/sub" }));
+    }
+
+    void testWriteBatching()
+    {
+        _db.enableWriteBatching(1000, std::chrono::hours(1));
+
+        auto makeRecord = [](const QByteArray &path, const QByteArray &etag) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._etag = etag;
+            record._remotePerm = RemotePermissions::fromDbValue("RW");
+            return record;
+        };
+
+        // More than fit into one insert statement
+        for (int i = 0; i < 100; ++i) {
+            QVERIFY(_db.setFileRecord(makeRecord("batch/" + QByteArray::number(i), "1")));
+        }
+        // Later updates of a path win
+        QVERIFY(_db.setFileRecord(makeRecord("batch/7", "2")));
+
+        SyncJournalErrorBlacklistRecord entry;
+        entry._file = QStringLiteral("batch/blacklisted");
+        entry._errorString = QStringLiteral("error");
+        entry._retryCount = 1;
+        entry._lastTryTime = Utility::qDateTimeToTime_t(QDateTime::currentDateTimeUtc());
+        entry._ignoreDuration = 60;
+        _db.setErrorBlacklistEntry(entry);
+        _db.wipeErrorBlacklistEntry(QStringLiteral("batch/blacklisted"));
+
+        // Reads see the queued writes, in order
+        SyncJournalFileRecord record;
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("batch/7"), &record));
+        QCOMPARE(record._etag, QByteArray("2"));
+        int count = 0;
+        QVERIFY(_db.getFilesBelowPath("batch", [&](const SyncJournalFileRecord &) { ++count; }));
+        QCOMPARE(count, 100);
+        QVERIFY(!_db.errorBlacklistEntry(QStringLiteral("batch/blacklisted")).isValid());
+
+        QVERIFY(_db.setFileRecord(makeRecord("batch/7", "3")));
+        QVERIFY(_db.disableWriteBatching());
+        QVERIFY(_db.getFileRecord(QByteArrayLiteral("batch/7"), &record));
+        QCOMPARE(record._etag, QByteArray("3"));
+
+        QVERIFY(_db.deleteFileRecord(QStringLiteral("batch"), true));
+    }
+
     void testPinState()
     {
         auto make = [&](const QByteArray &path, PinState state) {
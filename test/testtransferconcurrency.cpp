@@ -0,0 +1,119 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "transferconcurrency.h"
+
+#include <QTest>
+
+using namespace std::chrono_literals;
+using namespace OCC;
+
+namespace {
+/** Transfers bytesPerWindow in each of the following windows, returns the time after them
+ *
+ * Unless saturated is false, the transfers use all slots of the limit.
+ */
+TransferConcurrency::Clock::time_point runWindows(TransferConcurrency &concurrency, TransferConcurrency::Clock::time_point now,
+    const std::vector<qint64> &bytesPerWindow, bool saturated = true)
+{
+    for (const auto bytes : bytesPerWindow) {
+        concurrency.addActiveTransfers(saturated ? concurrency.limit() : concurrency.limit() - 1);
+        concurrency.addTransferredBytes(bytes, now);
+        now += TransferConcurrency::measuringWindow;
+        concurrency.addTransferredBytes(0, now);
+    }
+    return now;
+}
+}
+
+class TestTransferConcurrency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAdditiveIncrease()
+    {
+        TransferConcurrency concurrency;
+        QCOMPARE(concurrency.limit(), TransferConcurrency::initialLimit);
+
+        auto now = runWindows(concurrency, TransferConcurrency::Clock::now(), { 1000, 2000, 3000 });
+        QCOMPARE(concurrency.limit(), TransferConcurrency::initialLimit + 3);
+
+        // No more gain: keep the limit
+        runWindows(concurrency, now, { 3000, 3010, 2000 });
+        QCOMPARE(concurrency.limit(), TransferConcurrency::initialLimit + 3);
+    }
+
+    void testMaximumLimit()
+    {
+        TransferConcurrency concurrency;
+        std::vector<qint64> growing;
+        for (int i = 1; i < 3 * TransferConcurrency::defaultMaximumLimit; ++i) {
+            growing.push_back(i * 1000);
+        }
+        auto now = runWindows(concurrency, TransferConcurrency::Clock::now(), growing);
+        QCOMPARE(concurrency.limit(), TransferConcurrency::defaultMaximumLimit);
+
+        // The propagator runs fewer jobs: clamp, and halve from there
+        concurrency.setMaximumLimit(6);
+        QCOMPARE(concurrency.limit(), 6);
+        now = runWindows(concurrency, now, { 1000000, 2000000 });
+        QCOMPARE(concurrency.limit(), 6);
+        concurrency.addCongestion();
+        runWindows(concurrency, now, { 2000000 });
+        QCOMPARE(concurrency.limit(), 3);
+    }
+
+    void testUnsaturated()
+    {
+        TransferConcurrency concurrency;
+        // Fewer transfers than slots: more slots won't help
+        auto now = runWindows(concurrency, TransferConcurrency::Clock::now(), { 1000, 2000, 3000 }, false);
+        QCOMPARE(concurrency.limit(), TransferConcurrency::initialLimit);
+
+        runWindows(concurrency, now, { 4000 });
+        QCOMPARE(concurrency.limit(), TransferConcurrency::initialLimit + 1);
+    }
+
+    void testCongestion()
+    {
+        TransferConcurrency concurrency;
+        auto now = runWindows(concurrency, TransferConcurrency::Clock::now(), { 1000, 2000, 3000, 4000, 5000 });
+        QCOMPARE(concurrency.limit(), 8);
+
+        concurrency.addCongestion();
+        now = runWindows(concurrency, now, { 6000 });
+        QCOMPARE(concurrency.limit(), 4);
+
+        for (int i = 0; i < 4; ++i) {
+            concurrency.addCongestion();
+            now = runWindows(concurrency, now, { 6000 });
+        }
+        QCOMPARE(concurrency.limit(), 1);
+    }
+
+    void testLatencyInflation()
+    {
+        TransferConcurrency concurrency;
+        concurrency.addResponseLatency(100ms);
+        auto now = runWindows(concurrency, TransferConcurrency::Clock::now(), { 1000 });
+        QCOMPARE(concurrency.limit(), TransferConcurrency::initialLimit + 1);
+
+        // Slower, but not by much in absolute terms
+        concurrency.addResponseLatency(250ms);
+        now = runWindows(concurrency, now, { 2000 });
+        QCOMPARE(concurrency.limit(), TransferConcurrency::initialLimit + 2);
+
+        concurrency.addResponseLatency(900ms);
+        concurrency.addResponseLatency(700ms);
+        runWindows(concurrency, now, { 3000 });
+        QCOMPARE(concurrency.limit(), (TransferConcurrency::initialLimit + 2) / 2);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestTransferConcurrency)
+#include "testtransferconcurrency.moc"
@@ -12,6 +12,9 @@
 #include "accessmanager.h"
 #include "libsync/configfile.h"
 
+#include <QJsonDocument>
+#include <QJsonObject>
+
 using namespace std::chrono_literals;
 
 PathComponents::PathComponents(const char *path)
@@ -385,8 +388,16 @@ FakePropfindReply::FakePropfindReply(FileInfo &remoteRootFileInfo, QNetworkAcces
 
     writeFileResponse(*fileInfo);
 
-    const int depth = request.rawHeader(QByteArrayLiteral("Depth")).toInt();
-    if (depth > 0) {
+    const QByteArray depthHeader = request.rawHeader(QByteArrayLiteral("Depth"));
+    if (depthHeader == "infinity") {
+        std::function<void(const FileInfo &)> writeSubtree = [&](const FileInfo &dirInfo) {
+            for (const FileInfo &childFileInfo : dirInfo.children) {
+                writeFileResponse(childFileInfo);
+                writeSubtree(childFileInfo);
+            }
+        };
+        writeSubtree(*fileInfo);
+    } else if (depthHeader.toInt() > 0) {
         for (const FileInfo &childFileInfo : fileInfo->children) {
             writeFileResponse(childFileInfo);
         }
@@ -562,6 +573,17 @@ FakeGetReply::FakeGetReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::
     if (!fileInfo) {
         qDebug() << "Could not find file" << fileName << "on the remote";
         state = State::FileNotFound;
+    } else if (request.hasRawHeader("Range")) {
+        const QString range = QString::fromUtf8(request.rawHeader("Range"));
+        const QRegularExpression bytesPattern(QStringLiteral("bytes=(?<start>\\d+)-(?<end>\\d*)"));
+        const QRegularExpressionMatch match = bytesPattern.match(range);
+        if (match.hasMatch()) {
+            rangeStart = match.captured(QStringLiteral("start")).toLongLong();
+            rangeEnd = fileInfo->contentSize - 1;
+            if (!match.captured(QStringLiteral("end")).isEmpty()) {
+                rangeEnd = std::min(match.captured(QStringLiteral("end")).toLongLong(), rangeEnd);
+            }
+        }
     }
     QMetaObject::invokeMethod(this, &FakeGetReply::respond, Qt::QueuedConnection);
 }
@@ -580,8 +602,12 @@ void FakeGetReply::respond()
     case State::Ok:
         payload = fileInfo->contentChar;
         size = fileInfo->contentSize;
+        if (rangeStart >= 0) {
+            size = rangeEnd - rangeStart + 1;
+            setRawHeader("Content-Range", "bytes " + QByteArray::number(rangeStart) + '-' + QByteArray::number(rangeEnd) + '/' + QByteArray::number(fileInfo->contentSize));
+        }
         setHeader(QNetworkRequest::ContentLengthHeader, size);
-        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, rangeStart >= 0 ? 206 : 200);
         setRawHeader("OC-ETag", fileInfo->etag);
         setRawHeader("ETag", fileInfo->etag);
         setRawHeader("OC-FileId", fileInfo->fileId);
@@ -643,6 +669,8 @@ FakeGetWithDataReply::FakeGetWithDataReply(FileInfo &remoteRootFileInfo, const Q
         if (match.hasMatch()) {
             const int start = match.captured(QStringLiteral("start")).toInt();
             const int end = match.captured(QStringLiteral("end")).toInt();
+            contentRange = "bytes " + QByteArray::number(start) + '-' + QByteArray::number(start + std::min(end - start + 1, payload.size() - start) - 1)
+                + '/' + QByteArray::number(payload.size());
             payload = payload.mid(start, end - start + 1);
         }
     }
@@ -657,7 +685,10 @@ void FakeGetWithDataReply::respond()
         return;
     }
     setHeader(QNetworkRequest::ContentLengthHeader, payload.size());
-    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+    if (!contentRange.isEmpty()) {
+        setRawHeader("Content-Range", contentRange);
+    }
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, contentRange.isEmpty() ? 200 : 206);
     setRawHeader("OC-ETag", fileInfo->etag);
     setRawHeader("ETag", fileInfo->etag);
     setRawHeader("OC-FileId", fileInfo->fileId);
@@ -723,6 +754,35 @@ FileInfo *FakeChunkMoveReply::perform(FileInfo &uploadsFileInfo, FileInfo &remot
     Q_ASSERT(!fileName.isEmpty());
 
     const auto &sourceFolderChildren = sourceFolder->children;
+    if (request.rawHeader("OC-Delta-Sync") == "1") {
+        // The chunks only cover the changed ranges, the rest comes from the destination
+        FileInfo *fileInfo = remoteRootFileInfo.find(fileName);
+        Q_ASSERT(fileInfo);
+        if (request.rawHeader("If") != "<" + request.rawHeader("Destination") + "> ([\"" + fileInfo->etag + "\"])") {
+            return nullptr;
+        }
+        const qint64 totalSize = request.rawHeader("OC-Total-File-Length").toLongLong();
+        payload = fileInfo->contentChar;
+        for (auto it = sourceFolderChildren.cbegin(); it != sourceFolderChildren.cend(); ++it) {
+            const qint64 offset = it.key().toLongLong();
+            Q_ASSERT(offset >= prev); // No overlapping chunks
+            Q_ASSERT(offset == prev || offset <= fileInfo->contentSize); // Holes must be filled from the destination
+            if (offset == 0) {
+                payload = it->contentChar;
+            }
+            size += it->contentSize;
+            prev = offset + it->contentSize;
+        }
+        Q_ASSERT(prev == totalSize || totalSize <= fileInfo->contentSize);
+        Q_ASSERT(request.rawHeader("OC-Total-Length").toLongLong() == size);
+        fileInfo->contentSize = totalSize;
+        fileInfo->contentChar = payload;
+        fileInfo->fileSize = fileInfo->contentSize;
+        fileInfo->setLastModifiedFromSecondsUTC(request.rawHeader("X-OC-Mtime").toLongLong());
+        remoteRootFileInfo.find(fileName, /*invalidate_etags=*/true);
+        return fileInfo;
+    }
+
     // Compute the size and content from the chunks if possible
     for (auto it = sourceFolderChildren.cbegin(); it != sourceFolderChildren.cend(); ++it) {
         const auto &chunkNameLongLong = it.key().toLongLong();
@@ -824,6 +884,63 @@ qint64 FakePayloadReply::bytesAvailable() const
     return _body.size();
 }
 
+FakeBulkUploadReply::FakeBulkUploadReply(FileInfo &remoteRootFileInfo, const QHash<QString, int> &errorPaths,
+    QNetworkAccessManager::Operation op, const QNetworkRequest &request, const QByteArray &payload, QObject *parent)
+    : FakePayloadReply { op, request, perform(remoteRootFileInfo, errorPaths, request, payload), parent }
+{
+}
+
+QByteArray FakeBulkUploadReply::perform(FileInfo &remoteRootFileInfo, const QHash<QString, int> &errorPaths,
+    const QNetworkRequest &request, const QByteArray &payload)
+{
+    const QByteArray contentType = request.header(QNetworkRequest::ContentTypeHeader).toByteArray();
+    Q_ASSERT(contentType.startsWith("multipart/related; boundary="));
+    const QByteArray boundary = "--" + contentType.mid(contentType.indexOf('=') + 1);
+
+    QJsonObject results;
+    int pos = 0;
+    Q_ASSERT(payload.startsWith(boundary));
+    while (true) {
+        pos += boundary.size();
+        if (payload.mid(pos, 2) == "--") {
+            // the closing boundary
+            break;
+        }
+        pos += 2; // \r\n
+
+        QHash<QByteArray, QByteArray> headers;
+        while (true) {
+            const int lineEnd = payload.indexOf("\r\n", pos);
+            Q_ASSERT(lineEnd >= 0);
+            const QByteArray line = payload.mid(pos, lineEnd - pos);
+            pos = lineEnd + 2;
+            if (line.isEmpty()) {
+                break;
+            }
+            const int colon = line.indexOf(':');
+            headers.insert(line.left(colon).toLower(), line.mid(colon + 1).trimmed());
+        }
+        const int size = headers.value("content-length").toInt();
+        const QByteArray data = payload.mid(pos, size);
+        pos += size + 2;
+        Q_ASSERT(payload.mid(pos, boundary.size()) == boundary);
+
+        const QByteArray path = headers.value("x-file-path");
+        QNetworkRequest partRequest(QUrl::fromEncoded(path));
+        partRequest.setRawHeader("X-OC-Mtime", headers.value("x-oc-mtime"));
+        const QString fileName = getFilePathFromUrl(partRequest.url());
+        Q_ASSERT(!fileName.isEmpty());
+
+        if (errorPaths.contains(fileName)) {
+            results.insert(QString::fromUtf8(path), QJsonObject { { QStringLiteral("error"), true }, { QStringLiteral("status"), errorPaths.value(fileName) }, { QStringLiteral("message"), QStringLiteral("Fake error") } });
+            continue;
+        }
+        const FileInfo *fileInfo = FakePutReply::perform(remoteRootFileInfo, partRequest, data);
+        results.insert(QString::fromUtf8(path), QJsonObject { { QStringLiteral("error"), false }, { QStringLiteral("etag"), QString::fromUtf8(fileInfo->etag) }, { QStringLiteral("fileid"), QString::fromUtf8(fileInfo->fileId) } });
+    }
+    return QJsonDocument(results).toJson();
+}
+
 FakeErrorReply::FakeErrorReply(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent, int httpErrorCode, const QByteArray &body)
     : FakeReply { parent }
     , _body(body)
@@ -899,7 +1016,8 @@ QNetworkReply *FakeAM::createRequest(QNetworkAccessManager::Operation op, const
             reply = _reply;
         }
     }
-    if (!reply) {
+    const bool isBulkUpload = newRequest.url().path() == sBulkUploadUrl.path();
+    if (!reply && !isBulkUpload) {
         const QString fileName = getFilePathFromUrl(newRequest.url());
         Q_ASSERT(!fileName.isNull());
         if (_errorPaths.contains(fileName)) {
@@ -911,7 +1029,9 @@ QNetworkReply *FakeAM::createRequest(QNetworkAccessManager::Operation op, const
         FileInfo &info = isUpload ? _uploadFileInfo : _remoteRootFileInfo;
 
         auto verb = newRequest.attribute(QNetworkRequest::CustomVerbAttribute);
-        if (verb == QLatin1String("PROPFIND"))
+        if (isBulkUpload && (verb == QLatin1String("POST") || op == QNetworkAccessManager::PostOperation))
+            reply = new FakeBulkUploadReply { _remoteRootFileInfo, _errorPaths, op, newRequest, outgoingData->readAll(), this };
+        else if (verb == QLatin1String("PROPFIND"))
             // Ignore outgoingData always returning somethign good enough, works for now.
             reply = new FakePropfindReply { info, op, newRequest, this };
         else if (verb == QLatin1String("GET") || op == QNetworkAccessManager::GetOperation)
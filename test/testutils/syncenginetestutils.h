@@ -37,6 +37,7 @@
 static const QUrl sRootUrl = QUrl::fromEncoded("owncloud://somehost/owncloud/remote.php/webdav/");
 static const QUrl sRootUrl2 = QUrl::fromEncoded("owncloud://somehost/owncloud/remote.php/dav/files/admin/");
 static const QUrl sUploadUrl = QUrl::fromEncoded("owncloud://somehost/owncloud/remote.php/dav/uploads/admin/");
+static const QUrl sBulkUploadUrl = QUrl::fromEncoded("owncloud://somehost/owncloud/remote.php/dav/bulk");
 
 inline QString getFilePathFromUrl(const QUrl &url)
 {
@@ -353,10 +354,13 @@ public:
     char payload;
     int size;
     State state = State::Ok;
+    // The requested byte range, rangeStart is -1 for the whole file
+    qint64 rangeStart = -1;
+    qint64 rangeEnd = -1;
 
     FakeGetReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
 
-    Q_INVOKABLE void respond();
+    Q_INVOKABLE virtual void respond();
 
     void abort() override;
     qint64 bytesAvailable() const override;
@@ -372,6 +376,7 @@ public:
     QByteArray payload;
     quint64 offset = 0;
     bool aborted = false;
+    QByteArray contentRange; // set if a range was requested
 
     FakeGetWithDataReply(FileInfo &remoteRootFileInfo, const QByteArray &data, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent);
 
@@ -419,6 +424,23 @@ public:
     QByteArray _body;
 };
 
+/**
+ * Implements the bulk upload endpoint (see OCC::PropagateUploadBulk)
+ *
+ * Stores every part like a PUT, or answers with an error for the part
+ * if its path is in the error paths.
+ */
+class FakeBulkUploadReply : public FakePayloadReply
+{
+    Q_OBJECT
+public:
+    FakeBulkUploadReply(FileInfo &remoteRootFileInfo, const QHash<QString, int> &errorPaths,
+        QNetworkAccessManager::Operation op, const QNetworkRequest &request, const QByteArray &payload, QObject *parent);
+
+    static QByteArray perform(FileInfo &remoteRootFileInfo, const QHash<QString, int> &errorPaths,
+        const QNetworkRequest &request, const QByteArray &payload);
+};
+
 
 class FakeErrorReply : public FakeReply
 {
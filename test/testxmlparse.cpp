@@ -123,6 +123,88 @@ private slots:
         QVERIFY(_subdirs.size() == 1);
     }
 
+    void testParserIncremental() {
+        const QByteArray firstResponse = "<?xml version='1.0' encoding='utf-8'?>"
+              "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\">"
+              "<d:response>"
+              "<d:href>/oc/remote.php/webdav/sharefolder/</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004213ocobzus5kn6s</oc:id>"
+              "<oc:size>121780</oc:size>"
+              "<d:resourcetype>"
+              "<d:collection/>"
+              "</d:resourcetype>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "</d:response>";
+        const QByteArray rest = "\n<d:response>"
+              "<d:href>/oc/remote.php/webdav/sharefolder/quitte.pdf</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004215ocobzus5kn6s</oc:id>"
+              "<d:resourcetype/>"
+              "<d:getcontentlength>121780</d:getcontentlength>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "</d:response>"
+              "</d:multistatus>";
+
+        LsColXMLParser parser;
+
+        connect(&parser, &LsColXMLParser::directoryListingSubfolders,
+            this, &TestXmlParse::slotDirectoryListingSubFolders);
+        connect(&parser, &LsColXMLParser::directoryListingIterated,
+            this, &TestXmlParse::slotDirectoryListingIterated);
+        connect(&parser, &LsColXMLParser::finishedWithoutError,
+            this, &TestXmlParse::slotFinishedSuccessfully);
+
+        // Feed the reply in small pieces, like it arrives from the network
+        QHash <QString, qint64> sizes;
+        const QString expectedPath = QStringLiteral("/oc/remote.php/webdav/sharefolder");
+        for (int i = 0; i < firstResponse.size(); i += 7) {
+            QVERIFY(parser.addData(firstResponse.mid(i, 7), &sizes, expectedPath));
+        }
+        // The first response is reported before the reply is complete
+        QCOMPARE(_items, QStringList { QStringLiteral("/oc/remote.php/webdav/sharefolder") });
+        QVERIFY(!_success);
+
+        for (int i = 0; i < rest.size(); i += 7) {
+            QVERIFY(parser.addData(rest.mid(i, 7), &sizes, expectedPath));
+        }
+        QVERIFY(parser.finish());
+
+        QVERIFY(_success);
+        QCOMPARE(sizes.size(), 1);
+        QVERIFY(_items.contains("/oc/remote.php/webdav/sharefolder/quitte.pdf"));
+        QCOMPARE(_items.size(), 2);
+        QCOMPARE(_subdirs, QStringList { QStringLiteral("/oc/remote.php/webdav/sharefolder/") });
+    }
+
+    void testParserIncrementalTruncated() {
+        const QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+              "<d:multistatus xmlns:d=\"DAV:\">"
+              "<d:response>"
+              "<d:href>/oc/remote.php/webdav/sharefolder/</d:href>"
+              "</d:response>"
+              "<d:response>"
+              "<d:href>/oc/remote.php/webdav/sharefolder/a</d:href>"; // no proper end here
+
+        LsColXMLParser parser;
+        connect(&parser, &LsColXMLParser::directoryListingIterated,
+            this, &TestXmlParse::slotDirectoryListingIterated);
+        connect(&parser, &LsColXMLParser::finishedWithoutError,
+            this, &TestXmlParse::slotFinishedSuccessfully);
+
+        QHash <QString, qint64> sizes;
+        QVERIFY(parser.addData(testXml, &sizes, QStringLiteral("/oc/remote.php/webdav/sharefolder")));
+        QCOMPARE(_items.size(), 1);
+        QVERIFY(!parser.finish());
+        QVERIFY(!_success);
+    }
+
     void testParserBrokenXml() {
         const QByteArray testXml = "X<?xml version='1.0' encoding='utf-8'?>"
               "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\">"